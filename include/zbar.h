@@ -170,9 +170,15 @@ typedef enum zbar_config_e {
     ZBAR_CFG_UNCERTAINTY = 0x40,/**< required video consistency frames */
 
     ZBAR_CFG_POSITION = 0x80,   /**< enable scanner to collect position data */
+    ZBAR_CFG_TRACKING,          /**< follow 2D symbols between video frames */
 
     ZBAR_CFG_X_DENSITY = 0x100, /**< image scanner vertical scan density */
     ZBAR_CFG_Y_DENSITY,         /**< image scanner horizontal scan density */
+    ZBAR_CFG_SA_TIMEOUT,        /**< structured append reassembly time (ms) */
+    ZBAR_CFG_PYRAMID,           /**< image scanner reduced resolution levels */
+
+    ZBAR_CFG_LATEST_FRAME = 0x200,/**< processor video skips stale frames */
+    ZBAR_CFG_SKIP_STATIC,       /**< processor frames skipped while static */
 } zbar_config_t;
 
 /** decoder symbology modifier flags.
@@ -548,6 +554,11 @@ extern void zbar_image_ref(zbar_image_t *image,
  * unaffected.
  * @note the converted image size may be rounded (up) due to format
  * constraints
+ * @note converting to a grayscale format (Y800/GREY) from a format
+ * that starts with a full resolution luma plane (Y800, I420, YV12,
+ * NV12, NV21, 422P...) does not copy any data: the new image
+ * references the luma plane of the original, which is kept alive
+ * until the converted image is destroyed
  */
 extern zbar_image_t *zbar_image_convert(const zbar_image_t *image,
                                         unsigned long format);
@@ -560,6 +571,8 @@ extern zbar_image_t *zbar_image_convert(const zbar_image_t *image,
  * @returns a @em new image with the sample data from the original
  * image converted to the requested format and size.
  * @note the image is @em not scaled
+ * @note grayscale images that only drop rows from the bottom of the
+ * luma plane also reference the original data
  * @see zbar_image_convert()
  * @since 0.4
  */
@@ -568,6 +581,58 @@ extern zbar_image_t *zbar_image_convert_resize(const zbar_image_t *image,
                                                unsigned width,
                                                unsigned height);
 
+/** grayscale conversion of the crop rectangle w/integer downscale.
+ * only the crop rectangle of the image is read, and each @a scale x
+ * @a scale block of it is averaged into one output pixel, all in a
+ * single pass.  rows/columns that do not fill a whole block are
+ * dropped from the right/bottom.
+ * @param format a grayscale format (Y800 or GREY)
+ * @param scale downscale factor, 1 to 4
+ * @returns a @em new image of (crop width / scale) x (crop height /
+ * scale) pixels, or NULL if the format or scale are not supported
+ * @note symbol locations found in the result are relative to it: map
+ * them back to the original image by multiplying by @a scale and
+ * adding the crop offset
+ * @note JPEG images are decoded directly at a reduced size where
+ * possible, so the result is close to, but not exactly, a box average
+ * @see zbar_image_convert()
+ * @since 0.11
+ */
+extern zbar_image_t *zbar_image_convert_scaled(const zbar_image_t *image,
+                                               unsigned long format,
+                                               unsigned scale);
+
+/** grayscale conversion using the color channel w/the most contrast.
+ * instead of a fixed luma weighting, the image (or each @a tile x
+ * @a tile pixel tile of it) is converted using whichever of luma or
+ * the red, green or blue channel has the most local contrast.  this
+ * helps colored symbols, eg red on white, which have little contrast
+ * in luma.  channels are inverted where needed to keep symbols that
+ * are darker than their background in luma dark
+ * @param format a grayscale format (Y800 or GREY)
+ * @param tile size of the square tiles that select a channel
+ * independently, or 0 to use one channel for the whole image.  tiles
+ * should be larger than the symbols to be scanned
+ * @returns a @em new image, or NULL if the format is not supported.
+ * images without color are converted as for zbar_image_convert()
+ * @since 0.11
+ */
+extern zbar_image_t *zbar_image_convert_contrast(const zbar_image_t *image,
+                                                 unsigned long format,
+                                                 unsigned tile);
+
+/** set the number of threads used for large image conversions.
+ * conversions of (multi-megapixel) images between the single plane
+ * formats (grayscale, packed YUV and packed RGB) are split into bands
+ * of rows which are converted in parallel.  smaller images are always
+ * converted by the calling thread
+ * @param nthreads maximum number of threads to use for one
+ * conversion, including the caller.  1 (the default) disables this
+ * @note this is a global setting, affecting all conversions
+ * @since 0.11
+ */
+extern void zbar_image_convert_set_threads(unsigned nthreads);
+
 /** retrieve the image format.
  * @returns the fourcc describing the format of the image sample data
  */
@@ -578,6 +643,17 @@ extern unsigned long zbar_image_get_format(const zbar_image_t *image);
  */
 extern unsigned zbar_image_get_sequence(const zbar_image_t *image);
 
+/** retrieve the capture timestamp associated with this image.
+ * video frames are stamped by the driver where possible, otherwise
+ * when they are dequeued.  the timestamp is carried over to converted
+ * images and is used by the image scanner to age its result cache.
+ * @returns milliseconds on the library's monotonic clock (the clock
+ * used for V4L2 buffer timestamps, CLOCK_MONOTONIC where available),
+ * or 0 if unknown
+ * @since 0.11
+ */
+extern unsigned long zbar_image_get_timestamp(const zbar_image_t *image);
+
 /** retrieve the width of the image.
  * @returns the width in sample columns
  */
@@ -655,6 +731,16 @@ extern void zbar_image_set_format(zbar_image_t *image,
 extern void zbar_image_set_sequence(zbar_image_t *image,
                                     unsigned sequence_num);
 
+/** associate a capture timestamp with this image, eg for offline
+ * frames.  scanning an image w/o a timestamp (0) uses the time of the
+ * scan instead.  timestamps of images scanned w/the same image scanner
+ * should come from one clock.
+ * @see zbar_image_get_timestamp()
+ * @since 0.11
+ */
+extern void zbar_image_set_timestamp(zbar_image_t *image,
+                                     unsigned long msecs);
+
 /** specify the pixel size of the image.
  * @note this also resets the crop rectangle to the full image
  * (0, 0, width, height)
@@ -731,6 +817,86 @@ extern int zbar_image_write(const zbar_image_t *image,
  */
 extern zbar_image_t *zbar_image_read(char *filename);
 
+/** open an image file w/its sample data mapped directly into memory.
+ * no pixels are copied: the image data points into a read-only
+ * mapping of the file, which is unmapped by the cleanup handler when
+ * the image is destroyed.  supported files are:
+ *   - images written by zbar_image_write()
+ *   - binary (P5) PGM w/8 bit samples, as Y800
+ *   - the first frame of a YUV4MPEG2 (Y4M) stream, as I420 or 422P
+ *     (or just the Y800 luma plane for other 8 bit layouts)
+ *   - uncompressed 8 bit grayscale or RGB (RGB3) TIFF, where the
+ *     strips of the first image are stored contiguously
+ * @returns a new image, or NULL (w/errno set) if the file can't be
+ * opened, isn't supported or can't be mapped
+ * @since 0.11
+ */
+extern zbar_image_t *zbar_image_open_mapped(const char *filename);
+
+struct zbar_image_pool_s;
+/** opaque image buffer pool object.
+ * converted image data buffers are returned to the pool when the
+ * image is destroyed, and reused for later conversions of the same
+ * format and size, avoiding a large allocation per video frame
+ * @since 0.11
+ */
+typedef struct zbar_image_pool_s zbar_image_pool_t;
+
+/** image buffer pool constructor.
+ * @returns a new, empty pool
+ * @since 0.11
+ */
+extern zbar_image_pool_t *zbar_image_pool_create(void);
+
+/** image buffer pool destructor.
+ * idle buffers are freed immediately, buffers still attached to
+ * images are freed when those images are destroyed
+ * @since 0.11
+ */
+extern void zbar_image_pool_destroy(zbar_image_pool_t *pool);
+
+/** image format conversion w/data buffer drawn from a pool.
+ * same as zbar_image_convert(), except a new data buffer is taken
+ * from (and returned to) @a pool
+ * @see zbar_image_convert()
+ * @since 0.11
+ */
+extern zbar_image_t *zbar_image_pool_convert(zbar_image_pool_t *pool,
+                                             const zbar_image_t *image,
+                                             unsigned long format);
+
+/** image format conversion with size override, w/data buffer drawn
+ * from a pool.
+ * @see zbar_image_convert_resize()
+ * @since 0.11
+ */
+extern zbar_image_t *
+zbar_image_pool_convert_resize(zbar_image_pool_t *pool,
+                               const zbar_image_t *image,
+                               unsigned long format,
+                               unsigned width,
+                               unsigned height);
+
+/** downscaled grayscale conversion w/data buffer drawn from a pool.
+ * @see zbar_image_convert_scaled()
+ * @since 0.11
+ */
+extern zbar_image_t *
+zbar_image_pool_convert_scaled(zbar_image_pool_t *pool,
+                               const zbar_image_t *image,
+                               unsigned long format,
+                               unsigned scale);
+
+/** best contrast grayscale conversion w/data buffer drawn from a pool.
+ * @see zbar_image_convert_contrast()
+ * @since 0.11
+ */
+extern zbar_image_t *
+zbar_image_pool_convert_contrast(zbar_image_pool_t *pool,
+                                 const zbar_image_t *image,
+                                 unsigned long format,
+                                 unsigned tile);
+
 /*@}*/
 
 /*------------------------------------------------------------*/
@@ -788,6 +954,7 @@ extern int zbar_processor_request_interface(zbar_processor_t *processor,
     1 = force I/O using read()
     2 = force memory mapped I/O using mmap()
     3 = force USERPTR I/O (v4l2 only)
+    4 = force DMABUF I/O (v4l2 only)
 @endverbatim
  * @note must be called before zbar_processor_init()
  * @since 0.7
@@ -795,6 +962,30 @@ extern int zbar_processor_request_interface(zbar_processor_t *processor,
 extern int zbar_processor_request_iomode(zbar_processor_t *video,
                                          int iomode);
 
+/** request a preferred number of video capture buffers.
+ * @see zbar_video_request_buffers()
+ * @note must be called before zbar_processor_init()
+ * @since 0.11
+ */
+extern int zbar_processor_request_buffers(zbar_processor_t *processor,
+                                          int num);
+
+/** request staged processing of video frames w/the specified number of
+ * scan workers.  frames are then converted, scanned and displayed in
+ * separate threads, so capture never waits for decoding: when conversion
+ * falls behind, the older of the waiting frames is dropped.  results are
+ * still delivered in capture order, and the window is redrawn w/each
+ * new frame as soon as it is captured, overlaid w/the newest results.
+ * each worker scans w/its own image scanner (settings are shared), and
+ * the data handler receives the converted (Y800) frame.  0 (default)
+ * processes each frame serially in the capture thread.  only applies
+ * to threaded processors
+ * @note must be called before zbar_processor_init()
+ * @since 0.11
+ */
+extern int zbar_processor_request_workers(zbar_processor_t *processor,
+                                          int workers);
+
 /** force specific input and output formats for debug/testing.
  * @note must be called before zbar_processor_init()
  */
@@ -886,6 +1077,44 @@ extern int zbar_processor_set_active(zbar_processor_t *processor,
 extern const zbar_symbol_set_t*
 zbar_processor_get_results(const zbar_processor_t *processor);
 
+/** retrieve a file descriptor that becomes readable when new decode
+ * results are available from a threaded processor, for integrating
+ * w/an application event loop using select()/poll()/epoll() (*nix
+ * only).  once requested, results from every frame w/symbols are
+ * held for zbar_processor_poll_results() in addition to any data
+ * handler callback, which may then be left unset.  the descriptor is
+ * also signaled if video capture stops due to an error.
+ * the descriptor is owned by the processor and must not be closed
+ * @returns the (non-blocking) file descriptor or -1 if an error occurs
+ * @since 0.11
+ */
+extern int zbar_processor_get_fd(zbar_processor_t *processor);
+
+/** retrieve the oldest pending decode results, w/out blocking.
+ * results are only held after zbar_processor_get_fd() is called and
+ * the oldest are discarded if the application falls behind.
+ * the descriptor is left readable until all pending results have
+ * been retrieved
+ * @returns the symbol set result container or NULL if no results are
+ * pending (check zbar_processor_get_error_code() if the descriptor
+ * was signaled for an error)
+ * @note the returned symbol set has its reference count incremented;
+ * ensure that the count is decremented after use
+ * @since 0.11
+ */
+extern const zbar_symbol_set_t*
+zbar_processor_poll_results(zbar_processor_t *processor);
+
+/** retrieve the number of captured frames that were never scanned,
+ * either skipped by the video device to catch up w/the newest frame
+ * (see ::ZBAR_CFG_LATEST_FRAME), skipped while the scene is static
+ * (see ::ZBAR_CFG_SKIP_STATIC) or dropped by the frame pipeline
+ * (see zbar_processor_request_workers())
+ * @since 0.11
+ */
+extern unsigned long
+zbar_processor_get_dropped_frames(zbar_processor_t *processor);
+
 /** wait for input to the display window from the user
  * (via mouse or keyboard).
  * @returns >0 when input is received, 0 if timeout ms expired
@@ -966,6 +1195,10 @@ extern void zbar_video_destroy(zbar_video_t *video);
  * the device specified by platform specific unique name
  * (v4l device node path in *nix eg "/dev/video",
  *  DirectShow DevicePath property in windows).
+ * a device of the form "file:<path>" instead replays a recorded
+ * YUV4MPEG2 stream or sequence of zbar_image_write() dumps, w/options
+ * appended as "?fps=<n>[/<d>]" (0 for as fast as possible) and
+ * "&loop[=<n>]" (n plays, 0 for forever)
  * @returns 0 if successful or -1 if an error occurs
  */
 extern int zbar_video_open(zbar_video_t *video,
@@ -1003,6 +1236,7 @@ extern int zbar_video_request_interface(zbar_video_t *video,
     1 = force I/O using read()
     2 = force memory mapped I/O using mmap()
     3 = force USERPTR I/O (v4l2 only)
+    4 = force DMABUF I/O (v4l2 only)
 @endverbatim
  * @note must be called before zbar_video_open()
  * @since 0.7
@@ -1010,6 +1244,51 @@ extern int zbar_video_request_interface(zbar_video_t *video,
 extern int zbar_video_request_iomode(zbar_video_t *video,
                                      int iomode);
 
+/** request a preferred number of capture buffers (1-32, default 4).
+ * the driver may negotiate a different count; when it leaves fewer
+ * than two buffers, frames are copied out of the driver's buffer so
+ * the application can hold them (see zbar_video_set_copy_on_hold())
+ * @returns 0 if successful or -1 if an error occurs
+ * @note must be called before zbar_video_open()
+ * @since 0.11
+ */
+extern int zbar_video_request_buffers(zbar_video_t *video,
+                                      int num);
+
+/** select when frames are copied if the driver provides only a single
+ * capture buffer.  by default each frame is copied as it is returned
+ * by zbar_video_next_image().  w/copy on hold enabled, the driver's
+ * buffer is returned directly and is only copied, on the next call to
+ * zbar_video_next_image(), if the application still holds the previous
+ * frame.  has no effect when multiple buffers are available
+ * @note the held frame's data moves to the copy during
+ * zbar_video_next_image(): fetch zbar_image_get_data() again after that
+ * call, and do not read the frame from another thread during it.  the
+ * data is only moved while the application holds the sole reference to
+ * the frame: if it is shared (eg, w/zbar_image_ref() or a window still
+ * showing it), zbar_video_next_image() fails w/ZBAR_ERR_BUSY until the
+ * other references are released
+ * @returns 0 if successful or -1 if an error occurs
+ * @since 0.11
+ */
+extern int zbar_video_set_copy_on_hold(zbar_video_t *video,
+                                       int enable);
+
+/** supply dma-buf file descriptors to back the capture buffers for
+ * DMABUF I/O (see zbar_video_request_iomode()).  one descriptor is
+ * expected for each plane of each buffer in turn, so num must be a
+ * multiple of the number of planes used by the capture format.  the
+ * caller retains ownership of the descriptors and must keep them open
+ * until the video device is closed.  if no descriptors are supplied,
+ * DMABUF buffers are allocated from the system DMA heap
+ * @note must be called before zbar_video_init()
+ * @returns 0 if successful or -1 if an error occurs
+ * @since 0.11
+ */
+extern int zbar_video_import_dmabufs(zbar_video_t *video,
+                                     const int *fds,
+                                     int num);
+
 /** retrieve current output image width.
  * @returns the width or 0 if the video device is not open
  */
@@ -1039,6 +1318,60 @@ extern int zbar_video_enable(zbar_video_t *video,
  */
 extern zbar_image_t *zbar_video_next_image(zbar_video_t *video);
 
+/** enable or disable the latest frame policy.  when enabled, fetching
+ * the next image first drains any other frames the driver has already
+ * completed and returns only the newest, recycling the stale buffers
+ * immediately, so slow processing does not fall further and further
+ * behind the camera.  only applies to V4L2 streaming (mmap, userptr or
+ * dmabuf) I/O.  disabled by default
+ * @returns 0 if successful or -1 if an error occurs
+ * @since 0.11
+ */
+extern int zbar_video_set_latest_frame(zbar_video_t *video,
+                                       int latest);
+
+/** retrieve the number of stale frames skipped by the latest frame
+ * policy, or dropped when the region of interest moved, since the video
+ * device was opened.
+ * @see zbar_video_set_latest_frame()
+ * @since 0.11
+ */
+extern unsigned long zbar_video_get_dropped_frames(const zbar_video_t *video);
+
+/** set a region of interest for capture.  the device only reads out
+ * the indicated rectangle of the full video frame, which can raise the
+ * frame rate considerably for sensors that support it.  captured images
+ * are the size of the region, but symbol locations found in them are
+ * still reported in full frame coordinates.  a 0 width or height
+ * restores the full frame.  the region is applied when the video is
+ * initialized, after which it can only be moved.  the driver may move
+ * it while streaming, or fail w/ZBAR_ERR_BUSY, in which case the video
+ * must be disabled to move it.  only supported for V4L2 devices w/crop
+ * (selection) support.
+ * @returns 0 if successful or -1 if an error occurs
+ * @note frames from buffers queued before the region moves may have
+ * been captured at either position, so they are dropped (and counted
+ * by zbar_video_get_dropped_frames())
+ * @since 0.11
+ */
+extern int zbar_video_set_roi(zbar_video_t *video,
+                              unsigned x,
+                              unsigned y,
+                              unsigned width,
+                              unsigned height);
+
+/** retrieve the capture region of interest.  this is the requested
+ * region until the video is initialized, and then the one the driver
+ * applied (or the full frame if none was set).
+ * @see zbar_video_set_roi()
+ * @since 0.11
+ */
+extern void zbar_video_get_roi(const zbar_video_t *video,
+                               unsigned *x,
+                               unsigned *y,
+                               unsigned *width,
+                               unsigned *height);
+
 /** display detail for last video error to stderr.
  * @returns a non-zero value suitable for passing to exit()
  */
@@ -1064,6 +1397,146 @@ zbar_video_get_error_code (const zbar_video_t *video)
 
 /*@}*/
 
+/*------------------------------------------------------------*/
+/** @name Multi-source capture interface
+ * @anchor c-capture
+ * captures from several video devices in one process.
+ * a single thread polls every device and a shared pool of worker
+ * threads scans the frames, w/results reported per source
+ */
+/*@{*/
+
+struct zbar_capture_s;
+/** opaque multi-source capture object. */
+typedef struct zbar_capture_s zbar_capture_t;
+
+/** data handler callback function.
+ * called from a worker thread w/the scanned (Y800) frame when new
+ * results are decoded from the indicated source.  handlers for
+ * different sources may run concurrently, but frames from one source
+ * are always reported in turn
+ * @since 0.11
+ */
+typedef void (zbar_capture_data_handler_t)(zbar_image_t *image,
+                                           int source,
+                                           const void *userdata);
+
+/** constructor.  frames are scanned by the specified number of worker
+ * threads (or 1 if workers <= 0)
+ * @returns the new capture object or NULL if multi-source capture is
+ * not supported on this platform
+ * @since 0.11
+ */
+extern zbar_capture_t *zbar_capture_create(int workers);
+
+/** destructor.  capture is stopped, but the video devices are left
+ * open for the application to destroy
+ * @since 0.11
+ */
+extern void zbar_capture_destroy(zbar_capture_t *capture);
+
+/** add an opened video device as a capture source.  the device must
+ * support polling (see zbar_video_get_fd()), or be a video file, and
+ * must remain valid until the capture object is destroyed.  each source
+ * is scanned w/its own image scanner, so results are cached (and
+ * duplicates suppressed) separately for each source
+ * @returns the id of the new source (counting from 0), or -1 if an
+ * error occurs
+ * @note must be called while capture is inactive
+ * @since 0.11
+ */
+extern int zbar_capture_add_video(zbar_capture_t *capture,
+                                  zbar_video_t *video);
+
+/** setup result handler callback.
+ * @returns the previously registered handler
+ * @since 0.11
+ */
+extern zbar_capture_data_handler_t*
+zbar_capture_set_data_handler(zbar_capture_t *capture,
+                              zbar_capture_data_handler_t *handler,
+                              const void *userdata);
+
+/** set config for the scanners of all sources.
+ * @see zbar_image_scanner_set_config()
+ * @returns 0 for success, non-0 for failure
+ * @since 0.11
+ */
+extern int zbar_capture_set_config(zbar_capture_t *capture,
+                                   zbar_symbol_type_t symbology,
+                                   zbar_config_t config,
+                                   int value);
+
+/** parse configuration string using zbar_parse_config()
+ * and apply to all sources using zbar_capture_set_config().
+ * @returns 0 for success, non-0 for failure
+ * @since 0.11
+ */
+static inline int zbar_capture_parse_config (zbar_capture_t *capture,
+                                             const char *config_string)
+{
+    zbar_symbol_type_t sym;
+    zbar_config_t cfg;
+    int val;
+    return(zbar_parse_config(config_string, &sym, &cfg, &val) ||
+           zbar_capture_set_config(capture, sym, cfg, val));
+}
+
+/** start/stop capturing from all sources.  frames still waiting to be
+ * scanned are discarded when capture is stopped.
+ * @returns 0 if successful or -1 if an error occurs
+ * @note must not be called from the data handler
+ * @since 0.11
+ */
+extern int zbar_capture_set_active(zbar_capture_t *capture,
+                                   int active);
+
+/** retrieve the number of frames from a source that were never
+ * scanned, because a newer frame arrived first.
+ * @since 0.11
+ */
+extern unsigned long zbar_capture_get_dropped_frames(zbar_capture_t *capture,
+                                                     int source);
+
+/** retrieve whether a source is still capturing.
+ * @returns 1 if the source is capturing, 0 if it has stopped due to an
+ * error, or -1 if the source id is invalid
+ * @since 0.11
+ */
+extern int zbar_capture_get_source_active(zbar_capture_t *capture,
+                                          int source);
+
+/** display detail for last capture error to stderr.
+ * @returns a non-zero value suitable for passing to exit()
+ * @since 0.11
+ */
+static inline int zbar_capture_error_spew (const zbar_capture_t *capture,
+                                           int verbosity)
+{
+    return(_zbar_error_spew(capture, verbosity));
+}
+
+/** retrieve the detail string for the last capture error.
+ * @since 0.11
+ */
+static inline const char*
+zbar_capture_error_string (const zbar_capture_t *capture,
+                           int verbosity)
+{
+    return(_zbar_error_string(capture, verbosity));
+}
+
+/** retrieve the type code for the last capture error.
+ * @since 0.11
+ */
+static inline zbar_error_t
+zbar_capture_get_error_code (const zbar_capture_t *capture)
+{
+    return(_zbar_get_error_code(capture));
+}
+
+/*@}*/
+
 /*------------------------------------------------------------*/
 /** @name Window interface
  * @anchor c-window
@@ -1259,6 +1732,46 @@ zbar_image_scanner_get_results(const zbar_image_scanner_t *scanner);
 extern int zbar_scan_image(zbar_image_scanner_t *scanner,
                            zbar_image_t *image);
 
+/** start scanning a grayscale image that will be supplied in
+ * horizontal strips w/zbar_scan_strip(), for images too large to hold
+ * in memory at once.  rows are scanned as each strip arrives, while
+ * each column carries its scanner state from one strip to the next, so
+ * memory use is bounded by the strip size plus a small state per
+ * column.  QR Codes are only searched for in windows around the finder
+ * patterns seen in a strip, so a code must fit inside one strip
+ * (including its overlap w/the previous one) to be found.
+ * the scanner can't be used for other images until
+ * zbar_image_scanner_end_strips() is called, and the data handler is
+ * not called for strip scans
+ * @returns 0 for success, non-0 for failure
+ * @since 0.11
+ */
+extern int zbar_image_scanner_begin_strips(zbar_image_scanner_t *scanner,
+                                           unsigned width,
+                                           unsigned height);
+
+/** scan the next strip of the image started by
+ * zbar_image_scanner_begin_strips().  data holds rows [y, y + rows)
+ * of the image as "Y800" samples, width bytes per row.  strips must
+ * arrive in order w/out gaps, but may overlap: rows already seen are
+ * only used for the 2-D search
+ * @returns the number of symbols decoded so far, or -1 if an error
+ * occurs
+ * @since 0.11
+ */
+extern int zbar_scan_strip(zbar_image_scanner_t *scanner,
+                           const void *data,
+                           unsigned y,
+                           unsigned rows);
+
+/** finish a strip scan, even if the image was cut short.
+ * results are available from zbar_image_scanner_get_results()
+ * @returns the number of symbols decoded, or -1 if no strip scan was
+ * started
+ * @since 0.11
+ */
+extern int zbar_image_scanner_end_strips(zbar_image_scanner_t *scanner);
+
 /*@}*/
 
 /*------------------------------------------------------------*/
@@ -1492,6 +2005,7 @@ extern zbar_color_t zbar_scanner_get_color(const zbar_scanner_t *scanner);
 # include "zbar/Video.h"
 # include "zbar/Window.h"
 # include "zbar/Processor.h"
+# include "zbar/Capture.h"
 #endif
 
 #endif
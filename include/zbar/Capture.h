@@ -0,0 +1,153 @@
+//------------------------------------------------------------------------
+//  Copyright 2007-2010 (c) Jeff Brown <spadix@users.sourceforge.net>
+//
+//  This file is part of the ZBar Bar Code Reader.
+//
+//  The ZBar Bar Code Reader is free software; you can redistribute it
+//  and/or modify it under the terms of the GNU Lesser Public License as
+//  published by the Free Software Foundation; either version 2.1 of
+//  the License, or (at your option) any later version.
+//
+//  The ZBar Bar Code Reader is distributed in the hope that it will be
+//  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+//  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser Public License
+//  along with the ZBar Bar Code Reader; if not, write to the Free
+//  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+//  http://sourceforge.net/projects/zbar
+//------------------------------------------------------------------------
+#ifndef _ZBAR_CAPTURE_H_
+#define _ZBAR_CAPTURE_H_
+
+/// @file
+/// Multi-source capture C++ wrapper
+
+#ifndef _ZBAR_H_
+# error "include zbar.h in your application, **not** zbar/Capture.h"
+#endif
+
+#include "Exception.h"
+#include "Image.h"
+#include "Video.h"
+
+namespace zbar {
+
+/// captures and scans from several video devices at once.
+/// @since 0.11
+
+class Capture {
+ public:
+    /// abstract capture result handler.
+    /// applications should subtype this and pass an instance to
+    /// set_handler() to receive results from every source
+    class Handler {
+    public:
+        virtual ~Handler() { }
+
+        /// invoked by a library worker thread w/new results
+        /// from the indicated source
+        virtual void capture_callback(Image &image, int source) = 0;
+
+        /// cast this handler to the C handler
+        operator zbar_capture_data_handler_t* () const
+        {
+            return(_cb);
+        }
+
+    private:
+        static void _cb (zbar_image_t *zimg,
+                         int source,
+                         const void *userdata)
+        {
+            if(userdata) {
+                Image tmp(zimg, 1);
+                ((Handler*)userdata)->capture_callback(tmp, source);
+            }
+        }
+    };
+
+    /// constructor.
+    Capture (int workers = 1)
+    {
+        _capture = zbar_capture_create(workers);
+        if(!_capture)
+            throw std::bad_alloc();
+    }
+
+    ~Capture ()
+    {
+        zbar_capture_destroy(_capture);
+    }
+
+    /// cast to C capture object.
+    operator zbar_capture_t* ()
+    {
+        return(_capture);
+    }
+
+    /// add an opened video device as a capture source.
+    /// see zbar_capture_add_video()
+    int add_video (Video& video)
+    {
+        int id = zbar_capture_add_video(_capture, video);
+        if(id < 0)
+            throw_exception(_capture);
+        return(id);
+    }
+
+    /// setup result handler callback.
+    /// see zbar_capture_set_data_handler()
+    void set_handler (Handler& handler)
+    {
+        zbar_capture_set_data_handler(_capture, handler, &handler);
+    }
+
+    /// set config for indicated symbology (0 for all) to specified value.
+    /// @see zbar_capture_set_config()
+    int set_config (zbar_symbol_type_t symbology,
+                    zbar_config_t config,
+                    int value)
+    {
+        return(zbar_capture_set_config(_capture, symbology, config, value));
+    }
+
+    /// set config parsed from configuration string.
+    /// @see zbar_capture_parse_config()
+    int set_config (std::string cfgstr)
+    {
+        return(zbar_capture_parse_config(_capture, cfgstr.c_str()));
+    }
+
+    /// start/stop capturing from all sources.
+    /// see zbar_capture_set_active()
+    void set_active (bool active = true)
+    {
+        if(zbar_capture_set_active(_capture, active) < 0)
+            throw_exception(_capture);
+    }
+
+    /// retrieve the number of frames from a source that were never scanned.
+    /// see zbar_capture_get_dropped_frames()
+    unsigned long get_dropped_frames (int source)
+    {
+        return(zbar_capture_get_dropped_frames(_capture, source));
+    }
+
+    /// retrieve whether a source is still capturing.
+    /// see zbar_capture_get_source_active()
+    bool is_source_active (int source)
+    {
+        return(zbar_capture_get_source_active(_capture, source) > 0);
+    }
+
+ private:
+    zbar_capture_t *_capture;
+};
+
+}
+
+#endif
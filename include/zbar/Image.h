@@ -171,6 +171,22 @@ public:
         zbar_image_set_sequence(_img, sequence_num);
     }
 
+    /// retrieve the capture timestamp (ms) associated with this image.
+    /// see zbar_image_get_timestamp()
+    /// @since 0.11
+    unsigned long get_timestamp () const
+    {
+        return(zbar_image_get_timestamp(_img));
+    }
+
+    /// associate a capture timestamp (ms) with this image.
+    /// see zbar_image_set_timestamp()
+    /// @since 0.11
+    void set_timestamp (unsigned long msecs)
+    {
+        zbar_image_set_timestamp(_img, msecs);
+    }
+
     /// retrieve the width of the image.
     /// see zbar_image_get_width()
     unsigned get_width () const
@@ -278,6 +294,31 @@ public:
         throw FormatError();
     }
 
+    /// grayscale conversion of the crop rectangle w/integer downscale.
+    /// see zbar_image_convert_scaled()
+    /// @since 0.11
+    Image convert_scaled (unsigned long format,
+                          unsigned scale) const
+    {
+        zbar_image_t *img = zbar_image_convert_scaled(_img, format, scale);
+        if(img)
+            return(Image(img));
+        throw FormatError();
+    }
+
+    /// grayscale conversion using the color channel w/the most contrast.
+    /// see zbar_image_convert_contrast()
+    /// @since 0.11
+    Image convert_contrast (unsigned long format,
+                            unsigned tile = 0) const
+    {
+        zbar_image_t *img =
+            zbar_image_convert_contrast(_img, format, tile);
+        if(img)
+            return(Image(img));
+        throw FormatError();
+    }
+
     const SymbolSet get_symbols () const {
         return(SymbolSet(zbar_image_get_symbols(_img)));
     }
@@ -299,6 +340,7 @@ public:
 protected:
 
     friend class Video;
+    friend class Capture;
 
     /// constructor.
     /// @internal
@@ -121,6 +121,33 @@ public:
         return(*this);
     }
 
+    /// start scanning an image supplied in strips.
+    /// see zbar_image_scanner_begin_strips()
+    /// @since 0.11
+    int begin_strips (unsigned width,
+                      unsigned height)
+    {
+        return(zbar_image_scanner_begin_strips(_scanner, width, height));
+    }
+
+    /// scan the next strip of the image.
+    /// see zbar_scan_strip()
+    /// @since 0.11
+    int scan_strip (const void *data,
+                    unsigned y,
+                    unsigned rows)
+    {
+        return(zbar_scan_strip(_scanner, data, y, rows));
+    }
+
+    /// finish a strip scan.
+    /// see zbar_image_scanner_end_strips()
+    /// @since 0.11
+    int end_strips ()
+    {
+        return(zbar_image_scanner_end_strips(_scanner));
+    }
+
 private:
     zbar_image_scanner_t *_scanner;
 };
@@ -134,6 +134,38 @@ class Processor {
         return(SymbolSet(zbar_processor_get_results(_processor)));
     }
 
+    /// retrieve a descriptor signaled when new results are available.
+    /// see zbar_processor_get_fd()
+    /// @since 0.11
+    int get_fd ()
+    {
+        int fd = zbar_processor_get_fd(_processor);
+        if(fd < 0)
+            throw_exception(_processor);
+        return(fd);
+    }
+
+    /// retrieve the oldest pending results w/out blocking.
+    /// see zbar_processor_poll_results()
+    /// @since 0.11
+    const SymbolSet poll_results ()
+    {
+        const zbar_symbol_set_t *syms =
+            zbar_processor_poll_results(_processor);
+        SymbolSet result(syms);
+        if(syms)
+            zbar_symbol_set_ref(syms, -1);
+        return(result);
+    }
+
+    /// retrieve the number of captured frames that were never scanned.
+    /// see zbar_processor_get_dropped_frames()
+    /// @since 0.11
+    unsigned long get_dropped_frames ()
+    {
+        return(zbar_processor_get_dropped_frames(_processor));
+    }
+
     /// wait for input to the display window from the user.
     /// see zbar_processor_user_wait()
     int user_wait (int timeout = FOREVER)
@@ -214,6 +246,24 @@ class Processor {
             throw_exception(_processor);
     }
 
+    /// request a preferred number of video capture buffers.
+    /// see zbar_processor_request_buffers()
+    /// @since 0.11
+    void request_buffers (int num)
+    {
+        if(zbar_processor_request_buffers(_processor, num))
+            throw_exception(_processor);
+    }
+
+    /// request staged processing w/the specified number of scan workers.
+    /// see zbar_processor_request_workers()
+    /// @since 0.11
+    void request_workers (int workers)
+    {
+        if(zbar_processor_request_workers(_processor, workers))
+            throw_exception(_processor);
+    }
+
  private:
     zbar_processor_t *_processor;
 };
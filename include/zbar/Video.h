@@ -161,6 +161,74 @@ public:
             throw_exception(_video);
     }
 
+    /// request a preferred number of capture buffers.
+    /// see zbar_video_request_buffers()
+    /// @since 0.11
+    void request_buffers (int num)
+    {
+        if(zbar_video_request_buffers(_video, num))
+            throw_exception(_video);
+    }
+
+    /// copy single buffer frames only when they are held.
+    /// see zbar_video_set_copy_on_hold()
+    /// @since 0.11
+    void set_copy_on_hold (bool enable = true)
+    {
+        if(zbar_video_set_copy_on_hold(_video, enable))
+            throw_exception(_video);
+    }
+
+    /// supply dma-buf descriptors to back the capture buffers.
+    /// see zbar_video_import_dmabufs()
+    /// @since 0.11
+    void import_dmabufs (const int *fds,
+                         int num)
+    {
+        if(zbar_video_import_dmabufs(_video, fds, num))
+            throw_exception(_video);
+    }
+
+    /// enable or disable skipping to the newest captured frame.
+    /// see zbar_video_set_latest_frame()
+    /// @since 0.11
+    void set_latest_frame (bool latest = true)
+    {
+        if(zbar_video_set_latest_frame(_video, latest))
+            throw_exception(_video);
+    }
+
+    /// retrieve the number of stale frames skipped.
+    /// see zbar_video_get_dropped_frames()
+    /// @since 0.11
+    unsigned long get_dropped_frames () const
+    {
+        return(zbar_video_get_dropped_frames(_video));
+    }
+
+    /// set a region of interest for capture.
+    /// see zbar_video_set_roi()
+    /// @since 0.11
+    void set_roi (unsigned x,
+                  unsigned y,
+                  unsigned width,
+                  unsigned height)
+    {
+        if(zbar_video_set_roi(_video, x, y, width, height))
+            throw_exception(_video);
+    }
+
+    /// retrieve the capture region of interest.
+    /// see zbar_video_get_roi()
+    /// @since 0.11
+    void get_roi (unsigned &x,
+                  unsigned &y,
+                  unsigned &width,
+                  unsigned &height) const
+    {
+        zbar_video_get_roi(_video, &x, &y, &width, &height);
+    }
+
 private:
     zbar_video_t *_video;
 };
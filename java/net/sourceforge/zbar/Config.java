@@ -48,9 +48,20 @@ public class Config
 
     /** Enable scanner to collect position data. */
     public static final int POSITION = 0x80;
+    /** Follow 2D symbols between video frames. */
+    public static final int TRACKING = 0x81;
 
     /** Image scanner vertical scan density. */
     public static final int X_DENSITY = 0x100;
     /** Image scanner horizontal scan density. */
     public static final int Y_DENSITY = 0x101;
+    /** Image scanner structured append reassembly time (ms). */
+    public static final int SA_TIMEOUT = 0x102;
+    /** Image scanner reduced resolution levels. */
+    public static final int PYRAMID = 0x103;
+
+    /** Processor video skips stale frames. */
+    public static final int LATEST_FRAME = 0x200;
+    /** Processor frames skipped while the scene is static. */
+    public static final int SKIP_STATIC = 0x201;
 }
@@ -155,10 +155,20 @@ Decoder configuration constants:
 
 =item Config::POSITION
 
+=item Config::TRACKING
+
 =item Config::X_DENSITY
 
 =item Config::Y_DENSITY
 
+=item Config::SA_TIMEOUT
+
+=item Config::PYRAMID
+
+=item Config::LATEST_FRAME
+
+=item Config::SKIP_STATIC
+
 =back
 
 Symbology modifier constants:
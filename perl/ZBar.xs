@@ -290,8 +290,13 @@ BOOT:
         CONSTANT(config, CFG_, MAX_LEN, "max-length");
         CONSTANT(config, CFG_, UNCERTAINTY, "uncertainty");
         CONSTANT(config, CFG_, POSITION, "position");
+        CONSTANT(config, CFG_, TRACKING, "tracking");
         CONSTANT(config, CFG_, X_DENSITY, "x-density");
         CONSTANT(config, CFG_, Y_DENSITY, "y-density");
+        CONSTANT(config, CFG_, SA_TIMEOUT, "sa-timeout");
+        CONSTANT(config, CFG_, PYRAMID, "pyramid");
+        CONSTANT(config, CFG_, LATEST_FRAME, "latest-frame");
+        CONSTANT(config, CFG_, SKIP_STATIC, "skip-static");
     }
 
 MODULE = Barcode::ZBar  PACKAGE = Barcode::ZBar::Modifier  PREFIX = zbar_mod_
@@ -3,7 +3,7 @@ from distutils.core import setup, Extension
 
 setup(
     name = 'zbar',
-    version = '0.10',
+    version = '0.11',
     author = 'Jeff Brown',
     author_email = 'spadix@users.sourceforge.net',
     url = 'http://zbar.sourceforge.net',
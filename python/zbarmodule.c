@@ -72,8 +72,13 @@ static const enumdef config_defs[] = {
     { "MAX_LEN",        ZBAR_CFG_MAX_LEN },
     { "UNCERTAINTY",    ZBAR_CFG_UNCERTAINTY },
     { "POSITION",       ZBAR_CFG_POSITION },
+    { "TRACKING",       ZBAR_CFG_TRACKING },
     { "X_DENSITY",      ZBAR_CFG_X_DENSITY },
     { "Y_DENSITY",      ZBAR_CFG_Y_DENSITY },
+    { "SA_TIMEOUT",     ZBAR_CFG_SA_TIMEOUT },
+    { "PYRAMID",        ZBAR_CFG_PYRAMID },
+    { "LATEST_FRAME",   ZBAR_CFG_LATEST_FRAME },
+    { "SKIP_STATIC",    ZBAR_CFG_SKIP_STATIC },
     { NULL, }
 };
 
@@ -0,0 +1,369 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* conversion micro-benchmark: times conversion of the common packed
+ * camera/scanner formats to Y800 and checks the results against a
+ * straightforward reference, so the optimized paths can't silently
+ * regress in either speed or output
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <zbar.h>
+#ifdef HAVE_LIBJPEG
+# include <jpeglib.h>
+#endif
+
+#define fourcc zbar_fourcc
+
+typedef struct bench_format_s {
+    uint32_t format;
+    int bpp;            /* bytes per pixel (2 for packed YUV) */
+    int y, r, g, b;     /* byte offsets of luma or color components */
+} bench_format_t;
+
+static const bench_format_t formats[] = {
+    { fourcc('Y','U','Y','V'), 2, 0, },
+    { fourcc('U','Y','V','Y'), 2, 1, },
+    { fourcc('Y','V','Y','U'), 2, 0, },
+    { fourcc('R','G','B','3'), 3, -1, 0, 1, 2 },
+    { fourcc('B','G','R','3'), 3, -1, 2, 1, 0 },
+    { fourcc('R','G','B','4'), 4, -1, 1, 2, 3 },
+    { fourcc('B','G','R','4'), 4, -1, 2, 1, 0 },
+    { 0, }
+};
+
+static const unsigned sizes[][2] = {
+    { 640, 480 },
+    { 1280, 720 },
+    { 1920, 1080 },
+    { 4096, 3072 },
+    /* sizes that are not a multiple of the vector width exercise the
+     * scalar tails (NB packed YUV needs an even width)
+     */
+    { 334, 97 },
+    { 0, }
+};
+
+static double now (void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return(tv.tv_sec * 1000. + tv.tv_usec / 1000.);
+}
+
+static int check (const bench_format_t *fmt,
+                  const uint8_t *src,
+                  const uint8_t *dst,
+                  unsigned w,
+                  unsigned h)
+{
+    unsigned x, y;
+    for(y = 0; y < h; y++)
+        for(x = 0; x < w; x++) {
+            const uint8_t *p = src + (y * w + x) * fmt->bpp;
+            int expect;
+            if(fmt->y >= 0)
+                expect = p[fmt->y];
+            else
+                expect = (77 * p[fmt->r] + 150 * p[fmt->g] +
+                          29 * p[fmt->b] + 0x80) >> 8;
+            if(dst[y * w + x] != expect) {
+                fprintf(stderr, "%.4s %ux%u: mismatch @(%u,%u): %d != %d\n",
+                        (char*)&fmt->format, w, h, x, y,
+                        dst[y * w + x], expect);
+                return(1);
+            }
+        }
+    return(0);
+}
+
+/* crop rectangle used to check the fused crop/downscale conversion */
+static const unsigned crop[4] = { 100, 50, 1600, 900 };
+
+static int check_scaled (const bench_format_t *fmt,
+                         const uint8_t *full,
+                         const zbar_image_t *dst,
+                         unsigned w,
+                         unsigned scale)
+{
+    const uint8_t *data = zbar_image_get_data(dst);
+    unsigned dw = zbar_image_get_width(dst);
+    unsigned dh = zbar_image_get_height(dst);
+    unsigned x, y, i, j, n = scale * scale;
+    if(dw != crop[2] / scale || dh != crop[3] / scale) {
+        fprintf(stderr, "%.4s /%u: bad size %ux%u\n",
+                (char*)&fmt->format, scale, dw, dh);
+        return(1);
+    }
+    for(y = 0; y < dh; y++)
+        for(x = 0; x < dw; x++) {
+            const uint8_t *p = full + (crop[1] + y * scale) * w +
+                crop[0] + x * scale;
+            unsigned sum = 0;
+            for(j = 0; j < scale; j++, p += w)
+                for(i = 0; i < scale; i++)
+                    sum += p[i];
+            if(data[y * dw + x] != (sum + n / 2) / n) {
+                fprintf(stderr, "%.4s /%u: mismatch @(%u,%u): %d != %d\n",
+                        (char*)&fmt->format, scale, x, y,
+                        data[y * dw + x], (sum + n / 2) / n);
+                return(1);
+            }
+        }
+    return(0);
+}
+
+#ifdef HAVE_LIBJPEG
+/* JPEG crop checked against the same region of a full decode
+ * (NB aligned to the 2x downscaled iMCU grid)
+ */
+#define JPEG_W 256
+#define JPEG_H 192
+static const unsigned jpeg_crop[4] = { 48, 80, 96, 64 };
+
+/* compress a smooth grayscale test pattern */
+static zbar_image_t *make_jpeg (void)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buf = NULL;
+    unsigned long len = 0;
+    uint8_t row[JPEG_W];
+    JSAMPROW rows[1] = { row };
+    zbar_image_t *img;
+    unsigned x;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buf, &len);
+    cinfo.image_width = JPEG_W;
+    cinfo.image_height = JPEG_H;
+    cinfo.input_components = 1;
+    cinfo.in_color_space = JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while(cinfo.next_scanline < JPEG_H) {
+        unsigned y = cinfo.next_scanline;
+        for(x = 0; x < JPEG_W; x++)
+            row[x] = (x * 3 + y * 5 + ((x / 16 + y / 16) & 1) * 64) & 0xff;
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    img = zbar_image_create();
+    zbar_image_set_format(img, fourcc('J','P','E','G'));
+    zbar_image_set_size(img, JPEG_W, JPEG_H);
+    zbar_image_set_data(img, buf, len, zbar_image_free_data);
+    return(img);
+}
+
+/* a cropped decode, optionally scaled in the IDCT, must match the
+ * crop of a full decode at the same scale.  both draw from the pool
+ */
+static int check_jpeg (zbar_image_pool_t *pool)
+{
+    zbar_image_t *img = make_jpeg();
+    unsigned scale;
+    int rc = 0;
+    for(scale = 1; scale <= 2 && !rc; scale *= 2) {
+        unsigned fw = JPEG_W / scale, fh = JPEG_H / scale;
+        unsigned cx = jpeg_crop[0] / scale, cy = jpeg_crop[1] / scale;
+        unsigned cw = jpeg_crop[2] / scale, ch = jpeg_crop[3] / scale;
+        zbar_image_t *full, *sc;
+        const uint8_t *f, *d;
+        unsigned x, y;
+
+        zbar_image_set_crop(img, 0, 0, JPEG_W, JPEG_H);
+        full = zbar_image_pool_convert_resize(pool, img,
+                                              fourcc('Y','8','0','0'), fw, fh);
+        zbar_image_set_crop(img, jpeg_crop[0], jpeg_crop[1],
+                            jpeg_crop[2], jpeg_crop[3]);
+        sc = zbar_image_pool_convert_scaled(pool, img,
+                                            fourcc('Y','8','0','0'), scale);
+        if(!full || !sc) {
+            fprintf(stderr, "JPEG /%u: conversion failed\n", scale);
+            rc = 1;
+        }
+        else if(zbar_image_get_width(full) != fw ||
+                zbar_image_get_width(sc) != cw ||
+                zbar_image_get_height(sc) != ch) {
+            fprintf(stderr, "JPEG /%u: bad size %ux%u\n", scale,
+                    zbar_image_get_width(sc), zbar_image_get_height(sc));
+            rc = 1;
+        }
+        else {
+            f = zbar_image_get_data(full);
+            d = zbar_image_get_data(sc);
+            for(y = 0; y < ch && !rc; y++)
+                for(x = 0; x < cw; x++)
+                    if(d[y * cw + x] != f[(cy + y) * fw + cx + x]) {
+                        fprintf(stderr,
+                                "JPEG /%u: mismatch @(%u,%u): %d != %d\n",
+                                scale, x, y, d[y * cw + x],
+                                f[(cy + y) * fw + cx + x]);
+                        rc = 1;
+                        break;
+                    }
+        }
+        if(full)
+            zbar_image_destroy(full);
+        if(sc)
+            zbar_image_destroy(sc);
+    }
+    zbar_image_destroy(img);
+    return(rc);
+}
+#endif
+
+int main (int argc, char *argv[])
+{
+    int iters = 50, quiet = 0, rc = 0, i, opt;
+    const bench_format_t *fmt;
+    zbar_image_pool_t *pool = zbar_image_pool_create();
+
+    while((opt = getopt(argc, argv, "n:t:q")) != -1) {
+        if(opt == 'n')
+            iters = atoi(optarg);
+        else if(opt == 't')
+            zbar_image_convert_set_threads(atoi(optarg));
+        else if(opt == 'q')
+            quiet = 1;
+        else {
+            fprintf(stderr, "usage: %s [-n iterations] [-t threads] [-q]\n",
+                    argv[0]);
+            return(2);
+        }
+    }
+
+    srand(0x5eed);
+    for(fmt = formats; fmt->format; fmt++) {
+        int s;
+        for(s = 0; sizes[s][0]; s++) {
+            unsigned w = sizes[s][0], h = sizes[s][1];
+            unsigned long len = (unsigned long)w * h * fmt->bpp;
+            uint8_t *data = malloc(len);
+            zbar_image_t *img = zbar_image_create(), *gray = NULL;
+            unsigned long j;
+            double t0, t;
+
+            for(j = 0; j < len; j++)
+                data[j] = rand();
+            zbar_image_set_format(img, fmt->format);
+            zbar_image_set_size(img, w, h);
+            zbar_image_set_data(img, data, len, zbar_image_free_data);
+
+            t0 = now();
+            for(i = 0; i < iters; i++) {
+                if(gray)
+                    zbar_image_destroy(gray);
+                gray = zbar_image_convert(img, fourcc('Y','8','0','0'));
+                if(!gray) {
+                    fprintf(stderr, "%.4s %ux%u: conversion failed\n",
+                            (char*)&fmt->format, w, h);
+                    return(1);
+                }
+            }
+            t = (now() - t0) / iters;
+
+            if(check(fmt, data, zbar_image_get_data(gray), w, h))
+                rc = 1;
+            else if(!quiet)
+                printf("%.4s -> Y800 %4ux%-4u %8.3f ms %8.1f Mpix/s\n",
+                       (char*)&fmt->format, w, h, t,
+                       (t > 0) ? w * h / (t * 1000.) : 0.);
+
+            /* same again, w/output buffers recycled through a pool */
+            zbar_image_destroy(gray);
+            gray = NULL;
+            t0 = now();
+            for(i = 0; i < iters; i++) {
+                if(gray)
+                    zbar_image_destroy(gray);
+                gray = zbar_image_pool_convert(pool, img,
+                                               fourcc('Y','8','0','0'));
+                if(!gray) {
+                    fprintf(stderr, "%.4s %ux%u: pooled conversion failed\n",
+                            (char*)&fmt->format, w, h);
+                    return(1);
+                }
+            }
+            t = (now() - t0) / iters;
+
+            if(check(fmt, data, zbar_image_get_data(gray), w, h))
+                rc = 1;
+            else if(!quiet)
+                printf("%.4s -> Y800 %4ux%-4u %8.3f ms (pooled)\n",
+                       (char*)&fmt->format, w, h, t);
+
+            if(w >= crop[0] + crop[2] && h >= crop[1] + crop[3]) {
+                unsigned scale;
+                zbar_image_set_crop(img, crop[0], crop[1], crop[2], crop[3]);
+                for(scale = 1; scale <= 4; scale++) {
+                    zbar_image_t *sc = NULL;
+                    t0 = now();
+                    for(i = 0; i < iters; i++) {
+                        if(sc)
+                            zbar_image_destroy(sc);
+                        sc = zbar_image_pool_convert_scaled(
+                            pool, img, fourcc('Y','8','0','0'), scale);
+                        if(!sc) {
+                            fprintf(stderr, "%.4s /%u: conversion failed\n",
+                                    (char*)&fmt->format, scale);
+                            return(1);
+                        }
+                    }
+                    t = (now() - t0) / iters;
+                    if(check_scaled(fmt, zbar_image_get_data(gray), sc,
+                                    w, scale))
+                        rc = 1;
+                    else if(!quiet)
+                        printf("%.4s -> Y800 %4ux%-4u /%u %5.3f ms\n",
+                               (char*)&fmt->format, crop[2], crop[3],
+                               scale, t);
+                    zbar_image_destroy(sc);
+                }
+            }
+
+            zbar_image_destroy(gray);
+            zbar_image_destroy(img);
+        }
+    }
+
+#ifdef HAVE_LIBJPEG
+    if(check_jpeg(pool))
+        rc = 1;
+    else if(!quiet)
+        printf("JPEG -> Y800 cropped decode ok\n");
+#endif
+    zbar_image_pool_destroy(pool);
+    return(rc);
+}
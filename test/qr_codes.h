@@ -0,0 +1,94 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+#ifndef _QR_CODES_H_
+#define _QR_CODES_H_
+
+/* module patterns of two QR codes, for tests that place them in
+ * synthetic frames
+ */
+
+/* version 1-L, byte mode, mask 0 */
+static const char *const qr_codes[2][21] = { {
+    "#######...#.#.#######",
+    "#.....#.....#.#.....#",
+    "#.###.#.#.#...#.###.#",
+    "#.###.#.....#.#.###.#",
+    "#.###.#..#.##.#.###.#",
+    "#.....#..###..#.....#",
+    "#######.#.#.#.#######",
+    "........#.#..........",
+    "###.#####.#.###...#..",
+    ".#####...#.#..##.#.#.",
+    "#...###...##.#.######",
+    "..#.##.##..##...#..#.",
+    "#.##.###..##..#.####.",
+    "........#.#....#.#.#.",
+    "#######.##..#.###..##",
+    "#.....#.##.....#...##",
+    "#.###.#.#.#.#.#.#.#..",
+    "#.###.#..#.#...##..#.",
+    "#.###.#.##.#.##.##..#",
+    "#.....#.##.###.....#.",
+    "#######.####..###.###",
+}, {
+    "#######..#.##.#######",
+    "#.....#..###..#.....#",
+    "#.###.#.##.##.#.###.#",
+    "#.###.#..#.#..#.###.#",
+    "#.###.#...#.#.#.###.#",
+    "#.....#.....#.#.....#",
+    "#######.#.#.#.#######",
+    "........##.##........",
+    "###.########.##...#..",
+    "##.#.#.###....#...###",
+    "#.#####.###.#...#####",
+    "#.#.##..###...#.....#",
+    "..#.####....#.#.#...#",
+    "........#.##.#.#.#..#",
+    "#######.##.#.###.####",
+    "#.....#.#..###.##....",
+    "#.###.#.##.#.###...##",
+    "#.###.#..##...##..##.",
+    "#.###.#.#...#...#.#.#",
+    "#.....#.###...##...#.",
+    "#######.##..#.##...##",
+} };
+
+static const char *const qr_data[2] = { "LARGE CODE", "small" };
+
+/* draw QR code id w/its top left corner at x0,y0 of an 8 bit luma
+ * plane w/the given stride, w/size pixels per module
+ */
+static void draw_qr (uint8_t *data,
+                     unsigned stride,
+                     int id,
+                     unsigned x0,
+                     unsigned y0,
+                     unsigned size)
+{
+    unsigned x, y;
+    for(y = 0; y < 21 * size; y++)
+        for(x = 0; x < 21 * size; x++)
+            if(qr_codes[id][y / size][x / size] == '#')
+                data[(y0 + y) * stride + x0 + x] = 0;
+}
+
+#endif
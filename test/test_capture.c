@@ -0,0 +1,194 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks multi-source capture: two y4m files, each showing a different
+ * QR code, are captured and scanned concurrently.  every source must
+ * report its own code (and only that), and must stop when its file ends.
+ * the first file is paced at a low frame rate, which must not hold up
+ * the other one
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define WIDTH  320
+#define HEIGHT 240
+#define FRAMES 8
+#define MODULE 6
+#define FPS    5
+
+static char filenames[2][32] = {
+    "/tmp/zbar_capture0_XXXXXX",
+    "/tmp/zbar_capture1_XXXXXX",
+};
+
+/* results reported for each source.  a source is only scanned by one
+ * worker at a time, so its counters need no locking
+ */
+static int found[2], wrong[2];
+
+/* write a mono y4m stream of identical frames showing the code */
+static int write_y4m (int id)
+{
+    uint8_t frame[WIDTH * HEIGHT];
+    FILE *f;
+    int i, fd = mkstemp(filenames[id]);
+    if(fd < 0 || !(f = fdopen(fd, "wb"))) {
+        perror(filenames[id]);
+        return(-1);
+    }
+
+    memset(frame, 0xff, sizeof(frame));
+    draw_qr(frame, WIDTH, id, (WIDTH - 21 * MODULE) / 2,
+            (HEIGHT - 21 * MODULE) / 2, MODULE);
+
+    fprintf(f, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 Cmono\n", WIDTH, HEIGHT);
+    for(i = 0; i < FRAMES; i++) {
+        fprintf(f, "FRAME\n");
+        fwrite(frame, 1, sizeof(frame), f);
+    }
+    fclose(f);
+    return(0);
+}
+
+static void data_handler (zbar_image_t *img,
+                          int source,
+                          const void *userdata)
+{
+    const zbar_symbol_t *sym = zbar_image_first_symbol(img);
+    if(source < 0 || source > 1) {
+        fprintf(stderr, "results from unknown source %d\n", source);
+        return;
+    }
+    for(; sym; sym = zbar_symbol_next(sym))
+        if(!strcmp(zbar_symbol_get_data(sym), qr_data[source]))
+            found[source]++;
+        else
+            wrong[source]++;
+}
+
+/* run capture until both files end (or time runs out) */
+static int check_capture (zbar_capture_t *cap)
+{
+    zbar_video_t *video[2];
+    int i, ms, rc = 0, stopped[2] = { -1, -1 };
+
+    for(i = 0; i < 2; i++) {
+        char dev[80];
+        snprintf(dev, sizeof(dev), "file:%s?fps=%d", filenames[i],
+                 (i) ? 0 : FPS);
+        video[i] = zbar_video_create();
+        if(zbar_video_open(video[i], dev) ||
+           zbar_capture_add_video(cap, video[i]) != i) {
+            fprintf(stderr, "unable to add capture source %d\n", i);
+            zbar_video_error_spew(video[i], 0);
+            return(1);
+        }
+    }
+
+    zbar_capture_set_data_handler(cap, data_handler, NULL);
+    if(zbar_capture_set_active(cap, 1)) {
+        zbar_capture_error_spew(cap, 0);
+        return(1);
+    }
+    for(ms = 0; ms < 5000; ms += 10) {
+        for(i = 0; i < 2; i++)
+            if(stopped[i] < 0 && !zbar_capture_get_source_active(cap, i))
+                stopped[i] = ms;
+        if(stopped[0] >= 0 && stopped[1] >= 0)
+            break;
+        usleep(10000);
+    }
+    if(ms >= 5000) {
+        fprintf(stderr, "capture sources did not stop at end of file\n");
+        rc = 1;
+    }
+    else if(stopped[1] >= stopped[0] / 2) {
+        fprintf(stderr, "unpaced source took %dms, paced %dms\n",
+                stopped[1], stopped[0]);
+        rc = 1;
+    }
+    zbar_capture_set_active(cap, 0);
+
+    for(i = 0; i < 2; i++) {
+        if(!found[i] || wrong[i]) {
+            fprintf(stderr, "source %d: found %d \"%s\", %d others\n",
+                    i, found[i], qr_data[i], wrong[i]);
+            rc = 1;
+        }
+        zbar_video_destroy(video[i]);
+    }
+    return(rc);
+}
+
+/* settings are checked before they are stored for the sources */
+static int check_config (zbar_capture_t *cap)
+{
+    int rc = 0;
+    if(zbar_capture_set_config(cap, 0, ZBAR_CFG_ENABLE, 0) ||
+       zbar_capture_set_config(cap, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1)) {
+        fprintf(stderr, "valid capture setting rejected\n");
+        rc = 1;
+    }
+    if(!zbar_capture_set_config(cap, 0, ZBAR_CFG_POSITION, 2) ||
+       !zbar_capture_set_config(cap, ZBAR_QRCODE, ZBAR_CFG_X_DENSITY, 1)) {
+        fprintf(stderr, "invalid capture setting accepted\n");
+        rc = 1;
+    }
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    zbar_capture_t *cap;
+    int rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(32);
+
+    cap = zbar_capture_create(2);
+    if(!cap) {
+        printf("multi-source capture not supported\n");
+        return(0);
+    }
+    if(write_y4m(0) || write_y4m(1))
+        return(2);
+
+    rc = check_config(cap) | check_capture(cap);
+    zbar_capture_destroy(cap);
+    unlink(filenames[0]);
+    unlink(filenames[1]);
+    if(!rc)
+        printf("capture scanned both sources\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
@@ -0,0 +1,217 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks the header parsing of zbar_image_open_mapped(): small image
+ * files are written to a temporary file and the mapped result compared
+ * w/what was written, or the file must be rejected
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zbar.h>
+
+#define fourcc zbar_fourcc
+
+#define W 16
+#define H 8
+
+static char filename[] = "/tmp/zbar_mapped_XXXXXX";
+static int failed = 0;
+
+/* sample value written at x,y of the first plane */
+static inline uint8_t pixel (unsigned x,
+                             unsigned y)
+{
+    return(x * 7 + y * 31 + 1);
+}
+
+static void write_file (const void *hdr,
+                        unsigned hdrlen,
+                        unsigned long datalen)
+{
+    FILE *f = fopen(filename, "wb");
+    unsigned long i;
+    if(!f) {
+        perror(filename);
+        exit(2);
+    }
+    fwrite(hdr, 1, hdrlen, f);
+    for(i = 0; i < datalen; i++)
+        fputc((i < W * H) ? pixel(i % W, i / W) : 0x80, f);
+    fclose(f);
+}
+
+/* map the file just written and check it against the expectation,
+ * format 0 expects the file to be rejected
+ */
+static void check (const char *name,
+                   uint32_t format,
+                   unsigned long datalen)
+{
+    zbar_image_t *img = zbar_image_open_mapped(filename);
+    const uint8_t *data;
+    unsigned x, y;
+
+    if(!format) {
+        if(img) {
+            unsigned long fmt = zbar_image_get_format(img);
+            fprintf(stderr, "%s: mapped %.4s, expected rejection\n",
+                    name, (char*)&fmt);
+            zbar_image_destroy(img);
+            failed = 1;
+        }
+        return;
+    }
+    if(!img) {
+        fprintf(stderr, "%s: not mapped\n", name);
+        failed = 1;
+        return;
+    }
+    if(zbar_image_get_format(img) != format ||
+       zbar_image_get_width(img) != W || zbar_image_get_height(img) != H ||
+       zbar_image_get_data_length(img) != datalen) {
+        unsigned long fmt = zbar_image_get_format(img);
+        fprintf(stderr,
+                "%s: mapped %.4s %ux%u %lu, expected %.4s %ux%u %lu\n",
+                name, (char*)&fmt, zbar_image_get_width(img),
+                zbar_image_get_height(img), zbar_image_get_data_length(img),
+                (char*)&format, W, H, datalen);
+        failed = 1;
+    }
+    else {
+        data = zbar_image_get_data(img);
+        for(y = 0; y < H; y++)
+            for(x = 0; x < W; x++)
+                if(data[y * W + x] != pixel(x, y)) {
+                    fprintf(stderr, "%s: mismatch @(%u,%u): %d != %d\n",
+                            name, x, y, data[y * W + x], pixel(x, y));
+                    failed = 1;
+                    y = H;
+                    break;
+                }
+    }
+    zbar_image_destroy(img);
+}
+
+static void check_y4m (const char *colorspace,
+                       uint32_t format,
+                       unsigned long datalen)
+{
+    char hdr[128], name[32];
+    int n = snprintf(hdr, sizeof(hdr),
+                     "YUV4MPEG2 W%d H%d F30:1 Ip A1:1%s%s\nFRAME\n",
+                     W, H, (*colorspace) ? " C" : "", colorspace);
+    /* enough data for the widest variant */
+    write_file(hdr, n, W * H * 4);
+    snprintf(name, sizeof(name), "y4m C%s", colorspace);
+    check(name, format, datalen);
+}
+
+/* little endian TIFF w/a single strip.  bits 0 omits BitsPerSample */
+static void check_tiff (unsigned bits,
+                        uint32_t format)
+{
+    uint8_t hdr[256], *p = hdr + 10;
+    unsigned n = 0, offset;
+    uint16_t tags[][2] = {
+        { 256, W }, { 257, H }, { 258, bits }, { 259, 1 }, { 262, 1 },
+        { 273, 0 }, { 277, 1 }, { 279, W * H },
+    };
+    unsigned i, ntags = sizeof(tags) / sizeof(*tags);
+    char name[32];
+
+    memcpy(hdr, "II*\0\x08\0\0\0", 8);
+    offset = 10 + (ntags - !bits) * 12 + 4;
+    for(i = 0; i < ntags; i++) {
+        unsigned val = (tags[i][0] == 273) ? offset : tags[i][1];
+        if(tags[i][0] == 258 && !bits)
+            continue;
+        memset(p, 0, 12);
+        p[0] = tags[i][0];
+        p[1] = tags[i][0] >> 8;
+        p[2] = 3;           /* SHORT */
+        p[4] = 1;           /* count */
+        p[8] = val;
+        p[9] = val >> 8;
+        p += 12;
+        n++;
+    }
+    hdr[8] = n;
+    hdr[9] = 0;
+    memset(p, 0, 4);        /* no next IFD */
+    p += 4;
+    write_file(hdr, p - hdr, W * H);
+    snprintf(name, sizeof(name), "TIFF BitsPerSample=%u", bits);
+    check(name, format, W * H);
+}
+
+int main (int argc, char *argv[])
+{
+    int fd = mkstemp(filename);
+    char pgm[32];
+    int n;
+    if(fd < 0) {
+        perror(filename);
+        return(2);
+    }
+    close(fd);
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(16);
+
+    check_y4m("", fourcc('I','4','2','0'), W * H * 3 / 2);
+    check_y4m("420jpeg", fourcc('I','4','2','0'), W * H * 3 / 2);
+    check_y4m("420mpeg2", fourcc('I','4','2','0'), W * H * 3 / 2);
+    check_y4m("422", fourcc('4','2','2','P'), W * H * 2);
+    check_y4m("444", fourcc('Y','8','0','0'), W * H);
+    check_y4m("mono", fourcc('Y','8','0','0'), W * H);
+    /* wider samples can not be mapped as 8 bit */
+    check_y4m("420p10", 0, 0);
+    check_y4m("420p12", 0, 0);
+    check_y4m("444p16", 0, 0);
+    check_y4m("mono16", 0, 0);
+
+    check_tiff(8, fourcc('Y','8','0','0'));
+    check_tiff(16, 0);
+    /* BitsPerSample defaults to 1 */
+    check_tiff(0, 0);
+
+    n = snprintf(pgm, sizeof(pgm), "P5\n%d %d\n255\n", W, H);
+    write_file(pgm, n, W * H);
+    check("PGM", fourcc('Y','8','0','0'), W * H);
+    n = snprintf(pgm, sizeof(pgm), "P5 # c\n%d\t%d 255 ", W, H);
+    write_file(pgm, n, W * H);
+    check("PGM w/comment", fourcc('Y','8','0','0'), W * H);
+    /* maxval must be followed by a single whitespace */
+    n = snprintf(pgm, sizeof(pgm), "P5\n%d %d\n255", W, H);
+    write_file(pgm, n, W * H);
+    check("PGM w/o data separator", 0, 0);
+
+    unlink(filename);
+    if(!failed)
+        printf("mapped image headers ok\n");
+    return(failed);
+}
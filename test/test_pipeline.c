@@ -0,0 +1,320 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks the staged frame pipeline (zbar_processor_request_workers())
+ * w/y4m files played through a processor:
+ *   - every frame shows a different EAN-13, so each frame scanned is
+ *     reported, and results must arrive in capture order
+ *   - a QR code standing still is found anew by every worker, but must
+ *     only be reported once
+ *   - a setting changed while streaming must reach all of the workers
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define WIDTH   640
+#define HEIGHT  480
+#define WORKERS 2
+#define FRAMES  24              /* frames w/a different EAN-13 each */
+#define STILL   15              /* frames w/the same QR code */
+#define FPS     20              /* pace of the settings check */
+
+static char filename[] = "/tmp/zbar_pipeline_XXXXXX";
+
+/* results seen by the data handler, which is only called from the
+ * pipeline output thread
+ */
+static volatile int nreports, found[2];
+static int reported[FRAMES], order_ok, wrong;
+static unsigned last_seq;
+
+/* EAN-13 digit patterns (L code, others derived) and the parity of
+ * the left half selected by the first digit
+ */
+static const char *const ean_l[10] = {
+    "0001101", "0011001", "0010011", "0111101", "0100011",
+    "0110001", "0101111", "0111011", "0110111", "0001011",
+};
+static const char *const ean_parity[10] = {
+    "LLLLLL", "LLGLGG", "LLGGLG", "LLGGGL", "LGLLGG",
+    "LGGLLG", "LGGGLL", "LGLGLG", "LGLGGL", "LGGLGL",
+};
+
+/* 12 digits encoding n, plus the check digit */
+static void ean_data (char *data,
+                      int n)
+{
+    int i, sum = 0;
+    snprintf(data, 14, "200000000%03d", n % 1000);
+    for(i = 0; i < 12; i++)
+        sum += (data[i] - '0') * ((i & 1) ? 3 : 1);
+    data[12] = '0' + (10 - sum % 10) % 10;
+    data[13] = '\0';
+}
+
+/* draw the EAN-13 for n w/2 pixel modules */
+static void draw_ean (uint8_t *frame,
+                      int n)
+{
+    char data[14], bits[96] = "101";
+    int i, j, x, y;
+    ean_data(data, n);
+    for(i = 1; i < 13; i++) {
+        const char *l = ean_l[data[i] - '0'];
+        char c = (i > 6) ? 'R' : ean_parity[data[0] - '0'][i - 1];
+        if(i == 7)
+            strcat(bits, "01010");
+        for(j = 0; j < 7; j++) {
+            char b = (c == 'G') ? l[6 - j] : l[j];
+            if(c != 'L')
+                b ^= 1;
+            strncat(bits, &b, 1);
+        }
+    }
+    strcat(bits, "101");
+
+    x = (WIDTH - 2 * 95) / 2;
+    for(y = 20; y < 100; y++)
+        for(i = 0; i < 95; i++)
+            if(bits[i] == '1')
+                frame[y * WIDTH + x + 2 * i] =
+                    frame[y * WIDTH + x + 2 * i + 1] = 0;
+}
+
+/* write frames showing EAN-13s (id < 0) or QR code id.  w/mixed set,
+ * the second half of the frames shows the other QR code and an EAN-13
+ */
+static int write_y4m (int nframes,
+                      int fps,
+                      int id,
+                      int mixed)
+{
+    uint8_t frame[WIDTH * HEIGHT];
+    FILE *f;
+    int i, fd;
+    strcpy(filename + sizeof(filename) - 7, "XXXXXX");
+    fd = mkstemp(filename);
+    if(fd < 0 || !(f = fdopen(fd, "wb"))) {
+        perror(filename);
+        return(-1);
+    }
+
+    fprintf(f, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", WIDTH, HEIGHT,
+            fps);
+    for(i = 0; i < nframes; i++) {
+        int second = (mixed && i >= nframes / 2);
+        memset(frame, 0xff, sizeof(frame));
+        if(id < 0 || second)
+            draw_ean(frame, i);
+        if(id >= 0)
+            draw_qr(frame, WIDTH, (second) ? !id : id,
+                    (WIDTH - 21 * 5) / 2, 110, 5);
+        fprintf(f, "FRAME\n");
+        fwrite(frame, 1, sizeof(frame), f);
+    }
+    fclose(f);
+    return(0);
+}
+
+static void data_handler (zbar_image_t *img,
+                          const void *userdata)
+{
+    const zbar_symbol_t *sym = zbar_image_first_symbol(img);
+    unsigned seq = zbar_image_get_sequence(img);
+    if(nreports && seq <= last_seq)
+        order_ok = 0;
+    last_seq = seq;
+    nreports++;
+    for(; sym; sym = zbar_symbol_next(sym)) {
+        const char *data = zbar_symbol_get_data(sym);
+        if(zbar_symbol_get_count(sym))
+            /* seen before by the same worker */
+            continue;
+        if(zbar_symbol_get_type(sym) == ZBAR_EAN13) {
+            char expect[14];
+            int n = atoi(data + 9) / 10;
+            ean_data(expect, n);
+            if(n >= FRAMES || n != seq || strcmp(data, expect))
+                wrong++;
+            else
+                reported[n]++;
+        }
+        else if(!strcmp(data, qr_data[0]))
+            found[0]++;
+        else if(!strcmp(data, qr_data[1]))
+            found[1]++;
+        else
+            wrong++;
+    }
+}
+
+/* play the file through a processor w/a frame pipeline.  returns once
+ * the file has ended and done() is satisfied (or time runs out)
+ */
+static int run (int (*done)(zbar_processor_t*))
+{
+    zbar_processor_t *proc = zbar_processor_create(1);
+    char dev[64];
+    int ms, closed = 0, rc = 0;
+
+    nreports = wrong = found[0] = found[1] = 0;
+    memset(reported, 0, sizeof(reported));
+    order_ok = 1;
+
+    snprintf(dev, sizeof(dev), "file:%s", filename);
+    zbar_processor_request_workers(proc, WORKERS);
+    zbar_processor_set_config(proc, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_processor_set_config(proc, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+    zbar_processor_set_config(proc, ZBAR_EAN13, ZBAR_CFG_ENABLE, 1);
+    /* each EAN-13 is only seen once */
+    zbar_processor_set_config(proc, ZBAR_EAN13, ZBAR_CFG_UNCERTAINTY, 0);
+    zbar_processor_set_data_handler(proc, data_handler, NULL);
+    if(zbar_processor_init(proc, dev, 0) ||
+       zbar_processor_set_active(proc, 1)) {
+        zbar_processor_error_spew(proc, 0);
+        zbar_processor_destroy(proc);
+        return(1);
+    }
+
+    for(ms = 0; ms < 10000; ms += 10) {
+        if(!closed)
+            closed = (zbar_processor_get_error_code(proc) == ZBAR_ERR_CLOSED);
+        if(done(proc) && closed)
+            break;
+        usleep(10000);
+    }
+    if(ms >= 10000) {
+        fprintf(stderr, "pipeline did not finish w/the file\n");
+        rc = 1;
+    }
+    zbar_processor_set_active(proc, 0);
+    zbar_processor_destroy(proc);
+    unlink(filename);
+    return(rc);
+}
+
+static int count_eans (void)
+{
+    int i, n = 0;
+    for(i = 0; i < FRAMES; i++)
+        if(reported[i] > 1)
+            wrong++;
+        else
+            n += reported[i];
+    return(n);
+}
+
+/* every frame scanned has been reported */
+static int ean_done (zbar_processor_t *proc)
+{
+    return(nreports + zbar_processor_get_dropped_frames(proc) >= FRAMES);
+}
+
+static int check_order (void)
+{
+    int n, rc;
+    if(write_y4m(FRAMES, 0, -1, 0))
+        return(1);
+    rc = run(ean_done);
+    n = count_eans();
+    if(!order_ok || wrong || n != nreports || !n) {
+        fprintf(stderr, "%d of %d frames reported (%sin order), %d wrong\n",
+                n, nreports, (order_ok) ? "" : "not ", wrong);
+        rc = 1;
+    }
+    return(rc);
+}
+
+/* allow for late duplicates once the code is found */
+static int qr_done (zbar_processor_t *proc)
+{
+    static int settle;
+    return(found[0] && ++settle > 10);
+}
+
+static int check_repeated (void)
+{
+    int rc;
+    if(write_y4m(STILL, 0, 0, 0))
+        return(1);
+    rc = run(qr_done);
+    if(found[0] != 1 || found[1] || wrong || !order_ok) {
+        fprintf(stderr, "still QR code reported %d times, %d others\n",
+                found[0], found[1] + wrong);
+        rc = 1;
+    }
+    return(rc);
+}
+
+/* QR codes are disabled once the first code is found, well before the
+ * second shows up w/the EAN-13s, which are still found
+ */
+static int config_done (zbar_processor_t *proc)
+{
+    static int changed, settle;
+    if(found[0] && !changed) {
+        zbar_processor_set_config(proc, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 0);
+        changed = 1;
+    }
+    return(nreports > 1 && ++settle > 10);
+}
+
+static int check_config (void)
+{
+    int n, rc;
+    if(write_y4m(FRAMES, FPS, 0, 1))
+        return(1);
+    rc = run(config_done);
+    n = count_eans();
+    if(found[0] != 1 || found[1] || !n || wrong || !order_ok) {
+        fprintf(stderr, "found \"%s\" %d times, then \"%s\" %d times"
+                " and %d EAN-13s, %d wrong\n", qr_data[0], found[0],
+                qr_data[1], found[1], n, wrong);
+        rc = 1;
+    }
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#if defined(ENABLE_QRCODE) && defined(ENABLE_EAN)
+    int rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(24);
+
+    rc = check_order() | check_repeated() | check_config();
+    if(!rc)
+        printf("pipeline reported in order, once, w/current settings\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
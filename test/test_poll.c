@@ -0,0 +1,223 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks result delivery through zbar_processor_get_fd(): the
+ * descriptor must become readable once an image w/a QR code is
+ * processed, zbar_processor_poll_results() must return those results
+ * and quiet it again, results that are not collected in time must only
+ * lose the oldest, and a video source stopping must be signaled too
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define fourcc zbar_fourcc
+
+#define WIDTH  320
+#define HEIGHT 240
+#define MODULE 6
+
+/* results held for the application (PROC_RESULTS_MAX) */
+#define HELD   16
+
+static char filename[] = "/tmp/zbar_poll_XXXXXX";
+static uint8_t frames[2][WIDTH * HEIGHT];
+
+/* whether fd becomes readable within ms */
+static int readable (int fd,
+                     int ms)
+{
+    fd_set fds;
+    struct timeval tv;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return(select(fd + 1, &fds, NULL, NULL, &tv) > 0);
+}
+
+/* process a frame showing QR code id */
+static int process (zbar_processor_t *proc,
+                    int id)
+{
+    zbar_image_t *img = zbar_image_create();
+    int rc;
+    zbar_image_set_format(img, fourcc('Y','8','0','0'));
+    zbar_image_set_size(img, WIDTH, HEIGHT);
+    zbar_image_set_data(img, frames[id], WIDTH * HEIGHT, NULL);
+    rc = zbar_process_image(proc, img);
+    zbar_image_destroy(img);
+    return(rc);
+}
+
+/* collect the next results, which must hold QR code id */
+static int expect (zbar_processor_t *proc,
+                   int id)
+{
+    const zbar_symbol_set_t *syms = zbar_processor_poll_results(proc);
+    const zbar_symbol_t *sym;
+    int rc = 0;
+    if(!syms)
+        return(1);
+    sym = zbar_symbol_set_first_symbol(syms);
+    if(!sym || strcmp(zbar_symbol_get_data(sym), qr_data[id]) ||
+       zbar_symbol_next(sym))
+        rc = 1;
+    zbar_symbol_set_ref(syms, -1);
+    return(rc);
+}
+
+static int check_results (zbar_processor_t *proc,
+                          int fd)
+{
+    int i, rc = 0;
+
+    if(readable(fd, 0) || zbar_processor_poll_results(proc)) {
+        fprintf(stderr, "results pending before any were decoded\n");
+        return(1);
+    }
+    if(process(proc, 0) || !readable(fd, 1000)) {
+        fprintf(stderr, "descriptor not signaled for decoded image\n");
+        return(1);
+    }
+    if(expect(proc, 0)) {
+        fprintf(stderr, "unexpected results for decoded image\n");
+        rc = 1;
+    }
+    if(readable(fd, 0) || zbar_processor_poll_results(proc)) {
+        fprintf(stderr, "descriptor still signaled w/out results\n");
+        rc = 1;
+    }
+
+    /* fall behind: the first code is only decoded in the oldest frames,
+     * which are discarded to make room for the newest
+     */
+    for(i = 0; i < 4; i++)
+        process(proc, 0);
+    for(i = 0; i < HELD; i++)
+        process(proc, 1);
+    if(!readable(fd, 0)) {
+        fprintf(stderr, "descriptor not signaled for held results\n");
+        rc = 1;
+    }
+    for(i = 0; i < HELD; i++)
+        if(expect(proc, 1)) {
+            fprintf(stderr, "held result %d is not the newest\n", i);
+            rc = 1;
+            break;
+        }
+    if(readable(fd, 0) || zbar_processor_poll_results(proc)) {
+        fprintf(stderr, "more than %d results held\n", HELD);
+        rc = 1;
+    }
+    return(rc);
+}
+
+/* video stops at the end of the file */
+static int check_closed (zbar_processor_t *proc,
+                         int fd)
+{
+    const zbar_symbol_set_t *syms;
+    char dev[48];
+    FILE *f;
+    int i, ms, rc = 1;
+
+    i = mkstemp(filename);
+    if(i < 0 || !(f = fdopen(i, "wb"))) {
+        perror(filename);
+        return(1);
+    }
+    fprintf(f, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 Cmono\n", WIDTH, HEIGHT);
+    for(i = 0; i < 3; i++) {
+        fprintf(f, "FRAME\n");
+        fwrite(frames[0], 1, WIDTH * HEIGHT, f);
+    }
+    fclose(f);
+
+    snprintf(dev, sizeof(dev), "file:%s", filename);
+    if(zbar_processor_init(proc, dev, 0) ||
+       zbar_processor_set_active(proc, 1)) {
+        zbar_processor_error_spew(proc, 0);
+        unlink(filename);
+        return(1);
+    }
+    /* results, if any, precede the error */
+    for(ms = 0; ms < 5000 && readable(fd, 100); ms += 100) {
+        syms = zbar_processor_poll_results(proc);
+        if(syms)
+            zbar_symbol_set_ref(syms, -1);
+        else if(zbar_processor_get_error_code(proc) == ZBAR_ERR_CLOSED) {
+            rc = 0;
+            break;
+        }
+    }
+    if(rc)
+        fprintf(stderr, "end of video not signaled\n");
+    zbar_processor_set_active(proc, 0);
+    unlink(filename);
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    zbar_processor_t *proc;
+    int i, fd, rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(8);
+
+    for(i = 0; i < 2; i++) {
+        memset(frames[i], 0xff, WIDTH * HEIGHT);
+        draw_qr(frames[i], WIDTH, i, (WIDTH - 21 * MODULE) / 2,
+                (HEIGHT - 21 * MODULE) / 2, MODULE);
+    }
+
+    proc = zbar_processor_create(1);
+    if(!proc || zbar_processor_init(proc, NULL, 0))
+        return(2);
+    zbar_processor_set_config(proc, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_processor_set_config(proc, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+    fd = zbar_processor_get_fd(proc);
+    if(fd < 0) {
+        zbar_processor_error_spew(proc, 0);
+        zbar_processor_destroy(proc);
+        return(1);
+    }
+
+    rc = check_results(proc, fd) | check_closed(proc, fd);
+    zbar_processor_destroy(proc);
+    if(!rc)
+        printf("results and end of video signaled on descriptor\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
@@ -0,0 +1,103 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks multi-scale (pyramid) scanning of an image holding a large and
+ * a small QR code: the large one decodes at the coarsest level, where
+ * the finders of the small one are seen but too small to decode, so the
+ * finer levels must still be searched around them
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define fourcc zbar_fourcc
+
+#define WIDTH  640
+#define HEIGHT 480
+
+/* scan w/the given number of pyramid levels, both codes are expected */
+static int check (zbar_image_t *img,
+                  int levels)
+{
+    zbar_image_scanner_t *scn = zbar_image_scanner_create();
+    const zbar_symbol_t *sym;
+    int large = 0, small = 0, n;
+
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_image_scanner_set_config(scn, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_PYRAMID, levels);
+    n = zbar_scan_image(scn, img);
+    for(sym = zbar_image_first_symbol(img); sym; sym = zbar_symbol_next(sym)) {
+        const char *data = zbar_symbol_get_data(sym);
+        if(!strcmp(data, qr_data[0]))
+            large++;
+        else if(!strcmp(data, qr_data[1]))
+            small++;
+    }
+    zbar_image_scanner_destroy(scn);
+
+    if(n != 2 || large != 1 || small != 1) {
+        fprintf(stderr, "pyramid %d: %d symbols, %d large, %d small\n",
+                levels, n, large, small);
+        return(1);
+    }
+    return(0);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    zbar_image_t *img;
+    uint8_t *data;
+    int rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(32);
+
+    data = malloc(WIDTH * HEIGHT);
+    memset(data, 0xff, WIDTH * HEIGHT);
+    /* 12 pixel modules decode at 1/4 scale, the finders of the 5 pixel
+     * modules are located there, but the code only decodes at 1/2
+     */
+    draw_qr(data, WIDTH, 0, 30, 100, 12);
+    draw_qr(data, WIDTH, 1, 420, 260, 5);
+
+    img = zbar_image_create();
+    zbar_image_set_format(img, fourcc('Y','8','0','0'));
+    zbar_image_set_size(img, WIDTH, HEIGHT);
+    zbar_image_set_data(img, data, WIDTH * HEIGHT, zbar_image_free_data);
+
+    rc = check(img, 0) | check(img, 2);
+    zbar_image_destroy(img);
+    if(!rc)
+        printf("pyramid scan found both codes\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
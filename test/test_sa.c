@@ -0,0 +1,243 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks reassembly of QR structured append sequences that are spread
+ * across separate images.  each part is scanned in an image of its own;
+ * the earlier ones report partial results, the last one completes the
+ * sequence in any order.  parts seen further apart than the timeout, or
+ * w/reassembly disabled, must never merge
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <zbar.h>
+
+#define WIDTH   200
+#define HEIGHT  200
+#define MODULE  6
+#define NPARTS  3
+#define TIMEOUT 1000
+
+/* version 1-L, mask 0, "STRUCTURED ", "APPEND ", "TEST" w/S-A headers */
+static const char *const sa_codes[NPARTS][21] = { {
+    "#######...#.#.#######",
+    "#.....#.....#.#.....#",
+    "#.###.#.#.#...#.###.#",
+    "#.###.#.....#.#.###.#",
+    "#.###.#..#..#.#.###.#",
+    "#.....#..###..#.....#",
+    "#######.#.#.#.#######",
+    "........#.##.........",
+    "###.#####.#.###...#..",
+    "...#.#..#..#....##.#.",
+    ".#.####...#.###.#.###",
+    ".....#....###..#.##..",
+    ".#.#.###....#.####...",
+    "........#.##.......#.",
+    "#######.#..########.#",
+    "#.....#.##.#.....#.##",
+    "#.###.#.#.########..#",
+    "#.###.#..##....##..#.",
+    "#.###.#.#..####.###.#",
+    "#.....#.#.##.#......#",
+    "#######.#..##..##.#.#",
+}, {
+    "#######...#.#.#######",
+    "#.....#.....#.#.....#",
+    "#.###.#.#.#...#.###.#",
+    "#.###.#.....#.#.###.#",
+    "#.###.#..#.##.#.###.#",
+    "#.....#..###..#.....#",
+    "#######.#.#.#.#######",
+    "........#.#..........",
+    "###.#####.#.###...#..",
+    "..###.....##...###.#.",
+    "#.#...####.#..##..###",
+    "#.###..######..#.....",
+    "...##.##...#..####...",
+    "........#.#..#.....#.",
+    "#######.#.#.#..##.#.#",
+    "#.....#.###..#.#.#.##",
+    "#.###.#.#.#.#.#####.#",
+    "#.###.#...##.#.#.....",
+    "#.###.#.#..#..#.###.#",
+    "#.....#.######...#..#",
+    "#######.#..#..###.#.#",
+}, {
+    "#######..#.##.#######",
+    "#.....#..###..#.....#",
+    "#.###.#.##.##.#.###.#",
+    "#.###.#..#.#..#.###.#",
+    "#.###.#...#.#.#.###.#",
+    "#.....#.....#.#.....#",
+    "#######.#.#.#.#######",
+    "........##.##........",
+    "###.########.##...#..",
+    "....##.##.#...##.#.#.",
+    ".##...#.###.#...#.###",
+    "..#.#.....#...##.....",
+    "...##.##.##.#.#.#.#..",
+    "........#.##.#.#...#.",
+    "#######.####.######.#",
+    "#.....#.#..###.....##",
+    "#.###.#.#.##.####.#.#",
+    "#.###.#..##...#.#..##",
+    "#.###.#.#...#...#.#.#",
+    "#.....#.#.....#.....#",
+    "#######.###.#.#####.#",
+} };
+
+static const char *const sa_data[NPARTS] = { "STRUCTURED ", "APPEND ", "TEST" };
+static const char *const sa_text = "STRUCTURED APPEND TEST";
+
+static uint8_t frame[WIDTH * HEIGHT];
+
+/* scan an image showing only the given part, timestamped at msecs.
+ * returns the type of the single QR result, or ZBAR_NONE w/o one.
+ * the data and number of components of a complete result are checked
+ */
+static zbar_symbol_type_t scan_part (zbar_image_scanner_t *scn,
+                                     int id,
+                                     unsigned long msecs)
+{
+    zbar_image_t *img = zbar_image_create();
+    const zbar_symbol_t *sym;
+    zbar_symbol_type_t type = ZBAR_NONE;
+    unsigned x, y, x0 = (WIDTH - 21 * MODULE) / 2;
+    unsigned y0 = (HEIGHT - 21 * MODULE) / 2;
+
+    memset(frame, 0xff, sizeof(frame));
+    for(y = 0; y < 21 * MODULE; y++)
+        for(x = 0; x < 21 * MODULE; x++)
+            if(sa_codes[id][y / MODULE][x / MODULE] == '#')
+                frame[(y0 + y) * WIDTH + x0 + x] = 0;
+
+    zbar_image_set_format(img, *(int*)"Y800");
+    zbar_image_set_size(img, WIDTH, HEIGHT);
+    zbar_image_set_data(img, frame, sizeof(frame), NULL);
+    zbar_image_set_timestamp(img, msecs);
+    zbar_scan_image(scn, img);
+
+    sym = zbar_image_first_symbol(img);
+    if(sym && !zbar_symbol_next(sym)) {
+        const zbar_symbol_set_t *parts = zbar_symbol_get_components(sym);
+        type = zbar_symbol_get_type(sym);
+        if(type == ZBAR_QRCODE &&
+           (strcmp(zbar_symbol_get_data(sym), sa_text) ||
+            !parts || zbar_symbol_set_get_size(parts) != NPARTS)) {
+            fprintf(stderr, "part %d: bad composite \"%s\"\n",
+                    id, zbar_symbol_get_data(sym));
+            type = ZBAR_NONE;
+        }
+        else if(type == ZBAR_PARTIAL) {
+            /* the only decoded component is this part */
+            const zbar_symbol_t *part = NULL;
+            int n = 0;
+            for(sym = zbar_symbol_set_first_symbol(parts); sym;
+                sym = zbar_symbol_next(sym))
+                if(zbar_symbol_get_type(sym) != ZBAR_PARTIAL) {
+                    part = sym;
+                    n++;
+                }
+            if(n != 1 || strcmp(zbar_symbol_get_data(part), sa_data[id])) {
+                fprintf(stderr, "part %d: bad partial \"%s\"\n",
+                        id, (part) ? zbar_symbol_get_data(part) : "");
+                type = ZBAR_NONE;
+            }
+        }
+    }
+    zbar_image_destroy(img);
+    return(type);
+}
+
+/* scan the parts in the given order, w/msecs between images.
+ * every image but the last must be partial, the last one as expected
+ */
+static int check_sequence (zbar_image_scanner_t *scn,
+                           const int *order,
+                           unsigned long msecs,
+                           zbar_symbol_type_t last)
+{
+    static unsigned long now = 1;
+    int i, rc = 0;
+    for(i = 0; i < NPARTS && !rc; i++) {
+        zbar_symbol_type_t expect = (i < NPARTS - 1) ? ZBAR_PARTIAL : last;
+        zbar_symbol_type_t type = scan_part(scn, order[i], now);
+        now += msecs;
+        if(type != expect) {
+            fprintf(stderr, "part %d (image %d): expected %s, got %s\n",
+                    order[i], i, zbar_get_symbol_name(expect),
+                    zbar_get_symbol_name(type));
+            rc = 1;
+        }
+    }
+    /* start the next check w/a clean slate */
+    now += 2 * TIMEOUT;
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    static const int in_order[NPARTS] = { 0, 1, 2 };
+    static const int shuffled[NPARTS] = { 2, 0, 1 };
+    zbar_image_scanner_t *scn;
+    int rc = 0;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(32);
+
+    scn = zbar_image_scanner_create();
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_image_scanner_set_config(scn, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+
+    /* disabled by default */
+    rc |= check_sequence(scn, in_order, 10, ZBAR_PARTIAL);
+
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_SA_TIMEOUT, TIMEOUT);
+    rc |= check_sequence(scn, in_order, 10, ZBAR_QRCODE);
+    rc |= check_sequence(scn, shuffled, 10, ZBAR_QRCODE);
+
+    /* a sequence expires when no part of it is seen for too long */
+    rc |= check_sequence(scn, in_order, TIMEOUT * 3 / 2, ZBAR_PARTIAL);
+
+    /* a repeated part completes nothing, but is kept */
+    if(scan_part(scn, 0, 100000) != ZBAR_PARTIAL ||
+       scan_part(scn, 0, 100010) != ZBAR_PARTIAL ||
+       scan_part(scn, 1, 100020) != ZBAR_PARTIAL ||
+       scan_part(scn, 2, 100030) != ZBAR_QRCODE) {
+        fprintf(stderr, "repeated part broke reassembly\n");
+        rc = 1;
+    }
+
+    zbar_image_scanner_destroy(scn);
+    if(!rc)
+        printf("structured append reassembled across images\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
@@ -0,0 +1,150 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks strip scanning of an image holding two QR codes, one of which
+ * lies across the boundary between two strips.  strips are fed w/an
+ * overlap large enough to hold a whole code, each code must be reported
+ * exactly once, and strips out of order must be rejected
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define WIDTH   400
+#define HEIGHT  1000
+#define MODULE  6
+#define STRIP   256
+#define OVERLAP 160
+
+/* scan the image in strips of the given size, both codes are expected */
+static int check (const uint8_t *data,
+                  unsigned strip,
+                  unsigned overlap)
+{
+    zbar_image_scanner_t *scn = zbar_image_scanner_create();
+    const zbar_symbol_t *sym;
+    int found[2] = { 0, 0 }, other = 0, n = 0, rc = 0;
+    unsigned y;
+
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_image_scanner_set_config(scn, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+    if(zbar_image_scanner_begin_strips(scn, WIDTH, HEIGHT)) {
+        fprintf(stderr, "unable to start strip scan\n");
+        zbar_image_scanner_destroy(scn);
+        return(1);
+    }
+    for(y = 0; y < HEIGHT; y += strip - overlap) {
+        unsigned rows = (y + strip > HEIGHT) ? HEIGHT - y : strip;
+        if(zbar_scan_strip(scn, data + y * WIDTH, y, rows) < 0) {
+            fprintf(stderr, "strip @%u: scan failed\n", y);
+            rc = 1;
+            break;
+        }
+        if(y + rows >= HEIGHT)
+            break;
+    }
+    n = zbar_image_scanner_end_strips(scn);
+
+    for(sym = zbar_symbol_set_first_symbol(
+            zbar_image_scanner_get_results(scn));
+        sym;
+        sym = zbar_symbol_next(sym)) {
+        const char *text = zbar_symbol_get_data(sym);
+        if(!strcmp(text, qr_data[0]))
+            found[0]++;
+        else if(!strcmp(text, qr_data[1]))
+            found[1]++;
+        else
+            other++;
+    }
+    zbar_image_scanner_destroy(scn);
+
+    if(n != 2 || found[0] != 1 || found[1] != 1 || other) {
+        fprintf(stderr, "strips of %u (overlap %u): %d symbols,"
+                " %d \"%s\", %d \"%s\", %d others\n", strip, overlap, n,
+                found[0], qr_data[0], found[1], qr_data[1], other);
+        rc = 1;
+    }
+    return(rc);
+}
+
+/* strips must arrive in order w/out gaps */
+static int check_order (const uint8_t *data)
+{
+    zbar_image_scanner_t *scn = zbar_image_scanner_create();
+    int rc = 0;
+
+    if(zbar_scan_strip(scn, data, 0, STRIP) >= 0) {
+        fprintf(stderr, "strip accepted before begin\n");
+        rc = 1;
+    }
+    zbar_image_scanner_begin_strips(scn, WIDTH, HEIGHT);
+    if(zbar_scan_strip(scn, data, 0, STRIP) < 0 ||
+       zbar_scan_strip(scn, data + (STRIP + 8) * WIDTH,
+                       STRIP + 8, STRIP) >= 0 ||
+       zbar_scan_strip(scn, data, HEIGHT - 8, 16) >= 0) {
+        fprintf(stderr, "strip w/gap or past the end not rejected\n");
+        rc = 1;
+    }
+    zbar_image_scanner_end_strips(scn);
+    if(zbar_image_scanner_end_strips(scn) >= 0) {
+        fprintf(stderr, "strip scan ended twice\n");
+        rc = 1;
+    }
+    zbar_image_scanner_destroy(scn);
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    uint8_t *data;
+    int rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(32);
+
+    data = malloc(WIDTH * HEIGHT);
+    memset(data, 0xff, WIDTH * HEIGHT);
+    /* the first code fits in the first strip, the second lies across
+     * the end of the second strip and is only whole in the third
+     */
+    draw_qr(data, WIDTH, 0, 40, 40, MODULE);
+    draw_qr(data, WIDTH, 1, 200, 400, MODULE);
+
+    rc = check(data, STRIP, OVERLAP) |
+        check(data, HEIGHT, 0) |
+        check_order(data);
+    free(data);
+    if(!rc)
+        printf("strip scan found both codes once\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
@@ -0,0 +1,177 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks static scene frame skipping (skip-static=n): a y4m file shows
+ * one QR code standing still, then two codes trading places every
+ * frame.  the static frames must be throttled to at most n skipped per
+ * scan, while every moving frame must be scanned again
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+/* the code covers most of the frame, so scans are never cropped and
+ * take long enough to throttle against the 1ms frame interval
+ */
+#define WIDTH  640
+#define HEIGHT 480
+#define MODULE 20
+
+#define STATIC 40               /* frames w/the code standing still */
+#define MOVING 20               /* frames w/the codes trading places */
+#define SKIP   4                /* skip-static limit */
+
+static char filename[] = "/tmp/zbar_throttle_XXXXXX";
+static int found[2], wrong;
+
+static void write_frame (FILE *f,
+                         uint8_t *frame,
+                         int id,
+                         unsigned x)
+{
+    memset(frame, 0xff, WIDTH * HEIGHT);
+    draw_qr(frame, WIDTH, id, x, 30, MODULE);
+    fprintf(f, "FRAME\n");
+    fwrite(frame, 1, WIDTH * HEIGHT, f);
+}
+
+static int write_y4m (void)
+{
+    uint8_t *frame;
+    FILE *f;
+    int i, fd = mkstemp(filename);
+    if(fd < 0 || !(f = fdopen(fd, "wb"))) {
+        perror(filename);
+        return(-1);
+    }
+    frame = malloc(WIDTH * HEIGHT);
+
+    /* paced at 1ms, but frames are delivered as soon as they are late,
+     * so the throttle sees the same timestamps however fast it scans
+     */
+    fprintf(f, "YUV4MPEG2 W%d H%d F1000:1 Ip A1:1 Cmono\n", WIDTH, HEIGHT);
+    for(i = 0; i < STATIC; i++)
+        write_frame(f, frame, 0, 110);
+    for(i = 0; i < MOVING; i++)
+        write_frame(f, frame, i & 1, (i & 1) ? 200 : 20);
+
+    free(frame);
+    fclose(f);
+    return(0);
+}
+
+static void data_handler (zbar_image_t *img,
+                          const void *userdata)
+{
+    const zbar_symbol_t *sym = zbar_image_first_symbol(img);
+    for(; sym; sym = zbar_symbol_next(sym)) {
+        const char *data = zbar_symbol_get_data(sym);
+        if(!strcmp(data, qr_data[0]))
+            found[0]++;
+        else if(!strcmp(data, qr_data[1]))
+            found[1]++;
+        else
+            wrong++;
+    }
+}
+
+static int check_throttle (zbar_processor_t *proc)
+{
+    unsigned long dropped;
+    char dev[48];
+    int ms, rc = 0;
+
+    snprintf(dev, sizeof(dev), "file:%s", filename);
+    zbar_processor_set_config(proc, 0, ZBAR_CFG_SKIP_STATIC, SKIP);
+    zbar_processor_set_data_handler(proc, data_handler, NULL);
+    if(zbar_processor_init(proc, dev, 0) ||
+       zbar_processor_set_active(proc, 1)) {
+        zbar_processor_error_spew(proc, 0);
+        return(1);
+    }
+
+    /* the video thread stops at the end of the file */
+    for(ms = 0; ms < 10000; ms += 10) {
+        if(zbar_processor_get_error_code(proc) == ZBAR_ERR_CLOSED)
+            break;
+        usleep(10000);
+    }
+    if(ms >= 10000) {
+        fprintf(stderr, "processor did not stop at end of file\n");
+        rc = 1;
+    }
+    dropped = zbar_processor_get_dropped_frames(proc);
+    zbar_processor_set_active(proc, 0);
+
+    /* frames are only skipped while static: at least half of those, but
+     * never more than SKIP for each one scanned.  any throttling of the
+     * moving frames takes the count beyond that
+     */
+    if(dropped < STATIC / 2 || dropped > STATIC * SKIP / (SKIP + 1)) {
+        fprintf(stderr, "skipped %lu frames, expected %d to %d\n",
+                dropped, STATIC / 2, STATIC * SKIP / (SKIP + 1));
+        rc = 1;
+    }
+    else
+        printf("skipped %lu of %d static frames\n", dropped, STATIC);
+
+    if(!found[0] || !found[1] || wrong) {
+        fprintf(stderr, "found %d \"%s\", %d \"%s\", %d others\n",
+                found[0], qr_data[0], found[1], qr_data[1], wrong);
+        rc = 1;
+    }
+    return(rc);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    zbar_processor_t *proc;
+    int rc;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(16);
+
+    if(write_y4m())
+        return(2);
+    proc = zbar_processor_create(1);
+    if(!proc) {
+        unlink(filename);
+        return(2);
+    }
+    rc = check_throttle(proc);
+    zbar_processor_destroy(proc);
+    unlink(filename);
+    if(!rc)
+        printf("static frames throttled, motion scanned at full rate\n");
+    return(rc);
+#else
+    return(0);
+#endif
+}
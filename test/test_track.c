@@ -0,0 +1,171 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+/* checks QR tracking between video frames.  a code is decoded once, then
+ * moves a little in each of the following frames, w/its format info
+ * wiped out so that only a tracked code can be read.  the tracked code
+ * must follow the motion (and be reported where it moved to), must be
+ * dropped once it leaves, and none of this may happen w/o tracking
+ */
+
+#include <config.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <zbar.h>
+#include "qr_codes.h"
+
+#define WIDTH  320
+#define HEIGHT 240
+#define MODULE 4
+#define STEP   (2 * MODULE)
+#define MOVES  6
+#define X0     40
+#define Y0     60
+
+static uint8_t frame[WIDTH * HEIGHT];
+
+/* clear both copies of the format info of a code drawn at x0,y0 */
+static void wipe_format (unsigned x0,
+                         unsigned y0)
+{
+    unsigned i, x, y;
+    for(i = 0; i < 21; i++) {
+        if(i == 6 || (i > 8 && i < 13))
+            continue;
+        for(y = 0; y < MODULE; y++)
+            for(x = 0; x < MODULE; x++) {
+                /* row 8 and column 8 */
+                frame[(y0 + 8 * MODULE + y) * WIDTH + x0 + i * MODULE + x] =
+                    0xff;
+                frame[(y0 + i * MODULE + y) * WIDTH + x0 + 8 * MODULE + x] =
+                    0xff;
+            }
+    }
+}
+
+/* scan a frame w/the code at x0,y0 (if present), optionally damaged.
+ * returns the left edge of the code found, or -1 w/o one
+ */
+static int scan_frame (zbar_image_scanner_t *scn,
+                       int present,
+                       int damage,
+                       unsigned x0,
+                       unsigned y0)
+{
+    zbar_image_t *img = zbar_image_create();
+    const zbar_symbol_t *sym;
+    int i, left = -1;
+
+    memset(frame, 0xff, sizeof(frame));
+    if(present) {
+        draw_qr(frame, WIDTH, 0, x0, y0, MODULE);
+        if(damage)
+            wipe_format(x0, y0);
+    }
+
+    zbar_image_set_format(img, *(int*)"Y800");
+    zbar_image_set_size(img, WIDTH, HEIGHT);
+    zbar_image_set_data(img, frame, sizeof(frame), NULL);
+    zbar_scan_image(scn, img);
+
+    for(sym = zbar_image_first_symbol(img); sym; sym = zbar_symbol_next(sym))
+        if(zbar_symbol_get_type(sym) == ZBAR_QRCODE &&
+           !strcmp(zbar_symbol_get_data(sym), qr_data[0]))
+            for(i = 0, left = WIDTH; i < zbar_symbol_get_loc_size(sym); i++)
+                if(left > zbar_symbol_get_loc_x(sym, i))
+                    left = zbar_symbol_get_loc_x(sym, i);
+    zbar_image_destroy(img);
+    return(left);
+}
+
+/* decode the code once, then move it while damaged.  returns the
+ * number of moved frames it was found in, or -1 if it was found
+ * anywhere else
+ */
+static int check_moves (zbar_image_scanner_t *scn)
+{
+    int i, found = 0;
+    if(scan_frame(scn, 1, 0, X0, Y0) < 0) {
+        fprintf(stderr, "undamaged code not decoded\n");
+        return(-1);
+    }
+    for(i = 1; i <= MOVES; i++) {
+        int x0 = X0 + i * STEP;
+        int left = scan_frame(scn, 1, 1, x0, Y0 + i);
+        if(left < 0)
+            continue;
+        if(left < x0 - MODULE || left > x0 + MODULE) {
+            fprintf(stderr, "move %d: code at %d reported at %d\n",
+                    i, x0, left);
+            return(-1);
+        }
+        found++;
+    }
+    return(found);
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_QRCODE
+    zbar_image_scanner_t *scn;
+    int found, rc = 0;
+
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+        zbar_set_verbosity(32);
+
+    scn = zbar_image_scanner_create();
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_ENABLE, 0);
+    zbar_image_scanner_set_config(scn, ZBAR_QRCODE, ZBAR_CFG_ENABLE, 1);
+
+    /* the damage must be enough to stop a full search */
+    found = check_moves(scn);
+    if(found) {
+        fprintf(stderr, "damaged code decoded w/o tracking (%d)\n", found);
+        rc = 1;
+    }
+
+    zbar_image_scanner_set_config(scn, 0, ZBAR_CFG_TRACKING, 1);
+    found = check_moves(scn);
+    if(found != MOVES) {
+        fprintf(stderr, "tracked code followed for %d of %d moves\n",
+                found, MOVES);
+        rc = 1;
+    }
+
+    /* once lost, the code is searched for from scratch */
+    if(scan_frame(scn, 0, 0, 0, 0) >= 0 ||
+       scan_frame(scn, 1, 1, X0, Y0) >= 0) {
+        fprintf(stderr, "lost code still tracked\n");
+        rc = 1;
+    }
+
+    zbar_image_scanner_destroy(scn);
+    if(!rc)
+        printf("tracked code followed %d moves\n", MOVES);
+    return(rc);
+#else
+    return(0);
+#endif
+}
@@ -0,0 +1,648 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#elif defined(HAVE_POLL_H)
+# include <poll.h>
+#endif
+
+#include <zbar.h>
+#include "error.h"
+#include "mutex.h"
+#include "thread.h"
+#include "image.h"
+#include "video.h"
+
+/* multi-source capture.  one poll thread waits on the file descriptors
+ * of every video source and hands each captured frame over to its
+ * source, where it waits for one of the shared scan workers.  only the
+ * newest frame of a source is kept: an older frame still waiting is
+ * dropped, so a source whose frames are not scanned in time never backs
+ * up the poll thread or holds more than two video buffers.
+ *
+ * each source has its own image scanner, which caches its results while
+ * capture is active, and is only scanned by one worker at a time, so
+ * frames from a source are scanned and reported in order and duplicates
+ * are suppressed separately for each source.  workers pick sources round
+ * robin
+ */
+
+#if defined(ZTHREAD) && (defined(HAVE_SYS_EPOLL_H) || defined(HAVE_POLL_H))
+
+#define CAPTURE_MAX_WORKERS 16
+
+/* scanner config setting, replayed for each source */
+typedef struct capture_config_s {
+    zbar_symbol_type_t sym;
+    zbar_config_t cfg;
+    int val;
+} capture_config_t;
+
+typedef struct capture_source_s {
+    zbar_video_t *video;
+    int fd;                             /* polled video descriptor */
+    int active;                         /* capturing (no error) */
+    zbar_image_scanner_t *scanner;      /* private scanner and cache */
+    unsigned config_gen;                /* capture settings applied */
+    zbar_image_t *frame;                /* newest frame to scan */
+    int busy;                           /* frame being scanned */
+    unsigned long dropped;              /* frames replaced before scan */
+} capture_source_t;
+
+typedef struct capture_worker_s {
+    zbar_capture_t *cap;
+    zbar_thread_t thread;
+} capture_worker_t;
+
+struct zbar_capture_s {
+    errinfo_t err;                      /* error reporting */
+    zbar_mutex_t lock;                  /* capture state lock */
+    int active;                         /* capture running */
+
+    capture_source_t *sources;
+    int nsources;
+    int next;                           /* round robin scan position */
+
+    zbar_image_scanner_t *scanner;      /* validates new settings */
+    capture_config_t *configs;          /* scanner settings applied so far */
+    int nconfigs;
+    unsigned config_gen;                /* incremented w/each new setting */
+
+    zbar_capture_data_handler_t *handler; /* application data handler */
+    const void *userdata;
+
+    zbar_image_pool_t *pool;            /* converted frame buffers */
+
+    int pollfd;                         /* epoll instance */
+    int kick_fds[2];                    /* wakes the poll thread */
+    zbar_thread_t poll_thread;
+    int nworkers;
+    capture_worker_t workers[CAPTURE_MAX_WORKERS];
+};
+
+/* wait for sources to become readable (or the poll thread to be kicked).
+ * fills ready w/indices of readable sources, -1 for the kick pipe.
+ * returns the number of entries or -1 if an error occurs
+ */
+static int capture_wait (zbar_capture_t *cap,
+                         int *ready,
+                         int max)
+{
+    int i, n;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event events[max];
+    n = epoll_wait(cap->pollfd, events, max, -1);
+    for(i = 0; i < n; i++)
+        ready[i] = (int)events[i].data.u32;
+#else
+    /* sources are stable while polling, inactive ones are skipped */
+    struct pollfd fds[cap->nsources + 1];
+    int nfds = 0, src[cap->nsources + 1];
+    for(i = 0; i < cap->nsources; i++)
+        if(cap->sources[i].active) {
+            fds[nfds].fd = cap->sources[i].fd;
+            fds[nfds].events = POLLIN;
+            src[nfds++] = i;
+        }
+    fds[nfds].fd = cap->kick_fds[0];
+    fds[nfds].events = POLLIN;
+    src[nfds++] = -1;
+
+    n = poll(fds, nfds, -1);
+    if(n > 0) {
+        int j;
+        for(i = j = 0; i < nfds && j < max; i++)
+            if(fds[i].revents)
+                ready[j++] = src[i];
+        n = j;
+    }
+#endif
+    return(n);
+}
+
+static inline void capture_unwatch (zbar_capture_t *cap,
+                                    capture_source_t *src)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_ctl(cap->pollfd, EPOLL_CTL_DEL, src->fd, NULL);
+#endif
+}
+
+/* capture lock must be held */
+static inline void capture_wake_workers (zbar_capture_t *cap)
+{
+    int i;
+    for(i = 0; i < cap->nworkers; i++)
+        _zbar_event_trigger(&cap->workers[i].thread.notify);
+}
+
+static ZTHREAD capture_poll_thread (void *arg)
+{
+    zbar_capture_t *cap = arg;
+    zbar_thread_t *thread = &cap->poll_thread;
+    int max = cap->nsources + 1;
+    int ready[max];
+
+    _zbar_mutex_lock(&cap->lock);
+    _zbar_thread_init(thread);
+    zprintf(4, "spawned capture poll thread (%d sources)\n", cap->nsources);
+
+    while(thread->started) {
+        int i, n;
+        /* stopping the thread writes to the kick pipe */
+        thread->notify.pollfd = cap->kick_fds[1];
+        _zbar_mutex_unlock(&cap->lock);
+
+        n = capture_wait(cap, ready, max);
+
+        _zbar_mutex_lock(&cap->lock);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            err_capture(cap, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                        "polling video sources");
+            break;
+        }
+
+        for(i = 0; i < n && thread->started; i++) {
+            capture_source_t *src;
+            zbar_image_t *img;
+            if(ready[i] < 0) {
+                unsigned junk[2];
+                if(read(cap->kick_fds[0], junk, sizeof(junk)) < 0)
+                    zprintf(1, "WARNING: draining capture kick pipe\n");
+                continue;
+            }
+
+            src = &cap->sources[ready[i]];
+            if(!src->active)
+                continue;
+            _zbar_mutex_unlock(&cap->lock);
+            img = zbar_video_next_image(src->video);
+            _zbar_mutex_lock(&cap->lock);
+
+            if(!img) {
+                /* stop polling the broken source, keep the others */
+                err_copy(cap, src->video);
+                zprintf(1, "WARNING: capture source %d failed\n", ready[i]);
+                src->active = 0;
+                capture_unwatch(cap, src);
+                continue;
+            }
+            if(src->frame) {
+                zbar_image_destroy(src->frame);
+                src->dropped++;
+                zprintf(24, "source %d dropped frame (%lu total)\n",
+                        ready[i], src->dropped);
+            }
+            src->frame = img;
+            capture_wake_workers(cap);
+        }
+    }
+
+    thread->notify.pollfd = -1;
+    thread->running = 0;
+    _zbar_event_trigger(&thread->activity);
+    _zbar_mutex_unlock(&cap->lock);
+    return(0);
+}
+
+/* claim the next source w/a frame to scan.  capture lock must be held */
+static inline int capture_next_source (zbar_capture_t *cap)
+{
+    int i;
+    for(i = 0; i < cap->nsources; i++) {
+        int id = (cap->next + i) % cap->nsources;
+        capture_source_t *src = &cap->sources[id];
+        if(src->frame && !src->busy) {
+            cap->next = id + 1;
+            src->busy = 1;
+            return(id);
+        }
+    }
+    return(-1);
+}
+
+/* catch up w/settings changed since the source was last scanned.
+ * capture lock must be held
+ */
+static inline void capture_source_config (zbar_capture_t *cap,
+                                          capture_source_t *src)
+{
+    if(src->config_gen != cap->config_gen) {
+        int i;
+        for(i = 0; i < cap->nconfigs; i++)
+            zbar_image_scanner_set_config(src->scanner,
+                                          cap->configs[i].sym,
+                                          cap->configs[i].cfg,
+                                          cap->configs[i].val);
+        src->config_gen = cap->config_gen;
+    }
+}
+
+static ZTHREAD capture_scan_thread (void *arg)
+{
+    capture_worker_t *worker = arg;
+    zbar_capture_t *cap = worker->cap;
+    zbar_thread_t *thread = &worker->thread;
+
+    _zbar_mutex_lock(&cap->lock);
+    _zbar_thread_init(thread);
+    zprintf(4, "spawned capture scan worker %d\n",
+            (int)(worker - cap->workers));
+
+    while(thread->started) {
+        capture_source_t *src;
+        zbar_capture_data_handler_t *handler;
+        const void *userdata;
+        zbar_image_t *img, *gray;
+        int id = capture_next_source(cap), nsyms;
+        if(id < 0) {
+            _zbar_event_wait(&thread->notify, &cap->lock, NULL);
+            continue;
+        }
+        src = &cap->sources[id];
+        img = src->frame;
+        src->frame = NULL;
+        capture_source_config(cap, src);
+        handler = cap->handler;
+        userdata = cap->userdata;
+        _zbar_mutex_unlock(&cap->lock);
+
+        gray = zbar_image_pool_convert(cap->pool, img,
+                                       fourcc('Y','8','0','0'));
+        if(gray)
+            gray->seq = img->seq;
+        /* video buffer is free to capture again */
+        zbar_image_destroy(img);
+
+        if(gray) {
+            nsyms = zbar_scan_image(src->scanner, gray);
+            if(nsyms > 0 && handler)
+                handler(gray, id, userdata);
+            zbar_image_destroy(gray);
+        }
+        else
+            zprintf(1, "ERROR: unable to convert frame from source %d\n", id);
+
+        _zbar_mutex_lock(&cap->lock);
+        src->busy = 0;
+    }
+
+    thread->running = 0;
+    _zbar_event_trigger(&thread->activity);
+    _zbar_mutex_unlock(&cap->lock);
+    return(0);
+}
+
+zbar_capture_t *zbar_capture_create (int workers)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+    zbar_capture_t *cap = calloc(1, sizeof(zbar_capture_t));
+    if(!cap)
+        return(NULL);
+    err_init(&cap->err, ZBAR_MOD_CAPTURE);
+    _zbar_mutex_init(&cap->lock);
+    cap->pollfd = cap->kick_fds[0] = cap->kick_fds[1] = -1;
+    cap->nworkers = (workers < 1) ? 1 :
+        (workers > CAPTURE_MAX_WORKERS) ? CAPTURE_MAX_WORKERS : workers;
+
+    cap->scanner = zbar_image_scanner_create();
+    cap->pool = zbar_image_pool_create();
+    if(!cap->scanner || !cap->pool || pipe(cap->kick_fds)) {
+        zbar_capture_destroy(cap);
+        return(NULL);
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    cap->pollfd = epoll_create(CAPTURE_MAX_WORKERS);
+    if(cap->pollfd < 0) {
+        zbar_capture_destroy(cap);
+        return(NULL);
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = -1;
+    if(epoll_ctl(cap->pollfd, EPOLL_CTL_ADD, cap->kick_fds[0], &ev)) {
+        zbar_capture_destroy(cap);
+        return(NULL);
+    }
+#endif
+    return(cap);
+}
+
+void zbar_capture_destroy (zbar_capture_t *cap)
+{
+    int i;
+    zbar_capture_set_active(cap, 0);
+    for(i = 0; i < cap->nsources; i++)
+        zbar_image_scanner_destroy(cap->sources[i].scanner);
+    if(cap->sources)
+        free(cap->sources);
+    if(cap->configs)
+        free(cap->configs);
+    if(cap->scanner)
+        zbar_image_scanner_destroy(cap->scanner);
+    if(cap->pool)
+        zbar_image_pool_destroy(cap->pool);
+    if(cap->pollfd >= 0)
+        close(cap->pollfd);
+    if(cap->kick_fds[0] >= 0)
+        close(cap->kick_fds[0]);
+    if(cap->kick_fds[1] >= 0)
+        close(cap->kick_fds[1]);
+    err_cleanup(&cap->err);
+    _zbar_mutex_destroy(&cap->lock);
+    free(cap);
+}
+
+int zbar_capture_add_video (zbar_capture_t *cap,
+                            zbar_video_t *video)
+{
+    capture_source_t *sources, *src;
+    int id, rc = -1;
+    _zbar_mutex_lock(&cap->lock);
+    if(cap->active) {
+        err_capture(cap, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                    "unable to add source while capture is active");
+        goto done;
+    }
+    sources = realloc(cap->sources,
+                      (cap->nsources + 1) * sizeof(capture_source_t));
+    if(!sources) {
+        err_capture(cap, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                    "allocating capture source");
+        goto done;
+    }
+    cap->sources = sources;
+    id = cap->nsources;
+    src = &sources[id];
+    memset(src, 0, sizeof(*src));
+    src->video = video;
+    src->fd = -1;
+    src->scanner = zbar_image_scanner_create();
+    if(!src->scanner) {
+        err_capture(cap, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                    "allocating capture source scanner");
+        goto done;
+    }
+    src->config_gen = cap->config_gen - 1;
+    cap->nsources++;
+    rc = id;
+    zprintf(1, "added capture source %d\n", id);
+
+done:
+    _zbar_mutex_unlock(&cap->lock);
+    return(rc);
+}
+
+zbar_capture_data_handler_t*
+zbar_capture_set_data_handler (zbar_capture_t *cap,
+                               zbar_capture_data_handler_t *handler,
+                               const void *userdata)
+{
+    zbar_capture_data_handler_t *result;
+    _zbar_mutex_lock(&cap->lock);
+    result = cap->handler;
+    cap->handler = handler;
+    cap->userdata = userdata;
+    _zbar_mutex_unlock(&cap->lock);
+    return(result);
+}
+
+int zbar_capture_set_config (zbar_capture_t *cap,
+                             zbar_symbol_type_t sym,
+                             zbar_config_t cfg,
+                             int val)
+{
+    capture_config_t *c;
+    int i, rc;
+    _zbar_mutex_lock(&cap->lock);
+    rc = zbar_image_scanner_set_config(cap->scanner, sym, cfg, val);
+    if(rc)
+        goto done;
+
+    /* remember the setting for every source, in the order applied
+     * (symbology specific and global settings overlap)
+     */
+    for(i = 0; i < cap->nconfigs; i++)
+        if(cap->configs[i].sym == sym && cap->configs[i].cfg == cfg)
+            break;
+    if(i < cap->nconfigs)
+        memmove(&cap->configs[i], &cap->configs[i + 1],
+                (--cap->nconfigs - i) * sizeof(capture_config_t));
+    else {
+        capture_config_t *configs =
+            realloc(cap->configs, (i + 1) * sizeof(capture_config_t));
+        if(!configs) {
+            rc = err_capture(cap, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                             "allocating capture settings");
+            goto done;
+        }
+        cap->configs = configs;
+    }
+    c = &cap->configs[cap->nconfigs++];
+    c->sym = sym;
+    c->cfg = cfg;
+    c->val = val;
+    cap->config_gen++;
+
+done:
+    _zbar_mutex_unlock(&cap->lock);
+    return(rc);
+}
+
+static int capture_start (zbar_capture_t *cap)
+{
+    int i;
+    for(i = 0; i < cap->nsources; i++) {
+        capture_source_t *src = &cap->sources[i];
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event ev;
+#endif
+        if(zbar_video_enable(src->video, 1))
+            return(err_copy(cap, src->video));
+        src->fd = _zbar_video_get_poll_fd(src->video);
+        if(src->fd < 0)
+            return(err_capture_int(cap, SEV_ERROR, ZBAR_ERR_UNSUPPORTED,
+                                   __func__, "capture source %d does not"
+                                   " support polling", i));
+#ifdef HAVE_SYS_EPOLL_H
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if(epoll_ctl(cap->pollfd, EPOLL_CTL_ADD, src->fd, &ev))
+            return(err_capture(cap, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                               "polling video source (epoll_ctl)"));
+#endif
+        zbar_image_scanner_enable_cache(src->scanner, 1);
+        src->active = 1;
+    }
+
+    for(i = 0; i < cap->nworkers; i++) {
+        cap->workers[i].cap = cap;
+        if(_zbar_thread_start(&cap->workers[i].thread, capture_scan_thread,
+                              &cap->workers[i], &cap->lock))
+            return(err_capture(cap, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                               "spawning capture scan worker"));
+    }
+    if(_zbar_thread_start(&cap->poll_thread, capture_poll_thread, cap,
+                          &cap->lock))
+        return(err_capture(cap, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                           "spawning capture poll thread"));
+    return(0);
+}
+
+static void capture_stop (zbar_capture_t *cap)
+{
+    int i;
+    _zbar_mutex_lock(&cap->lock);
+    _zbar_thread_stop(&cap->poll_thread, &cap->lock);
+    for(i = 0; i < cap->nworkers; i++)
+        _zbar_thread_stop(&cap->workers[i].thread, &cap->lock);
+    _zbar_mutex_unlock(&cap->lock);
+
+    for(i = 0; i < cap->nsources; i++) {
+        capture_source_t *src = &cap->sources[i];
+        if(src->frame) {
+            zbar_image_destroy(src->frame);
+            src->frame = NULL;
+        }
+        if(src->fd >= 0) {
+            capture_unwatch(cap, src);
+            src->fd = -1;
+        }
+        src->active = 0;
+        zbar_image_scanner_enable_cache(src->scanner, 0);
+        zbar_video_enable(src->video, 0);
+    }
+}
+
+int zbar_capture_set_active (zbar_capture_t *cap,
+                             int active)
+{
+    active = (active) ? 1 : 0;
+    if(cap->active == active)
+        return(0);
+    if(active && !cap->nsources)
+        return(err_capture(cap, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "no capture sources added"));
+
+    if(!active) {
+        capture_stop(cap);
+        cap->active = 0;
+        return(0);
+    }
+
+    cap->active = 1;
+    if(capture_start(cap)) {
+        capture_stop(cap);
+        cap->active = 0;
+        return(-1);
+    }
+    return(0);
+}
+
+unsigned long zbar_capture_get_dropped_frames (zbar_capture_t *cap,
+                                               int source)
+{
+    unsigned long dropped = 0;
+    _zbar_mutex_lock(&cap->lock);
+    if(source >= 0 && source < cap->nsources)
+        dropped = cap->sources[source].dropped;
+    _zbar_mutex_unlock(&cap->lock);
+    return(dropped);
+}
+
+int zbar_capture_get_source_active (zbar_capture_t *cap,
+                                    int source)
+{
+    int active = -1;
+    _zbar_mutex_lock(&cap->lock);
+    if(source >= 0 && source < cap->nsources)
+        active = cap->sources[source].active;
+    _zbar_mutex_unlock(&cap->lock);
+    return(active);
+}
+
+#else
+
+zbar_capture_t *zbar_capture_create (int workers)
+{
+    return(NULL);
+}
+
+void zbar_capture_destroy (zbar_capture_t *cap)
+{
+}
+
+int zbar_capture_add_video (zbar_capture_t *cap,
+                            zbar_video_t *video)
+{
+    return(-1);
+}
+
+zbar_capture_data_handler_t*
+zbar_capture_set_data_handler (zbar_capture_t *cap,
+                               zbar_capture_data_handler_t *handler,
+                               const void *userdata)
+{
+    return(NULL);
+}
+
+int zbar_capture_set_config (zbar_capture_t *cap,
+                             zbar_symbol_type_t sym,
+                             zbar_config_t cfg,
+                             int val)
+{
+    return(-1);
+}
+
+int zbar_capture_set_active (zbar_capture_t *cap,
+                             int active)
+{
+    return(-1);
+}
+
+unsigned long zbar_capture_get_dropped_frames (zbar_capture_t *cap,
+                                               int source)
+{
+    return(0);
+}
+
+int zbar_capture_get_source_active (zbar_capture_t *cap,
+                                    int source)
+{
+    return(-1);
+}
+
+#endif
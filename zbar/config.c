@@ -147,6 +147,16 @@ int zbar_parse_config (const char *cfgstr,
         *cfg = ZBAR_CFG_UNCERTAINTY;
     else if(!strncmp(cfgstr, "position", len))
         *cfg = ZBAR_CFG_POSITION;
+    else if(!strncmp(cfgstr, "tracking", len))
+        *cfg = ZBAR_CFG_TRACKING;
+    else if(!strncmp(cfgstr, "sa-timeout", len))
+        *cfg = ZBAR_CFG_SA_TIMEOUT;
+    else if(!strncmp(cfgstr, "pyramid", len))
+        *cfg = ZBAR_CFG_PYRAMID;
+    else if(!strncmp(cfgstr, "latest-frame", len))
+        *cfg = ZBAR_CFG_LATEST_FRAME;
+    else if(!strncmp(cfgstr, "skip-static", len))
+        *cfg = ZBAR_CFG_SKIP_STATIC;
     else 
         return(1);
 
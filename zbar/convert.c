@@ -24,6 +24,17 @@
 #include "image.h"
 #include "video.h"
 #include "window.h"
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/* the SIMD kernels are compiled for their target explicitly
+ * and only used if the CPU reports support for it at run time
+ */
+# define HAVE_X86_SIMD 1
+# include <immintrin.h>
+#endif
 
 /* pack bit size and location offset of a component into one byte
  */
@@ -39,6 +50,21 @@ typedef struct conversion_def_s {
     conversion_handler_t *func;         /* function that accomplishes it */
 } conversion_def_t;
 
+/* one band of rows of a multi-threaded conversion */
+typedef struct convert_band_s {
+    zbar_image_t dst, src;              /* views of the band */
+    const zbar_format_def_t *dstfmt, *srcfmt;
+    conversion_handler_t *func;
+} convert_band_t;
+
+/* maximum threads used for one conversion */
+#define MAX_BANDS 16
+
+/* minimum pixels per band worth a thread */
+#define BAND_MIN_PIXELS (1 << 20)
+
+static unsigned convert_threads = 1;
+
 
 /* NULL terminated list of known formats, in order of preference
  * (NB Cr=V Cb=U)
@@ -233,6 +259,16 @@ static inline void uv_round (zbar_image_t *img,
     img->height <<= fmt->p.yuv.ysub2;
 }
 
+/* allocate converted image data,
+ * unless converting a band into an already allocated image
+ */
+static inline void *convert_alloc (zbar_image_t *dst)
+{
+    if(dst->data)
+        return((void*)dst->data);
+    return(_zbar_image_pool_alloc(dst));
+}
+
 static inline void uv_roundup (zbar_image_t *img,
                                const zbar_format_def_t *fmt)
 {
@@ -291,6 +327,256 @@ static inline void convert_write_rgb (uint8_t *dstp,
         *dstp = p;
 }
 
+/* maximum integer downscale factor for zbar_image_convert_scaled() */
+#define MAX_SCALE 4
+
+/* candidate channels for zbar_image_convert_contrast() */
+typedef enum contrast_channel_e {
+    CONTRAST_LUMA,
+    CONTRAST_RED,
+    CONTRAST_GREEN,
+    CONTRAST_BLUE,
+
+    /* enum size */
+    CONTRAST_NUM
+} contrast_channel_t;
+
+/* sample spacing used to measure contrast */
+#define CONTRAST_STEP 2
+
+/* luma from 8 bit RGB components, as used by the generic conversions */
+#define RGB_TO_Y(r, g, b) (((77 * (r) + 150 * (g) + 29 * (b)) + 0x80) >> 8)
+
+#ifdef HAVE_X86_SIMD
+
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+
+static int cpu_simd (void)
+{
+    static int simd = -1;
+    if(simd < 0) {
+        __builtin_cpu_init();
+        simd = 0;
+        if(__builtin_cpu_supports("sse2"))
+            simd |= SIMD_SSE2;
+        if(__builtin_cpu_supports("avx2"))
+            simd |= SIMD_AVX2;
+    }
+    return(simd);
+}
+
+/* copy every other byte (the Y samples of packed YUV) */
+__attribute__((target("sse2")))
+static unsigned yuv_row_to_y_sse2 (uint8_t *dsty,
+                                   const uint8_t *srcp,
+                                   unsigned n)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    unsigned x;
+    for(x = 0; x + 16 <= n; x += 16, srcp += 32) {
+        __m128i a = _mm_loadu_si128((const __m128i*)srcp);
+        __m128i b = _mm_loadu_si128((const __m128i*)(srcp + 16));
+        a = _mm_and_si128(a, mask);
+        b = _mm_and_si128(b, mask);
+        _mm_storeu_si128((__m128i*)(dsty + x), _mm_packus_epi16(a, b));
+    }
+    return(x);
+}
+
+__attribute__((target("avx2")))
+static unsigned yuv_row_to_y_avx2 (uint8_t *dsty,
+                                   const uint8_t *srcp,
+                                   unsigned n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    unsigned x;
+    for(x = 0; x + 32 <= n; x += 32, srcp += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)srcp);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(srcp + 32));
+        a = _mm256_and_si256(a, mask);
+        b = _mm256_and_si256(b, mask);
+        /* packing is per 128 bit lane, restore sample order */
+        a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b),
+                                     _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dsty + x), a);
+    }
+    return(x);
+}
+
+/* luma of 32 bit pixels w/8 bit components at the given bit offsets */
+__attribute__((target("sse2")))
+static inline __m128i rgb_to_y_sse2 (__m128i p,
+                                     __m128i rsh,
+                                     __m128i gsh,
+                                     __m128i bsh)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i r = _mm_and_si128(_mm_srl_epi32(p, rsh), mask);
+    __m128i g = _mm_and_si128(_mm_srl_epi32(p, gsh), mask);
+    __m128i b = _mm_and_si128(_mm_srl_epi32(p, bsh), mask);
+    /* sum fits in the low 16 bits of each 32 bit lane */
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi32(77)),
+                              _mm_mullo_epi16(g, _mm_set1_epi32(150)));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi32(29)));
+    y = _mm_add_epi16(y, _mm_set1_epi32(0x80));
+    return(_mm_srli_epi32(y, 8));
+}
+
+__attribute__((target("sse2")))
+static unsigned rgb4_row_to_y_sse2 (uint8_t *dsty,
+                                    const uint8_t *srcp,
+                                    unsigned n,
+                                    int rbit0,
+                                    int gbit0,
+                                    int bbit0)
+{
+    __m128i rsh = _mm_cvtsi32_si128(rbit0);
+    __m128i gsh = _mm_cvtsi32_si128(gbit0);
+    __m128i bsh = _mm_cvtsi32_si128(bbit0);
+    unsigned x;
+    for(x = 0; x + 16 <= n; x += 16, srcp += 64) {
+        __m128i y0 = rgb_to_y_sse2(_mm_loadu_si128((const __m128i*)srcp),
+                                   rsh, gsh, bsh);
+        __m128i y1 = rgb_to_y_sse2(_mm_loadu_si128((const __m128i*)
+                                                   (srcp + 16)),
+                                   rsh, gsh, bsh);
+        __m128i y2 = rgb_to_y_sse2(_mm_loadu_si128((const __m128i*)
+                                                   (srcp + 32)),
+                                   rsh, gsh, bsh);
+        __m128i y3 = rgb_to_y_sse2(_mm_loadu_si128((const __m128i*)
+                                                   (srcp + 48)),
+                                   rsh, gsh, bsh);
+        y0 = _mm_packus_epi16(_mm_packs_epi32(y0, y1),
+                              _mm_packs_epi32(y2, y3));
+        _mm_storeu_si128((__m128i*)(dsty + x), y0);
+    }
+    return(x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rgb_to_y_avx2 (__m256i p,
+                                     __m128i rsh,
+                                     __m128i gsh,
+                                     __m128i bsh)
+{
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i r = _mm256_and_si256(_mm256_srl_epi32(p, rsh), mask);
+    __m256i g = _mm256_and_si256(_mm256_srl_epi32(p, gsh), mask);
+    __m256i b = _mm256_and_si256(_mm256_srl_epi32(p, bsh), mask);
+    __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi32(77)),
+                                 _mm256_mullo_epi16(g, _mm256_set1_epi32(150)));
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, _mm256_set1_epi32(29)));
+    y = _mm256_add_epi16(y, _mm256_set1_epi32(0x80));
+    return(_mm256_srli_epi32(y, 8));
+}
+
+/* load 8 pixels, expanding 24 bit pixels to 32 bits */
+__attribute__((target("avx2")))
+static inline __m256i rgb_load_avx2 (const uint8_t *srcp,
+                                     int bpp)
+{
+    const __m256i expand = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i p;
+    if(bpp == 4)
+        return(_mm256_loadu_si256((const __m256i*)srcp));
+    /* NB reads 4 bytes past the 8th pixel */
+    p = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)srcp));
+    p = _mm256_inserti128_si256(p, _mm_loadu_si128((const __m128i*)
+                                                   (srcp + 12)), 1);
+    return(_mm256_shuffle_epi8(p, expand));
+}
+
+__attribute__((target("avx2")))
+static unsigned rgb_row_to_y_avx2 (uint8_t *dsty,
+                                   const uint8_t *srcp,
+                                   unsigned n,
+                                   int bpp,
+                                   int rbit0,
+                                   int gbit0,
+                                   int bbit0)
+{
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m128i rsh = _mm_cvtsi32_si128(rbit0);
+    __m128i gsh = _mm_cvtsi32_si128(gbit0);
+    __m128i bsh = _mm_cvtsi32_si128(bbit0);
+    /* stay clear of the end of the row for the 24 bit over-read */
+    unsigned end = (bpp == 4) ? n : (n > 2) ? n - 2 : 0;
+    unsigned x;
+    for(x = 0; x + 32 <= end; x += 32, srcp += 32 * bpp) {
+        __m256i y0 = rgb_to_y_avx2(rgb_load_avx2(srcp, bpp),
+                                   rsh, gsh, bsh);
+        __m256i y1 = rgb_to_y_avx2(rgb_load_avx2(srcp + 8 * bpp, bpp),
+                                   rsh, gsh, bsh);
+        __m256i y2 = rgb_to_y_avx2(rgb_load_avx2(srcp + 16 * bpp, bpp),
+                                   rsh, gsh, bsh);
+        __m256i y3 = rgb_to_y_avx2(rgb_load_avx2(srcp + 24 * bpp, bpp),
+                                   rsh, gsh, bsh);
+        y0 = _mm256_packus_epi16(_mm256_packs_epi32(y0, y1),
+                                 _mm256_packs_epi32(y2, y3));
+        /* packing is per 128 bit lane, restore pixel order */
+        y0 = _mm256_permutevar8x32_epi32(y0, order);
+        _mm256_storeu_si256((__m256i*)(dsty + x), y0);
+    }
+    return(x);
+}
+
+#endif
+
+/* extract luma from the start of a row of packed YUV samples
+ * (srcp points at the first Y sample) w/the fastest available kernel.
+ * returns the number of (an even number of) pixels converted,
+ * the caller finishes the row
+ */
+static inline unsigned yuv_row_to_y (uint8_t *dsty,
+                                     const uint8_t *srcp,
+                                     unsigned n)
+{
+#ifdef HAVE_X86_SIMD
+    int simd = cpu_simd();
+    if(simd & SIMD_AVX2)
+        return(yuv_row_to_y_avx2(dsty, srcp, n));
+    if(simd & SIMD_SSE2)
+        return(yuv_row_to_y_sse2(dsty, srcp, n));
+#endif
+    return(0);
+}
+
+/* convert the start of a row of packed RGB to luma
+ * w/the fastest available kernel.  only 24 and 32 bit pixels w/8 bit
+ * components are handled, returns the number of pixels converted,
+ * the caller finishes the row
+ */
+static inline unsigned rgb_row_to_y (uint8_t *dsty,
+                                     const uint8_t *srcp,
+                                     unsigned n,
+                                     const zbar_format_def_t *srcfmt)
+{
+#ifdef HAVE_X86_SIMD
+    int bpp = srcfmt->p.rgb.bpp;
+    int simd;
+    if((bpp != 3 && bpp != 4) ||
+       RGB_SIZE(srcfmt->p.rgb.red) ||
+       RGB_SIZE(srcfmt->p.rgb.green) ||
+       RGB_SIZE(srcfmt->p.rgb.blue))
+        return(0);
+    simd = cpu_simd();
+    if(simd & SIMD_AVX2)
+        return(rgb_row_to_y_avx2(dsty, srcp, n, bpp,
+                                 RGB_OFFSET(srcfmt->p.rgb.red),
+                                 RGB_OFFSET(srcfmt->p.rgb.green),
+                                 RGB_OFFSET(srcfmt->p.rgb.blue)));
+    if((simd & SIMD_SSE2) && bpp == 4)
+        return(rgb4_row_to_y_sse2(dsty, srcp, n,
+                                  RGB_OFFSET(srcfmt->p.rgb.red),
+                                  RGB_OFFSET(srcfmt->p.rgb.green),
+                                  RGB_OFFSET(srcfmt->p.rgb.blue)));
+#endif
+    return(0);
+}
+
 /* cleanup linked image by unrefing */
 static void cleanup_ref (zbar_image_t *img)
 {
@@ -339,24 +625,38 @@ static inline void convert_y_resize (zbar_image_t *dst,
     }
 }
 
-/* make new image w/reference to the same image data */
+/* make new image w/reference to the same image data.
+ * a grayscale view of a full resolution luma plane may also drop rows
+ * from the bottom, as the remaining rows are still contiguous
+ */
 static void convert_copy (zbar_image_t *dst,
                           const zbar_format_def_t *dstfmt,
                           const zbar_image_t *src,
                           const zbar_format_def_t *srcfmt)
 {
+    int gray = dstfmt && dstfmt->group == ZBAR_FMT_GRAY;
     if(src->width == dst->width &&
-       src->height == dst->height) {
+       (src->height == dst->height ||
+        (gray && src->height > dst->height))) {
         zbar_image_t *s = (zbar_image_t*)src;
         dst->data = src->data;
         dst->datalen = src->datalen;
+        if(gray && dst->datalen > dst->width * dst->height)
+            /* only expose the luma plane */
+            dst->datalen = dst->width * dst->height;
         dst->cleanup = cleanup_ref;
+        /* shared, so nothing to return to a pool */
+        dst->pool = NULL;
         dst->next = s;
         _zbar_image_refcnt(s, 1);
     }
-    else
+    else {
         /* NB only for GRAY/YUV_PLANAR formats */
-        convert_y_resize(dst, dstfmt, src, srcfmt, dst->width * dst->height);
+        dst->datalen = dst->width * dst->height;
+        dst->data = convert_alloc(dst);
+        if(!dst->data) return;
+        convert_y_resize(dst, dstfmt, src, srcfmt, dst->datalen);
+    }
 }
 
 /* append neutral UV plane to grayscale image */
@@ -374,7 +674,7 @@ static void convert_uvp_append (zbar_image_t *dst,
     zprintf(24, "dst=%dx%d (%lx) %lx src=%dx%d %lx\n",
             dst->width, dst->height, n, dst->datalen,
             src->width, src->height, src->datalen);
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     convert_y_resize(dst, dstfmt, src, srcfmt, n);
     memset((uint8_t*)dst->data + n, 0x80, dst->datalen - n);
@@ -394,7 +694,7 @@ static void convert_yuv_pack (zbar_image_t *dst,
 
     uv_roundup(dst, dstfmt);
     dst->datalen = dst->width * dst->height + uvp_size(dst, dstfmt) * 2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
 
@@ -458,14 +758,14 @@ static void convert_yuv_unpack (zbar_image_t *dst,
     unsigned long dstn, dstm2;
     uint8_t *dsty, flags;
     const uint8_t *srcp;
-    unsigned srcl, x, y;
+    unsigned srcl, n, x, y;
     uint8_t y0 = 0, y1 = 0;
 
     uv_roundup(dst, dstfmt);
     dstn = dst->width * dst->height;
     dstm2 = uvp_size(dst, dstfmt) * 2;
     dst->datalen = dstn + dstm2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     if(dstm2)
         memset((uint8_t*)dst->data + dstn, 0x80, dstm2);
@@ -477,11 +777,25 @@ static void convert_yuv_unpack (zbar_image_t *dst,
     if(flags)
         srcp++;
 
+    /* pixels per row for the vector kernels.  when the Y samples are
+     * offset, loading the last pair would read past the end of the row
+     */
+    n = (dst->width < src->width) ? dst->width : src->width;
+    if(flags && n)
+        n--;
+
     srcl = src->width + (src->width >> srcfmt->p.yuv.xsub2);
     for(y = 0; y < dst->height; y++) {
         if(y >= src->height)
             srcp -= srcl;
-        for(x = 0; x < dst->width; x += 2) {
+        x = yuv_row_to_y(dsty, srcp, n);
+        if(x) {
+            srcp += x * 2;
+            dsty += x;
+            y0 = dsty[-2];
+            y1 = dsty[-1];
+        }
+        for(; x < dst->width; x += 2) {
             if(x < src->width) {
                 y0 = *(srcp++);  srcp++;
                 y1 = *(srcp++);  srcp++;
@@ -507,7 +821,7 @@ static void convert_uvp_resample (zbar_image_t *dst,
     dstn = dst->width * dst->height;
     dstm2 = uvp_size(dst, dstfmt) * 2;
     dst->datalen = dstn + dstm2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     convert_y_resize(dst, dstfmt, src, srcfmt, dstn);
     if(dstm2)
@@ -529,7 +843,7 @@ static void convert_uv_resample (zbar_image_t *dst,
     uv_roundup(dst, dstfmt);
     dstn = dst->width * dst->height;
     dst->datalen = dstn + uvp_size(dst, dstfmt) * 2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
 
@@ -583,7 +897,7 @@ static void convert_yuvp_to_rgb (zbar_image_t *dst,
     uint32_t p = 0;
 
     dst->datalen = dst->width * dst->height * dstfmt->p.rgb.bpp;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
 
@@ -637,7 +951,7 @@ static void convert_rgb_to_yuvp (zbar_image_t *dst,
     dstn = dst->width * dst->height;
     dstm2 = uvp_size(dst, dstfmt) * 2;
     dst->datalen = dstn + dstm2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     if(dstm2)
         memset((uint8_t*)dst->data + dstn, 0x80, dstm2);
@@ -657,7 +971,15 @@ static void convert_rgb_to_yuvp (zbar_image_t *dst,
     for(y = 0; y < dst->height; y++) {
         if(y >= src->height)
             srcp -= srcl;
-        for(x = 0; x < dst->width; x++) {
+        x = rgb_row_to_y(dsty, srcp,
+                         (dst->width < src->width) ? dst->width : src->width,
+                         srcfmt);
+        if(x) {
+            srcp += x * srcfmt->p.rgb.bpp;
+            dsty += x;
+            y0 = dsty[-1];
+        }
+        for(; x < dst->width; x++) {
             if(x < src->width) {
                 uint8_t r, g, b;
                 uint32_t p = convert_read_rgb(srcp, srcfmt->p.rgb.bpp);
@@ -669,7 +991,7 @@ static void convert_rgb_to_yuvp (zbar_image_t *dst,
                 b = ((p >> bbit0) << bbits) & 0xff;
 
                 /* FIXME color space? */
-                y0 = ((77 * r + 150 * g + 29 * b) + 0x80) >> 8;
+                y0 = RGB_TO_Y(r, g, b);
             }
             *(dsty++) = y0;
         }
@@ -692,7 +1014,7 @@ static void convert_yuv_to_rgb (zbar_image_t *dst,
     uint32_t p = 0;
 
     dst->datalen = dstn * dstfmt->p.rgb.bpp;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
 
@@ -754,7 +1076,7 @@ static void convert_rgb_to_yuv (zbar_image_t *dst,
 
     uv_roundup(dst, dstfmt);
     dst->datalen = dst->width * dst->height + uvp_size(dst, dstfmt) * 2;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
     flags = dstfmt->p.yuv.packorder & 2;
@@ -785,7 +1107,7 @@ static void convert_rgb_to_yuv (zbar_image_t *dst,
                 b = ((p >> bbit0) << bbits) & 0xff;
 
                 /* FIXME color space? */
-                y0 = ((77 * r + 150 * g + 29 * b) + 0x80) >> 8;
+                y0 = RGB_TO_Y(r, g, b);
             }
             if(flags) {
                 *(dstp++) = 0x80;  *(dstp++) = y0;
@@ -814,7 +1136,7 @@ static void convert_rgb_resample (zbar_image_t *dst,
     uint32_t p = 0;
 
     dst->datalen = dstn * dstfmt->p.rgb.bpp;
-    dst->data = malloc(dst->datalen);
+    dst->data = convert_alloc(dst);
     if(!dst->data) return;
     dstp = (void*)dst->data;
 
@@ -868,6 +1190,10 @@ void _zbar_convert_jpeg_to_y(zbar_image_t *dst,
                               const zbar_image_t *src,
                               const zbar_format_def_t *srcfmt);
 
+zbar_image_t *_zbar_jpeg_decode_crop(zbar_image_pool_t *pool,
+                                     const zbar_image_t *src,
+                                     unsigned denom);
+
 static void convert_jpeg(zbar_image_t *dst,
                          const zbar_format_def_t *dstfmt,
                          const zbar_image_t *src,
@@ -967,6 +1293,8 @@ static void convert_jpeg (zbar_image_t *dst,
         tmp = zbar_image_create();
         tmp->format = fourcc('Y','8','0','0');
         _zbar_image_copy_size(tmp, dst);
+        /* intermediate is the same size every frame, so recycle it too */
+        tmp->pool = dst->pool;
     }
     else {
         tmp = src->src->jpeg_img;
@@ -993,10 +1321,124 @@ static void convert_jpeg (zbar_image_t *dst,
 }
 #endif
 
-zbar_image_t *zbar_image_convert_resize (const zbar_image_t *src,
-                                         unsigned long fmt,
-                                         unsigned width,
-                                         unsigned height)
+void zbar_image_convert_set_threads (unsigned nthreads)
+{
+    if(nthreads < 1)
+        nthreads = 1;
+    else if(nthreads > MAX_BANDS)
+        nthreads = MAX_BANDS;
+    convert_threads = nthreads;
+}
+
+/* bytes per pixel of a single plane format, 0 for multi-plane formats */
+static inline unsigned convert_plane_bpp (const zbar_format_def_t *fmt)
+{
+    switch(fmt->group) {
+    case ZBAR_FMT_GRAY:         return(1);
+    case ZBAR_FMT_YUV_PACKED:   return(2);
+    case ZBAR_FMT_RGB_PACKED:   return(fmt->p.rgb.bpp);
+    default:                    return(0);
+    }
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *convert_band_thread (void *arg)
+{
+    convert_band_t *band = arg;
+    band->func(&band->dst, band->dstfmt, &band->src, band->srcfmt);
+    return(NULL);
+}
+#endif
+
+/* split a large conversion into bands of rows, converting each in
+ * parallel.  conversions between single plane formats at the same
+ * size handle each row independently, so each band is simply a view
+ * of a range of rows of the source and destination images.
+ * returns 0 if the conversion is not suitable (or not large enough)
+ */
+static int convert_bands (zbar_image_t *dst,
+                          const zbar_format_def_t *dstfmt,
+                          const zbar_image_t *src,
+                          const zbar_format_def_t *srcfmt,
+                          conversion_handler_t *func)
+{
+#ifdef HAVE_LIBPTHREAD
+    convert_band_t bands[MAX_BANDS];
+    pthread_t tids[MAX_BANDS];
+    int started[MAX_BANDS];
+    unsigned sbpp, dbpp, nbands, i, y0;
+    unsigned long npix = (unsigned long)src->width * src->height;
+
+    nbands = npix / BAND_MIN_PIXELS;
+    if(nbands > convert_threads)
+        nbands = convert_threads;
+    if(nbands > src->height)
+        nbands = src->height;
+    if(nbands < 2 || func == convert_copy ||
+       dst->width != src->width || dst->height != src->height)
+        return(0);
+
+    sbpp = convert_plane_bpp(srcfmt);
+    dbpp = convert_plane_bpp(dstfmt);
+    if(!sbpp || !dbpp || src->datalen < npix * sbpp)
+        return(0);
+    /* packed YUV rounds odd widths up to whole chroma samples */
+    if((srcfmt->group == ZBAR_FMT_YUV_PACKED ||
+        dstfmt->group == ZBAR_FMT_YUV_PACKED) &&
+       (src->width & 1))
+        return(0);
+
+    dst->datalen = npix * dbpp;
+    dst->data = _zbar_image_pool_alloc(dst);
+    if(!dst->data)
+        return(1);
+
+    zprintf(24, "%d bands: %.4s(%08" PRIx32 ") => %.4s(%08" PRIx32 ")\n",
+            nbands, (char*)&src->format, src->format,
+            (char*)&dst->format, dst->format);
+    for(i = 0, y0 = 0; i < nbands; i++) {
+        convert_band_t *band = &bands[i];
+        unsigned y1 = src->height * (i + 1) / nbands;
+        band->src = *src;
+        band->src.data = (const uint8_t*)src->data +
+            (unsigned long)y0 * src->width * sbpp;
+        band->src.height = y1 - y0;
+        band->src.datalen = (unsigned long)(y1 - y0) * src->width * sbpp;
+        band->src.crop_y = 0;
+        band->src.crop_h = y1 - y0;
+        band->dst = *dst;
+        band->dst.data = (const uint8_t*)dst->data +
+            (unsigned long)y0 * dst->width * dbpp;
+        band->dst.height = y1 - y0;
+        band->dst.crop_y = 0;
+        band->dst.crop_h = y1 - y0;
+        band->dstfmt = dstfmt;
+        band->srcfmt = srcfmt;
+        band->func = func;
+        y0 = y1;
+    }
+
+    /* caller converts the first band */
+    for(i = 1; i < nbands; i++)
+        started[i] = !pthread_create(&tids[i], NULL, convert_band_thread,
+                                     &bands[i]);
+    convert_band_thread(&bands[0]);
+    for(i = 1; i < nbands; i++)
+        if(started[i])
+            pthread_join(tids[i], NULL);
+        else
+            convert_band_thread(&bands[i]);
+    return(1);
+#else
+    return(0);
+#endif
+}
+
+static zbar_image_t *convert_resize (zbar_image_pool_t *pool,
+                                     const zbar_image_t *src,
+                                     unsigned long fmt,
+                                     unsigned width,
+                                     unsigned height)
 {
     const zbar_format_def_t *srcfmt, *dstfmt;
     conversion_handler_t *func;
@@ -1004,8 +1446,11 @@ zbar_image_t *zbar_image_convert_resize (const zbar_image_t *src,
     dst->format = fmt;
     dst->width = width;
     dst->height = height;
+    dst->time = src->time;
     zbar_image_set_crop(dst, src->crop_x, src->crop_y,
                         src->crop_w, src->crop_h);
+    dst->frame_x = src->frame_x;
+    dst->frame_y = src->frame_y;
     if(src->format == fmt &&
        src->width == width &&
        src->height == height) {
@@ -1029,8 +1474,11 @@ zbar_image_t *zbar_image_convert_resize (const zbar_image_t *src,
 
     func = conversions[srcfmt->group][dstfmt->group].func;
 
+    /* only output allocated by the conversion comes from the pool */
+    dst->pool = pool;
     dst->cleanup = zbar_image_free_data;
-    func(dst, dstfmt, src, srcfmt);
+    if(!convert_bands(dst, dstfmt, src, srcfmt, func))
+        func(dst, dstfmt, src, srcfmt);
     if(!dst->data) {
         /* conversion failed */
         zbar_image_destroy(dst);
@@ -1039,10 +1487,392 @@ zbar_image_t *zbar_image_convert_resize (const zbar_image_t *src,
     return(dst);
 }
 
+zbar_image_t *zbar_image_convert_resize (const zbar_image_t *src,
+                                         unsigned long fmt,
+                                         unsigned width,
+                                         unsigned height)
+{
+    return(convert_resize(NULL, src, fmt, width, height));
+}
+
 zbar_image_t *zbar_image_convert (const zbar_image_t *src,
                                   unsigned long fmt)
 {
-    return(zbar_image_convert_resize(src, fmt, src->width, src->height));
+    return(convert_resize(NULL, src, fmt, src->width, src->height));
+}
+
+zbar_image_t *zbar_image_pool_convert_resize (zbar_image_pool_t *pool,
+                                              const zbar_image_t *src,
+                                              unsigned long fmt,
+                                              unsigned width,
+                                              unsigned height)
+{
+    return(convert_resize(pool, src, fmt, width, height));
+}
+
+zbar_image_t *zbar_image_pool_convert (zbar_image_pool_t *pool,
+                                       const zbar_image_t *src,
+                                       unsigned long fmt)
+{
+    return(convert_resize(pool, src, fmt, src->width, src->height));
+}
+
+/* extract luma for w pixels of row y, starting at column x0.
+ * NB no JPEG
+ */
+static void convert_row_to_y (uint8_t *dsty,
+                              const zbar_image_t *src,
+                              const zbar_format_def_t *srcfmt,
+                              unsigned x0,
+                              unsigned y,
+                              unsigned w)
+{
+    const uint8_t *srcp = src->data;
+    unsigned x = 0;
+    if(srcfmt->group == ZBAR_FMT_YUV_PACKED) {
+        int offset = (srcfmt->p.yuv.packorder & 2) >> 1;
+        srcp += (y * src->width + x0) * 2 + offset;
+        /* when offset, loading the last pair would read past the row */
+        if(w > 1)
+            x = yuv_row_to_y(dsty, srcp, w - offset);
+        for(; x < w; x++)
+            dsty[x] = srcp[x * 2];
+    }
+    else if(srcfmt->group == ZBAR_FMT_RGB_PACKED) {
+        int bpp = srcfmt->p.rgb.bpp;
+        int rbits = RGB_SIZE(srcfmt->p.rgb.red);
+        int rbit0 = RGB_OFFSET(srcfmt->p.rgb.red);
+        int gbits = RGB_SIZE(srcfmt->p.rgb.green);
+        int gbit0 = RGB_OFFSET(srcfmt->p.rgb.green);
+        int bbits = RGB_SIZE(srcfmt->p.rgb.blue);
+        int bbit0 = RGB_OFFSET(srcfmt->p.rgb.blue);
+        srcp += (y * src->width + x0) * bpp;
+        x = rgb_row_to_y(dsty, srcp, w, srcfmt);
+        for(srcp += x * bpp; x < w; x++, srcp += bpp) {
+            uint32_t p = convert_read_rgb(srcp, bpp);
+            uint8_t r = ((p >> rbit0) << rbits) & 0xff;
+            uint8_t g = ((p >> gbit0) << gbits) & 0xff;
+            uint8_t b = ((p >> bbit0) << bbits) & 0xff;
+            dsty[x] = RGB_TO_Y(r, g, b);
+        }
+    }
+    else
+        /* GRAY, YUV_PLANAR and YUV_NV start w/a full resolution Y plane */
+        memcpy(dsty, srcp + y * src->width + x0, w);
+}
+
+static zbar_image_t *convert_scaled (zbar_image_pool_t *pool,
+                                     const zbar_image_t *src,
+                                     unsigned long fmt,
+                                     unsigned scale)
+{
+    const zbar_format_def_t *srcfmt, *dstfmt;
+    zbar_image_t *dst, *tmp = NULL;
+    unsigned long srcn;
+    unsigned x0, y0, w, h, x, y, k, n, recip;
+    uint8_t *dsty, *row = NULL;
+    uint16_t *sum = NULL;
+
+    srcfmt = _zbar_format_lookup(src->format);
+    dstfmt = _zbar_format_lookup(fmt);
+    if(!srcfmt || !dstfmt || dstfmt->group != ZBAR_FMT_GRAY ||
+       scale < 1 || scale > MAX_SCALE)
+        return(NULL);
+
+    if(srcfmt->group == ZBAR_FMT_JPEG) {
+#ifdef HAVE_LIBJPEG
+        /* decode just the crop, leaving any power of 2 downscale to
+         * the IDCT and the remainder to the box filter
+         */
+        unsigned denom = (scale == 4) ? 4 : (scale == 2) ? 2 : 1;
+        /* which only lines up w/the blocks when the crop does */
+        while((src->crop_x | src->crop_y) & (denom - 1))
+            denom >>= 1;
+        tmp = _zbar_jpeg_decode_crop(pool, src, denom);
+        if(!tmp)
+            return(NULL);
+        scale /= denom;
+        src = tmp;
+        srcfmt = _zbar_format_lookup(tmp->format);
+#else
+        return(NULL);
+#endif
+    }
+
+    srcn = src->width * src->height;
+    if(srcfmt->group == ZBAR_FMT_YUV_PACKED)
+        srcn *= 2;
+    else if(srcfmt->group == ZBAR_FMT_RGB_PACKED)
+        srcn *= srcfmt->p.rgb.bpp;
+    x0 = src->crop_x;
+    y0 = src->crop_y;
+    w = src->crop_w / scale;
+    h = src->crop_h / scale;
+    if(!w || !h || src->datalen < srcn ||
+       x0 + w * scale > src->width || y0 + h * scale > src->height) {
+        if(tmp)
+            zbar_image_destroy(tmp);
+        return(NULL);
+    }
+
+    dst = zbar_image_create();
+    dst->format = fmt;
+    dst->time = src->time;
+    zbar_image_set_size(dst, w, h);
+    dst->datalen = w * h;
+    dst->pool = pool;
+    dst->cleanup = zbar_image_free_data;
+    dst->data = dsty = _zbar_image_pool_alloc(dst);
+    if(scale > 1) {
+        row = malloc(w * scale);
+        sum = malloc(w * sizeof(*sum));
+    }
+    if(!dsty || (scale > 1 && (!row || !sum))) {
+        zbar_image_destroy(dst);
+        dst = NULL;
+        goto done;
+    }
+
+    /* box filter: average each scale x scale block,
+     * dividing by multiplication w/a (rounded up) 16 bit reciprocal,
+     * which is exact for the possible sums
+     */
+    n = scale * scale;
+    recip = ((1 << 16) + n - 1) / n;
+    for(y = 0; y < h; y++, dsty += w) {
+        if(scale == 1) {
+            convert_row_to_y(dsty, src, srcfmt, x0, y0 + y, w);
+            continue;
+        }
+        memset(sum, 0, w * sizeof(*sum));
+        for(k = 0; k < scale; k++) {
+            const uint8_t *p = row;
+            convert_row_to_y(row, src, srcfmt, x0, y0 + y * scale + k,
+                             w * scale);
+            if(scale == 2)
+                for(x = 0; x < w; x++, p += 2)
+                    sum[x] += p[0] + p[1];
+            else
+                for(x = 0; x < w; x++) {
+                    unsigned i;
+                    for(i = 0; i < scale; i++)
+                        sum[x] += *(p++);
+                }
+        }
+        for(x = 0; x < w; x++)
+            dsty[x] = ((sum[x] + n / 2) * recip) >> 16;
+    }
+
+done:
+    if(row)
+        free(row);
+    if(sum)
+        free(sum);
+    if(tmp)
+        zbar_image_destroy(tmp);
+    return(dst);
+}
+
+zbar_image_t *zbar_image_convert_scaled (const zbar_image_t *src,
+                                         unsigned long fmt,
+                                         unsigned scale)
+{
+    return(convert_scaled(NULL, src, fmt, scale));
+}
+
+zbar_image_t *zbar_image_pool_convert_scaled (zbar_image_pool_t *pool,
+                                              const zbar_image_t *src,
+                                              unsigned long fmt,
+                                              unsigned scale)
+{
+    return(convert_scaled(pool, src, fmt, scale));
+}
+
+/* read all candidate channels of an RGB pixel */
+static inline void contrast_read (uint8_t *v,
+                                  const uint8_t *srcp,
+                                  const zbar_format_def_t *srcfmt)
+{
+    uint32_t p = convert_read_rgb(srcp, srcfmt->p.rgb.bpp);
+    uint8_t r = ((p >> RGB_OFFSET(srcfmt->p.rgb.red)) <<
+                 RGB_SIZE(srcfmt->p.rgb.red)) & 0xff;
+    uint8_t g = ((p >> RGB_OFFSET(srcfmt->p.rgb.green)) <<
+                 RGB_SIZE(srcfmt->p.rgb.green)) & 0xff;
+    uint8_t b = ((p >> RGB_OFFSET(srcfmt->p.rgb.blue)) <<
+                 RGB_SIZE(srcfmt->p.rgb.blue)) & 0xff;
+    v[CONTRAST_LUMA] = RGB_TO_Y(r, g, b);
+    v[CONTRAST_RED] = r;
+    v[CONTRAST_GREEN] = g;
+    v[CONTRAST_BLUE] = b;
+}
+
+/* pick the channel w/the most local contrast in a tile.
+ * contrast is the sum of absolute differences between neighboring
+ * samples in both directions.  a color channel has to beat luma by a
+ * margin, so noise alone doesn't pick one for neutral images.
+ * a color channel is inverted (*invert) when most of the tile is
+ * darker than its mid-range, so the background (and quiet zone) of a
+ * symbol comes out light
+ */
+static contrast_channel_t contrast_select (const zbar_image_t *src,
+                                           const zbar_format_def_t *srcfmt,
+                                           unsigned x0,
+                                           unsigned y0,
+                                           unsigned w,
+                                           unsigned h,
+                                           int *invert)
+{
+    unsigned long score[CONTRAST_NUM] = { 0, }, sum[CONTRAST_NUM] = { 0, };
+    uint8_t min[CONTRAST_NUM], max[CONTRAST_NUM];
+    unsigned long n = 0;
+    unsigned bpp = srcfmt->p.rgb.bpp;
+    unsigned long stride = src->width * bpp, best_score;
+    unsigned x, y, c;
+    contrast_channel_t best = CONTRAST_LUMA;
+
+    memset(min, 0xff, sizeof(min));
+    memset(max, 0, sizeof(max));
+    for(y = 0; y + CONTRAST_STEP < h; y += CONTRAST_STEP) {
+        const uint8_t *srcp = (const uint8_t*)src->data +
+            (y0 + y) * stride + x0 * bpp;
+        for(x = 0; x + CONTRAST_STEP < w;
+            x += CONTRAST_STEP, srcp += CONTRAST_STEP * bpp) {
+            uint8_t v[CONTRAST_NUM], vx[CONTRAST_NUM], vy[CONTRAST_NUM];
+            contrast_read(v, srcp, srcfmt);
+            contrast_read(vx, srcp + CONTRAST_STEP * bpp, srcfmt);
+            contrast_read(vy, srcp + CONTRAST_STEP * stride, srcfmt);
+            for(c = 0; c < CONTRAST_NUM; c++) {
+                score[c] += abs(vx[c] - v[c]) + abs(vy[c] - v[c]);
+                sum[c] += v[c];
+                if(min[c] > v[c])
+                    min[c] = v[c];
+                if(max[c] < v[c])
+                    max[c] = v[c];
+            }
+            n++;
+        }
+    }
+
+    best_score = score[CONTRAST_LUMA] + score[CONTRAST_LUMA] / 4;
+    for(c = CONTRAST_RED; c < CONTRAST_NUM; c++)
+        if(score[c] > best_score) {
+            best = c;
+            best_score = score[c];
+        }
+    *invert = (best != CONTRAST_LUMA &&
+               sum[best] * 2 < n * (min[best] + max[best]));
+    return(best);
+}
+
+/* extract one channel for w pixels of row y, starting at column x0 */
+static void contrast_row (uint8_t *dsty,
+                          const zbar_image_t *src,
+                          const zbar_format_def_t *srcfmt,
+                          unsigned x0,
+                          unsigned y,
+                          unsigned w,
+                          contrast_channel_t ch,
+                          int invert)
+{
+    unsigned bpp = srcfmt->p.rgb.bpp, bits, bit0, x;
+    const uint8_t *srcp;
+    if(ch == CONTRAST_LUMA) {
+        convert_row_to_y(dsty, src, srcfmt, x0, y, w);
+        return;
+    }
+    bits = (ch == CONTRAST_RED) ? srcfmt->p.rgb.red :
+        (ch == CONTRAST_GREEN) ? srcfmt->p.rgb.green : srcfmt->p.rgb.blue;
+    bit0 = RGB_OFFSET(bits);
+    bits = RGB_SIZE(bits);
+    srcp = (const uint8_t*)src->data + (y * src->width + x0) * bpp;
+    for(x = 0; x < w; x++, srcp += bpp) {
+        uint8_t v = ((convert_read_rgb(srcp, bpp) >> bit0) << bits) & 0xff;
+        dsty[x] = (invert) ? 0xff - v : v;
+    }
+}
+
+static zbar_image_t *convert_contrast (zbar_image_pool_t *pool,
+                                       const zbar_image_t *src,
+                                       unsigned long fmt,
+                                       unsigned tile)
+{
+    const zbar_format_def_t *srcfmt, *dstfmt;
+    zbar_image_t *dst;
+    unsigned tw, th, ntx, nty, tx, ty, y;
+    uint8_t *dsty, *sel;
+
+    srcfmt = _zbar_format_lookup(src->format);
+    dstfmt = _zbar_format_lookup(fmt);
+    if(!srcfmt || !dstfmt || dstfmt->group != ZBAR_FMT_GRAY)
+        return(NULL);
+    if(srcfmt->group != ZBAR_FMT_RGB_PACKED)
+        /* no color to choose from */
+        return(convert_resize(pool, src, fmt, src->width, src->height));
+    if(!src->width || !src->height ||
+       src->datalen < src->width * src->height * srcfmt->p.rgb.bpp)
+        return(NULL);
+
+    tw = (tile && tile < src->width) ? tile : src->width;
+    th = (tile && tile < src->height) ? tile : src->height;
+    ntx = (src->width + tw - 1) / tw;
+    nty = (src->height + th - 1) / th;
+    sel = malloc(ntx * nty * 2);
+    if(!sel)
+        return(NULL);
+
+    dst = zbar_image_create();
+    dst->format = fmt;
+    dst->time = src->time;
+    _zbar_image_copy_size(dst, src);
+    dst->datalen = src->width * src->height;
+    dst->pool = pool;
+    dst->cleanup = zbar_image_free_data;
+    dst->data = dsty = _zbar_image_pool_alloc(dst);
+    if(!dsty) {
+        zbar_image_destroy(dst);
+        free(sel);
+        return(NULL);
+    }
+
+    for(ty = 0; ty < nty; ty++)
+        for(tx = 0; tx < ntx; tx++) {
+            unsigned x0 = tx * tw, y0 = ty * th;
+            unsigned w = (x0 + tw > src->width) ? src->width - x0 : tw;
+            unsigned h = (y0 + th > src->height) ? src->height - y0 : th;
+            int invert;
+            uint8_t *s = sel + (ty * ntx + tx) * 2;
+            s[0] = contrast_select(src, srcfmt, x0, y0, w, h, &invert);
+            s[1] = invert;
+            zprintf(32, "tile %d,%d: channel %d%s\n",
+                    tx, ty, s[0], (invert) ? " (inverted)" : "");
+        }
+
+    for(y = 0; y < src->height; y++, dsty += src->width) {
+        const uint8_t *s = sel + (y / th) * ntx * 2;
+        for(tx = 0; tx < ntx; tx++, s += 2) {
+            unsigned x0 = tx * tw;
+            unsigned w = (x0 + tw > src->width) ? src->width - x0 : tw;
+            contrast_row(dsty + x0, src, srcfmt, x0, y, w, s[0], s[1]);
+        }
+    }
+
+    free(sel);
+    return(dst);
+}
+
+zbar_image_t *zbar_image_convert_contrast (const zbar_image_t *src,
+                                           unsigned long fmt,
+                                           unsigned tile)
+{
+    return(convert_contrast(NULL, src, fmt, tile));
+}
+
+zbar_image_t *zbar_image_pool_convert_contrast (zbar_image_pool_t *pool,
+                                                const zbar_image_t *src,
+                                                unsigned long fmt,
+                                                unsigned tile)
+{
+    return(convert_contrast(pool, src, fmt, tile));
 }
 
 static inline int has_format (uint32_t fmt,
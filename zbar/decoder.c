@@ -36,6 +36,7 @@
 #endif
 #include "debug.h"
 #include "decoder.h"
+#include "scanner.h"
 
 zbar_decoder_t *zbar_decoder_create ()
 {
@@ -165,6 +166,78 @@ void zbar_decoder_new_scan (zbar_decoder_t *dcode)
 #endif
 }
 
+/* save and restore a scan in progress, see scanner.h */
+unsigned _zbar_decoder_state_size (void)
+{
+    return(sizeof(zbar_decoder_t));
+}
+
+void _zbar_decoder_save_state (const zbar_decoder_t *dcode,
+                               void *state)
+{
+    zbar_decoder_t *save = state;
+    unsigned char *buf = save->buf;
+    unsigned buf_alloc = save->buf_alloc;
+
+    memcpy(save, dcode, sizeof(zbar_decoder_t));
+
+    /* buffered characters only matter while a symbology holds the lock */
+    if(dcode->lock && buf_alloc < dcode->buf_alloc) {
+        unsigned char *tmp = realloc(buf, dcode->buf_alloc);
+        if(tmp) {
+            buf = tmp;
+            buf_alloc = dcode->buf_alloc;
+        }
+        else
+            /* drop the partial symbol */
+            save->lock = 0;
+    }
+    if(save->lock)
+        memcpy(buf, dcode->buf, dcode->buf_alloc);
+    save->buf = buf;
+    save->buf_alloc = buf_alloc;
+}
+
+void _zbar_decoder_restore_state (zbar_decoder_t *dcode,
+                                  const void *state)
+{
+    const zbar_decoder_t *save = state;
+    unsigned char *buf = dcode->buf;
+    unsigned buf_alloc = dcode->buf_alloc;
+    void *userdata = dcode->userdata;
+    zbar_decoder_handler_t *handler = dcode->handler;
+#ifdef ENABLE_DATABAR
+    databar_decoder_t databar = dcode->databar;
+#endif
+
+    memcpy(dcode, save, sizeof(zbar_decoder_t));
+    dcode->buf = buf;
+    dcode->buf_alloc = buf_alloc;
+    dcode->userdata = userdata;
+    dcode->handler = handler;
+#ifdef ENABLE_DATABAR
+    /* segments are shared by all scans, so outstanding characters
+     * of the saved scan may have been reused meanwhile
+     */
+    memset(databar.chars, -1, sizeof(databar.chars));
+    dcode->databar = databar;
+#endif
+
+    /* NB the live buffer only grows, so it holds anything saved from it */
+    if(save->lock)
+        memcpy(dcode->buf, save->buf,
+               (save->buf_alloc < buf_alloc) ? save->buf_alloc : buf_alloc);
+}
+
+void _zbar_decoder_free_state (void *state)
+{
+    zbar_decoder_t *save = state;
+    if(save->buf)
+        free(save->buf);
+    save->buf = NULL;
+    save->buf_alloc = 0;
+}
+
 
 zbar_color_t zbar_decoder_get_color (const zbar_decoder_t *dcode)
 {
@@ -32,7 +32,8 @@ static const char * const sev_str[] = {
 #define SEV_MAX (strlen(sev_str[0]))
 
 static const char * const mod_str[] = {
-    "processor", "video", "window", "image scanner", "<unknown>"
+    "processor", "video", "window", "image scanner", "capture",
+    "<unknown>"
 };
 #define MOD_MAX (strlen(mod_str[ZBAR_MOD_IMAGE_SCANNER]))
 
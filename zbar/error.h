@@ -64,6 +64,7 @@ typedef enum errmodule_e {
     ZBAR_MOD_VIDEO,
     ZBAR_MOD_WINDOW,
     ZBAR_MOD_IMAGE_SCANNER,
+    ZBAR_MOD_CAPTURE,
     ZBAR_MOD_UNKNOWN,
 } errmodule_t;
 
@@ -64,6 +64,11 @@ unsigned zbar_image_get_sequence (const zbar_image_t *img)
     return(img->seq);
 }
 
+unsigned long zbar_image_get_timestamp (const zbar_image_t *img)
+{
+    return(img->time);
+}
+
 unsigned zbar_image_get_width (const zbar_image_t *img)
 {
     return(img->width);
@@ -116,6 +121,12 @@ void zbar_image_set_sequence (zbar_image_t *img,
     img->seq = seq;
 }
 
+void zbar_image_set_timestamp (zbar_image_t *img,
+                               unsigned long time)
+{
+    img->time = time;
+}
+
 void zbar_image_set_size (zbar_image_t *img,
                           unsigned w,
                           unsigned h)
@@ -177,6 +188,118 @@ inline void zbar_image_free_data (zbar_image_t *img)
     img->data = NULL;
 }
 
+static void image_pool_free (zbar_image_pool_t *pool)
+{
+    int i, j;
+    for(i = 0; i < POOL_BUCKETS; i++) {
+        image_pool_bucket_t *bkt = &pool->buckets[i];
+        for(j = 0; j < bkt->nbufs; j++)
+            free(bkt->bufs[j]);
+        bkt->nbufs = 0;
+    }
+}
+
+zbar_image_pool_t *zbar_image_pool_create ()
+{
+    zbar_image_pool_t *pool = calloc(1, sizeof(zbar_image_pool_t));
+    if(!pool)
+        return(NULL);
+    _zbar_refcnt_init();
+    _zbar_refcnt(&pool->refcnt, 1);
+    _zbar_mutex_init(&pool->lock);
+    return(pool);
+}
+
+static void image_pool_ref (zbar_image_pool_t *pool,
+                            int delta)
+{
+    if(!_zbar_refcnt(&pool->refcnt, delta) && delta <= 0) {
+        image_pool_free(pool);
+        _zbar_mutex_destroy(&pool->lock);
+        free(pool);
+    }
+}
+
+void zbar_image_pool_destroy (zbar_image_pool_t *pool)
+{
+    _zbar_mutex_lock(&pool->lock);
+    pool->destroyed = 1;
+    image_pool_free(pool);
+    _zbar_mutex_unlock(&pool->lock);
+    image_pool_ref(pool, -1);
+}
+
+/* cleanup handler for pooled data: hand the buffer back */
+static void image_pool_release (zbar_image_t *img)
+{
+    zbar_image_pool_t *pool = img->pool;
+    image_pool_bucket_t *bkt = NULL, *empty = NULL;
+    void *buf = (void*)img->data;
+    int i;
+    if(!pool)
+        /* already released */
+        return;
+    img->data = NULL;
+    img->pool = NULL;
+
+    _zbar_mutex_lock(&pool->lock);
+    for(i = 0; !pool->destroyed && i < POOL_BUCKETS; i++) {
+        image_pool_bucket_t *b = &pool->buckets[i];
+        if(b->format == img->format && b->datalen == img->datalen) {
+            bkt = b;
+            break;
+        }
+        if(!b->nbufs && !empty)
+            empty = b;
+    }
+    if(!bkt && empty) {
+        /* recycle an unused bucket for this size */
+        bkt = empty;
+        bkt->format = img->format;
+        bkt->datalen = img->datalen;
+    }
+    if(buf && bkt && bkt->nbufs < POOL_DEPTH) {
+        bkt->bufs[bkt->nbufs++] = buf;
+        buf = NULL;
+    }
+    _zbar_mutex_unlock(&pool->lock);
+
+    if(buf)
+        free(buf);
+    image_pool_ref(pool, -1);
+}
+
+void *_zbar_image_pool_alloc (zbar_image_t *img)
+{
+    zbar_image_pool_t *pool = img->pool;
+    void *buf = NULL;
+    int i;
+    if(!pool)
+        return(malloc(img->datalen));
+
+    _zbar_mutex_lock(&pool->lock);
+    for(i = 0; i < POOL_BUCKETS; i++) {
+        image_pool_bucket_t *bkt = &pool->buckets[i];
+        if(bkt->nbufs &&
+           bkt->format == img->format && bkt->datalen == img->datalen) {
+            buf = bkt->bufs[--bkt->nbufs];
+            break;
+        }
+    }
+    _zbar_mutex_unlock(&pool->lock);
+
+    if(!buf)
+        buf = malloc(img->datalen);
+    if(!buf) {
+        img->pool = NULL;
+        return(NULL);
+    }
+    /* buffer holds a pool reference until released */
+    image_pool_ref(pool, 1);
+    img->cleanup = image_pool_release;
+    return(buf);
+}
+
 void zbar_image_set_data (zbar_image_t *img,
                           const void *data,
                           unsigned long len,
@@ -209,6 +332,7 @@ zbar_image_t *zbar_image_copy (const zbar_image_t *src)
     assert(dst->data);
     memcpy((void*)dst->data, src->data, src->datalen);
     dst->cleanup = zbar_image_free_data;
+    dst->time = src->time;
     return(dst);
 }
 
@@ -232,12 +356,6 @@ const zbar_symbol_t *zbar_image_first_symbol (const zbar_image_t *img)
     return((img->syms) ? img->syms->head : NULL);
 }
 
-typedef struct zimg_hdr_s {
-    uint32_t magic, format;
-    uint16_t width, height;
-    uint32_t size;
-} zimg_hdr_t;
-
 int zbar_image_write (const zbar_image_t *img,
                       const char *filebase)
 {
@@ -270,7 +388,7 @@ int zbar_image_write (const zbar_image_t *img,
         goto error;
     }
 
-    hdr.magic = 0x676d697a;
+    hdr.magic = ZIMG_MAGIC;
     hdr.format = img->format;
     hdr.width = img->width;
     hdr.height = img->height;
@@ -34,6 +34,7 @@
 #include "error.h"
 #include "symbol.h"
 #include "refcnt.h"
+#include "mutex.h"
 
 #define fourcc zbar_fourcc
 
@@ -64,6 +65,8 @@ struct zbar_image_s {
     unsigned long datalen;      /* allocated/mapped size of data */
     unsigned crop_x, crop_y;    /* crop rectangle */
     unsigned crop_w, crop_h;
+    unsigned frame_x, frame_y;  /* position in the full video frame */
+    unsigned roi_gen;           /* video region of interest queued for */
     void *userdata;             /* user specified data associated w/image */
 
     /* cleanup handler */
@@ -74,7 +77,37 @@ struct zbar_image_s {
     zbar_image_t *next;         /* internal image lists */
 
     unsigned seq;               /* page/frame sequence number */
+    unsigned long time;         /* capture timestamp (ms), 0 if unknown */
     zbar_symbol_set_t *syms;    /* decoded result set */
+
+    zbar_image_pool_t *pool;    /* data buffer source (or NULL) */
+};
+
+/* header of files written by zbar_image_write() */
+#define ZIMG_MAGIC 0x676d697a
+
+typedef struct zimg_hdr_s {
+    uint32_t magic, format;
+    uint16_t width, height;
+    uint32_t size;
+} zimg_hdr_t;
+
+/* idle buffers kept for each format/size */
+#define POOL_DEPTH 4
+#define POOL_BUCKETS 4
+
+typedef struct image_pool_bucket_s {
+    uint32_t format;            /* fourcc format of buffers */
+    unsigned long datalen;      /* size of buffers */
+    int nbufs;                  /* number of idle buffers */
+    void *bufs[POOL_DEPTH];     /* idle buffers */
+} image_pool_bucket_t;
+
+struct zbar_image_pool_s {
+    refcnt_t refcnt;            /* app ref + one per buffer in use */
+    zbar_mutex_t lock;          /* protects buckets */
+    int destroyed;              /* app ref released, free on return */
+    image_pool_bucket_t buckets[POOL_BUCKETS];
 };
 
 /* description of an image format */
@@ -102,6 +135,7 @@ typedef struct zbar_format_def_s {
 extern int _zbar_best_format(uint32_t, uint32_t*, const uint32_t*);
 extern const zbar_format_def_t *_zbar_format_lookup(uint32_t);
 extern void _zbar_image_free(zbar_image_t*);
+extern void *_zbar_image_pool_alloc(zbar_image_t*);
 
 #ifdef DEBUG_SVG
 extern int zbar_image_write_png(const zbar_image_t*, const char*);
@@ -137,6 +171,8 @@ static inline void _zbar_image_copy_size (zbar_image_t *dst,
     dst->crop_y = src->crop_y;
     dst->crop_w = src->crop_w;
     dst->crop_h = src->crop_h;
+    dst->frame_x = src->frame_x;
+    dst->frame_y = src->frame_y;
 }
 
 #endif
@@ -30,6 +30,7 @@
 #endif
 #include <stdlib.h>     /* malloc, free */
 #include <string.h>     /* memcmp, memset, memcpy */
+#include <limits.h>     /* INT_MAX, INT_MIN */
 #include <assert.h>
 
 #include <zbar.h>
@@ -40,6 +41,7 @@
 # include "qrcode.h"
 #endif
 #include "img_scanner.h"
+#include "scanner.h"
 #include "svg.h"
 
 #if 1
@@ -64,7 +66,24 @@
  */
 #define CACHE_TIMEOUT     (CACHE_HYSTERESIS * 2) /* ms */
 
-#define NUM_SCN_CFGS (ZBAR_CFG_Y_DENSITY - ZBAR_CFG_X_DENSITY + 1)
+/* maximum number of parts in a structured append sequence
+ */
+#define SA_MAX_PARTS      16
+
+/* multi-scale scanning: deepest reduced resolution level (1/4 size) and
+ * smallest level side worth scanning
+ */
+#define PYRAMID_MAX_LEVELS 2
+#define PYRAMID_MIN_SIZE   32
+
+/* partial hits followed down to the next finer level, and the half size
+ * of the area searched around each one (in pixels of the level where the
+ * hit was found)
+ */
+#define PYRAMID_MAX_HITS  64
+#define PYRAMID_MARGIN    128
+
+#define NUM_SCN_CFGS (ZBAR_CFG_PYRAMID - ZBAR_CFG_X_DENSITY + 1)
 
 #define CFG(iscn, cfg) ((iscn)->configs[(cfg) - ZBAR_CFG_X_DENSITY])
 #define TEST_CFG(iscn, cfg) (((iscn)->config >> ((cfg) - ZBAR_CFG_POSITION)) & 1)
@@ -83,6 +102,16 @@ typedef struct recycle_bucket_s {
     zbar_symbol_t *head;
 } recycle_bucket_t;
 
+/* structured append sequence waiting for its missing parts */
+typedef struct sa_group_s {
+    struct sa_group_s *next;
+    zbar_symbol_type_t type;    /* symbology of the parts */
+    int size;                   /* total number of parts */
+    unsigned parity;            /* sequence identification */
+    unsigned long time;         /* time a part was last seen */
+    zbar_symbol_t *parts[SA_MAX_PARTS]; /* parts decoded so far */
+} sa_group_t;
+
 /* image scanner state */
 struct zbar_image_scanner_s {
     zbar_scanner_t *scn;        /* associated linear intensity scanner */
@@ -104,6 +133,28 @@ struct zbar_image_scanner_s {
 
     int enable_cache;           /* current result cache state */
     zbar_symbol_t *cache;       /* inter-image result cache entries */
+    sa_group_t *sa_groups;      /* incomplete structured append sequences */
+
+    /* image scanned in strips */
+    zbar_image_t *strip_img;    /* describes the whole image (no data) */
+    unsigned strip_y0;          /* first row of the current strip */
+    unsigned strip_y;           /* first row not scanned yet */
+    unsigned strip_row;         /* next row to scan horizontally */
+    unsigned strip_col0;        /* first column scanned vertically */
+    unsigned strip_dcol;        /* spacing of the scanned columns */
+    unsigned strip_ncols;       /* number of columns scanned vertically */
+    unsigned strip_stride;      /* size of the saved state for a column */
+    unsigned char *strip_state; /* saved column states + the row state */
+    int strip_peek;             /* flushing columns only to find QR lines */
+
+    /* multi-scale scan */
+    int pyramid;                /* scanning reduced resolution levels */
+    int map_shift;              /* log2 downscale of the image scanned */
+    int map_x, map_y;           /* root image offset of the image scanned */
+    int frame_x, frame_y;       /* root image position in the video frame */
+    int nhits;                  /* partial hits found in the current level */
+    int hits[PYRAMID_MAX_HITS][2]; /* root image positions of the hits */
+    zbar_image_pool_t *pool;    /* data buffers of the reduced levels */
 
     /* configuration settings */
     unsigned config;            /* config flags */
@@ -327,13 +378,217 @@ static inline void cache_sym (zbar_image_scanner_t *iscn,
         sym->cache_count = 0;
 }
 
+unsigned long _zbar_image_scanner_get_time (const zbar_image_scanner_t *iscn)
+{
+    return(iscn->time);
+}
+
+int _zbar_image_scanner_cache_fresh (const zbar_image_scanner_t *iscn,
+                                     unsigned long time)
+{
+    return(iscn->enable_cache && iscn->time - time < CACHE_PROXIMITY);
+}
+
+void _zbar_image_scanner_map_point (const zbar_image_scanner_t *iscn,
+                                    int *x,
+                                    int *y)
+{
+    int scale = 1 << iscn->map_shift;
+    *x = iscn->frame_x + iscn->map_x + *x * scale + scale / 2;
+    *y = iscn->frame_y + iscn->map_y + *y * scale + scale / 2;
+}
+
+void _zbar_image_scanner_get_frame (const zbar_image_scanner_t *iscn,
+                                    int *x,
+                                    int *y)
+{
+    *x = iscn->frame_x;
+    *y = iscn->frame_y;
+}
+
+void _zbar_image_scanner_add_hit (zbar_image_scanner_t *iscn,
+                                  int x,
+                                  int y)
+{
+    int i, near = (PYRAMID_MARGIN << iscn->map_shift) / 2;
+    if(!iscn->pyramid || iscn->nhits > PYRAMID_MAX_HITS)
+        return;
+    /* windows are cut from the root image itself */
+    x -= iscn->frame_x;
+    y -= iscn->frame_y;
+    /* neighboring scan lines tend to hit the same symbol */
+    for(i = 0; i < iscn->nhits; i++)
+        if(abs(iscn->hits[i][0] - x) < near &&
+           abs(iscn->hits[i][1] - y) < near)
+            return;
+    if(iscn->nhits < PYRAMID_MAX_HITS) {
+        iscn->hits[iscn->nhits][0] = x;
+        iscn->hits[iscn->nhits][1] = y;
+    }
+    /* one too many means the hits are not worth following */
+    iscn->nhits++;
+}
+
+static inline void sa_group_free (zbar_image_scanner_t *iscn,
+                                  sa_group_t *group)
+{
+    int i;
+    for(i = 0; i < group->size; i++)
+        if(group->parts[i])
+            _zbar_image_scanner_recycle_syms(iscn, group->parts[i]);
+    free(group);
+}
+
+static inline void sa_groups_flush (zbar_image_scanner_t *iscn)
+{
+    while(iscn->sa_groups) {
+        sa_group_t *next = iscn->sa_groups->next;
+        sa_group_free(iscn, iscn->sa_groups);
+        iscn->sa_groups = next;
+    }
+}
+
+/* create a composite symbol from a complete sequence,
+ * taking over the parts
+ */
+static inline zbar_symbol_t *sa_group_merge (zbar_image_scanner_t *iscn,
+                                             sa_group_t *group)
+{
+    zbar_symbol_t *sym, **part;
+    /* cheap out w/axis aligned bbox of the parts in this image */
+    int xmin = INT_MAX, xmax = INT_MIN;
+    int ymin = INT_MAX, ymax = INT_MIN;
+    int i, j, datalen = 0;
+
+    for(i = 0; i < group->size; i++)
+        datalen += group->parts[i]->datalen;
+
+    sym = _zbar_image_scanner_alloc_sym(iscn, group->type, datalen + 1);
+    sym->configs = group->parts[0]->configs;
+    sym->modifiers = 0;
+    sym->syms = _zbar_symbol_set_create();
+    sym->syms->nsyms = group->size;
+
+    datalen = 0;
+    part = &sym->syms->head;
+    for(i = 0; i < group->size; i++) {
+        zbar_symbol_t *p = group->parts[i];
+        memcpy(sym->data + datalen, p->data, p->datalen);
+        datalen += p->datalen;
+        sym->modifiers |= p->modifiers;
+
+        if(p->time == iscn->time)
+            for(j = 0; j < p->npts; j++) {
+                int u = p->pts[j].x;
+                if(xmin > u) xmin = u;
+                if(xmax < u) xmax = u;
+                u = p->pts[j].y;
+                if(ymin > u) ymin = u;
+                if(ymax < u) ymax = u;
+            }
+
+        _zbar_symbol_refcnt(p, 1);
+        *part = sym->syms->tail = p;
+        part = &p->next;
+    }
+    *part = NULL;
+    sym->data[datalen] = '\0';
+
+    if(xmax >= xmin) {
+        sym_add_point(sym, xmin, ymin);
+        sym_add_point(sym, xmin, ymax);
+        sym_add_point(sym, xmax, ymax);
+        sym_add_point(sym, xmax, ymin);
+    }
+    return(sym);
+}
+
+zbar_symbol_t *_zbar_image_scanner_add_part (zbar_image_scanner_t *iscn,
+                                             const zbar_symbol_t *part,
+                                             int index,
+                                             int size,
+                                             unsigned parity)
+{
+    int timeout = CFG(iscn, ZBAR_CFG_SA_TIMEOUT);
+    sa_group_t **prev, *group = NULL;
+    zbar_symbol_t *sym;
+    int i;
+
+    if(timeout <= 0 || size > SA_MAX_PARTS || index < 0 || index >= size)
+        return(NULL);
+
+    /* search for matching sequence, expiring stale ones */
+    for(prev = &iscn->sa_groups; *prev; ) {
+        sa_group_t *g = *prev;
+        if(iscn->time - g->time > (unsigned long)timeout) {
+            *prev = g->next;
+            sa_group_free(iscn, g);
+            continue;
+        }
+        if(g->type == part->type && g->size == size && g->parity == parity)
+            group = g;
+        prev = &g->next;
+    }
+
+    if(!group) {
+        group = calloc(1, sizeof(sa_group_t));
+        if(!group)
+            return(NULL);
+        group->type = part->type;
+        group->size = size;
+        group->parity = parity;
+        group->next = iscn->sa_groups;
+        iscn->sa_groups = group;
+    }
+    group->time = iscn->time;
+
+    /* save a copy of the part, replacing any earlier sighting */
+    sym = _zbar_image_scanner_alloc_sym(iscn, part->type, part->datalen + 1);
+    sym->configs = part->configs;
+    sym->modifiers = part->modifiers;
+    sym->orient = part->orient;
+    memcpy(sym->data, part->data, part->datalen);
+    sym->data[part->datalen] = '\0';
+    for(i = 0; i < part->npts; i++)
+        sym_add_point(sym, part->pts[i].x, part->pts[i].y);
+
+    if(group->parts[index])
+        _zbar_image_scanner_recycle_syms(iscn, group->parts[index]);
+    group->parts[index] = sym;
+
+    for(i = 0; i < size; i++)
+        if(!group->parts[i])
+            return(NULL);
+
+    /* sequence complete */
+    for(prev = &iscn->sa_groups; *prev != group; prev = &(*prev)->next);
+    *prev = group->next;
+    sym = sa_group_merge(iscn, group);
+    free(group);
+    return(sym);
+}
+
 void _zbar_image_scanner_add_sym(zbar_image_scanner_t *iscn,
                                  zbar_symbol_t *sym)
 {
-    zbar_symbol_set_t *syms;
-    cache_sym(iscn, sym);
+    zbar_symbol_set_t *syms = iscn->syms;
 
-    syms = iscn->syms;
+    if(iscn->pyramid && sym->type == ZBAR_QRCODE) {
+        /* search areas of the finer levels may overlap a code already
+         * decoded at a coarser one
+         */
+        zbar_symbol_t *dup;
+        for(dup = syms->head; dup; dup = dup->next)
+            if(dup->type == sym->type &&
+               dup->datalen == sym->datalen &&
+               !memcmp(dup->data, sym->data, sym->datalen)) {
+                dup->quality += sym->quality;
+                _zbar_image_scanner_recycle_syms(iscn, sym);
+                return;
+            }
+    }
+
+    cache_sym(iscn, sym);
     if(sym->cache_count || !syms->tail) {
         sym->next = syms->head;
         syms->head = sym;
@@ -386,6 +641,12 @@ static inline void qr_handler (zbar_image_scanner_t *iscn)
     line->pos[vert] = u;
     line->pos[!vert] = QR_FIXED(iscn->v, 1);
 
+    if(iscn->strip_img && vert &&
+       line->pos[1] + line->len + line->eoffs <
+       (int)(iscn->strip_y0 << QR_FINDER_SUBPREC))
+        /* already reported when peeking at the end of an earlier strip */
+        return;
+
     _zbar_qr_found_line(iscn->qr, vert, line);
 }
 #endif
@@ -408,7 +669,11 @@ static void symbol_handler (zbar_decoder_t *dcode)
     assert(type != ZBAR_QRCODE);
 #endif
 
-    if(TEST_CFG(iscn, ZBAR_CFG_POSITION)) {
+    if(iscn->strip_peek)
+        /* symbols are left to the real end of the column */
+        return;
+
+    if(TEST_CFG(iscn, ZBAR_CFG_POSITION) || iscn->pyramid) {
         /* tmp position fixup */
         int w = zbar_scanner_get_width(iscn->scn);
         int u = iscn->umin + iscn->du * zbar_scanner_get_edge(iscn->scn, w, 0);
@@ -420,11 +685,13 @@ static void symbol_handler (zbar_decoder_t *dcode)
             x = iscn->v;
             y = u;
         }
+        _zbar_image_scanner_map_point(iscn, &x, &y);
     }
 
     /* FIXME debug flag to save/display all PARTIALs */
     if(type <= ZBAR_PARTIAL) {
         zprintf(256, "partial symbol @(%d,%d)\n", x, y);
+        _zbar_image_scanner_add_hit(iscn, x, y);
         return;
     }
 
@@ -483,6 +750,7 @@ zbar_image_scanner_t *zbar_image_scanner_create ()
 #ifdef ENABLE_QRCODE
     iscn->qr = _zbar_qr_create();
 #endif
+    iscn->pool = zbar_image_pool_create();
 
     /* apply default configuration */
     CFG(iscn, ZBAR_CFG_X_DENSITY) = 1;
@@ -514,10 +782,51 @@ static inline void dump_stats (const zbar_image_scanner_t *iscn)
 }
 #endif
 
+/* column states are a saved scanner followed by a saved decoder */
+#define STATE_ALIGN(n) (((n) + 15) & ~15)
+
+static inline unsigned char *strip_state (zbar_image_scanner_t *iscn,
+                                          unsigned col)
+{
+    return(iscn->strip_state + col * iscn->strip_stride);
+}
+
+static inline void strip_save (zbar_image_scanner_t *iscn,
+                               unsigned char *state)
+{
+    _zbar_scanner_save_state(iscn->scn, state);
+    _zbar_decoder_save_state(iscn->dcode, state +
+                             STATE_ALIGN(_zbar_scanner_state_size()));
+}
+
+static inline void strip_restore (zbar_image_scanner_t *iscn,
+                                  const unsigned char *state)
+{
+    _zbar_scanner_restore_state(iscn->scn, state);
+    _zbar_decoder_restore_state(iscn->dcode, state +
+                                STATE_ALIGN(_zbar_scanner_state_size()));
+}
+
+static void strips_free (zbar_image_scanner_t *iscn)
+{
+    if(iscn->strip_state) {
+        unsigned i, offs = STATE_ALIGN(_zbar_scanner_state_size());
+        for(i = 0; i <= iscn->strip_ncols; i++)
+            _zbar_decoder_free_state(strip_state(iscn, i) + offs);
+        free(iscn->strip_state);
+        iscn->strip_state = NULL;
+    }
+    if(iscn->strip_img) {
+        zbar_image_destroy(iscn->strip_img);
+        iscn->strip_img = NULL;
+    }
+}
+
 void zbar_image_scanner_destroy (zbar_image_scanner_t *iscn)
 {
     int i;
     dump_stats(iscn);
+    strips_free(iscn);
     if(iscn->syms) {
         if(iscn->syms->refcnt)
             zbar_symbol_set_ref(iscn->syms, -1);
@@ -531,6 +840,7 @@ void zbar_image_scanner_destroy (zbar_image_scanner_t *iscn)
     if(iscn->dcode)
         zbar_decoder_destroy(iscn->dcode);
     iscn->dcode = NULL;
+    sa_groups_flush(iscn);
     for(i = 0; i < RECYCLE_BUCKETS; i++) {
         zbar_symbol_t *sym, *next;
         for(sym = iscn->recycle[i].head; sym; sym = next) {
@@ -544,6 +854,10 @@ void zbar_image_scanner_destroy (zbar_image_scanner_t *iscn)
         iscn->qr = NULL;
     }
 #endif
+    if(iscn->pool) {
+        zbar_image_pool_destroy(iscn->pool);
+        iscn->pool = NULL;
+    }
     free(iscn);
 }
 
@@ -590,13 +904,21 @@ int zbar_image_scanner_set_config (zbar_image_scanner_t *iscn,
     if(sym > ZBAR_PARTIAL)
         return(1);
 
-    if(cfg >= ZBAR_CFG_X_DENSITY && cfg <= ZBAR_CFG_Y_DENSITY) {
+    if(cfg >= ZBAR_CFG_X_DENSITY && cfg <= ZBAR_CFG_PYRAMID) {
         CFG(iscn, cfg) = val;
+        if(cfg == ZBAR_CFG_SA_TIMEOUT && val <= 0)
+            sa_groups_flush(iscn);
         return(0);
     }
 
-    if(cfg > ZBAR_CFG_POSITION)
+    if(cfg > ZBAR_CFG_TRACKING)
         return(1);
+
+#ifdef ENABLE_QRCODE
+    if(cfg == ZBAR_CFG_TRACKING && (val == 0 || val == 1))
+        _zbar_qr_set_tracking(iscn->qr, val);
+#endif
+
     cfg -= ZBAR_CFG_POSITION;
 
     if(!val)
@@ -635,59 +957,112 @@ static inline void quiet_border (zbar_image_scanner_t *iscn)
     zbar_scanner_new_scan(scn);
 }
 
+static void filter_results (zbar_image_scanner_t *iscn)
+{
+    zbar_symbol_set_t *syms = iscn->syms;
+    int density = CFG(iscn, ZBAR_CFG_X_DENSITY);
+
+    /* FIXME tmp hack to filter bad EAN results */
+    /* FIXME tmp hack to merge simple case EAN add-ons */
+    char filter = (!iscn->enable_cache &&
+                   (density == 1 || CFG(iscn, ZBAR_CFG_Y_DENSITY) == 1));
+    int nean = 0, naddon = 0;
+    if(syms->nsyms) {
+        zbar_symbol_t **symp;
+        for(symp = &syms->head; *symp; ) {
+            zbar_symbol_t *sym = *symp;
+            if(sym->cache_count <= 0 &&
+               (sym->type < ZBAR_COMPOSITE && sym->type > ZBAR_PARTIAL) ||
+	       (sym->type == ZBAR_DATABAR || sym->type == ZBAR_DATABAR_EXP)) {
+	        if(filter && sym->quality < 4) {
+                    if(iscn->enable_cache) {
+                        /* revert cache update */
+                        zbar_symbol_t *entry = cache_lookup(iscn, sym);
+                        if(entry)
+                            entry->cache_count--;
+                        else
+                            assert(0);
+                    }
+
+                    /* recycle */
+                    *symp = sym->next;
+                    syms->nsyms--;
+                    sym->next = NULL;
+                    _zbar_image_scanner_recycle_syms(iscn, sym);
+                    continue;
+                }
+                else if(sym->type < ZBAR_COMPOSITE &&
+                        sym->type != ZBAR_ISBN10)
+                {
+                    if(sym->type > ZBAR_EAN5)
+                        nean++;
+                    else
+                        naddon++;
+                }
+            }
+            symp = &sym->next;
+        }
+
+        if(nean == 1 && naddon == 1 && iscn->ean_config) {
+            /* create container symbol for composite result */
+            zbar_symbol_t *ean = NULL, *addon = NULL;
+            for(symp = &syms->head; *symp; ) {
+                zbar_symbol_t *sym = *symp;
+                if(sym->type < ZBAR_COMPOSITE && sym->type > ZBAR_PARTIAL) {
+                    /* move to composite */
+                    *symp = sym->next;
+                    syms->nsyms--;
+                    sym->next = NULL;
+                    if(sym->type <= ZBAR_EAN5)
+                        addon = sym;
+                    else
+                        ean = sym;
+                }
+                else
+                    symp = &sym->next;
+            }
+            assert(ean);
+            assert(addon);
+
+            int datalen = ean->datalen + addon->datalen + 1;
+            zbar_symbol_t *ean_sym =
+                _zbar_image_scanner_alloc_sym(iscn, ZBAR_COMPOSITE, datalen);
+            ean_sym->orient = ean->orient;
+            ean_sym->syms = _zbar_symbol_set_create();
+            memcpy(ean_sym->data, ean->data, ean->datalen);
+            memcpy(ean_sym->data + ean->datalen,
+                   addon->data, addon->datalen + 1);
+            ean_sym->syms->head = ean;
+            ean->next = addon;
+            ean_sym->syms->nsyms = 2;
+            _zbar_image_scanner_add_sym(iscn, ean_sym);
+        }
+    }
+}
+
 #define movedelta(dx, dy) do {                  \
         x += (dx);                              \
         y += (dy);                              \
         p += (dx) + ((uintptr_t)(dy) * w);       \
     } while(0);
 
-int zbar_scan_image (zbar_image_scanner_t *iscn,
-                     zbar_image_t *img)
+/* scan the rows and columns of the image crop, then search for QR Codes */
+static void scan_lines (zbar_image_scanner_t *iscn,
+                        zbar_image_t *img)
 {
-    zbar_symbol_set_t *syms;
-    const uint8_t *data;
     zbar_scanner_t *scn = iscn->scn;
-    unsigned w, h, cx1, cy1;
+    const uint8_t *data = img->data;
+    unsigned w = img->width, h = img->height, cx1, cy1;
     int density;
 
-    /* timestamp image
-     * FIXME prefer video timestamp
-     */
-    iscn->time = _zbar_timer_now();
-
-#ifdef ENABLE_QRCODE
-    _zbar_qr_reset(iscn->qr);
-#endif
-
-    /* image must be in grayscale format */
-    if(img->format != fourcc('Y','8','0','0') &&
-       img->format != fourcc('G','R','E','Y'))
-        return(-1);
-    iscn->img = img;
-
-    /* recycle previous scanner and image results */
-    zbar_image_scanner_recycle_image(iscn, img);
-    syms = iscn->syms;
-    if(!syms) {
-        syms = iscn->syms = _zbar_symbol_set_create();
-        STAT(syms_new);
-        zbar_symbol_set_ref(syms, 1);
-    }
-    else
-        zbar_symbol_set_ref(syms, 2);
-    img->syms = syms;
-
-    w = img->width;
-    h = img->height;
     cx1 = img->crop_x + img->crop_w;
     assert(cx1 <= w);
     cy1 = img->crop_y + img->crop_h;
     assert(cy1 <= h);
-    data = img->data;
 
-    zbar_image_write_png(img, "debug.png");
-    svg_open("debug.svg", 0, 0, w, h);
-    svg_image("debug.png", w, h);
+#ifdef ENABLE_QRCODE
+    _zbar_qr_reset(iscn->qr);
+#endif
 
     zbar_scanner_new_scan(scn);
 
@@ -800,88 +1175,244 @@ int zbar_scan_image (zbar_image_scanner_t *iscn,
         svg_group_end();
     }
     iscn->dy = 0;
-    iscn->img = NULL;
 
 #ifdef ENABLE_QRCODE
     _zbar_qr_decode(iscn->qr, iscn, img);
 #endif
+}
 
-    /* FIXME tmp hack to filter bad EAN results */
-    /* FIXME tmp hack to merge simple case EAN add-ons */
-    char filter = (!iscn->enable_cache &&
-                   (density == 1 || CFG(iscn, ZBAR_CFG_Y_DENSITY) == 1));
-    int nean = 0, naddon = 0;
-    if(syms->nsyms) {
-        zbar_symbol_t **symp;
-        for(symp = &syms->head; *symp; ) {
-            zbar_symbol_t *sym = *symp;
-            if(sym->cache_count <= 0 &&
-               (sym->type < ZBAR_COMPOSITE && sym->type > ZBAR_PARTIAL) ||
-	       (sym->type == ZBAR_DATABAR || sym->type == ZBAR_DATABAR_EXP)) {
-	        if(filter && sym->quality < 4) {
-                    if(iscn->enable_cache) {
-                        /* revert cache update */
-                        zbar_symbol_t *entry = cache_lookup(iscn, sym);
-                        if(entry)
-                            entry->cache_count--;
-                        else
-                            assert(0);
-                    }
+/* scan an image (or part of a reduced level of it) whose pixels map to
+ * root image pixels scaled by 2^level and offset by (x, y)
+ */
+static void scan_level (zbar_image_scanner_t *iscn,
+                        zbar_image_t *img,
+                        int level,
+                        int x,
+                        int y)
+{
+    iscn->map_shift = level;
+    iscn->map_x = x;
+    iscn->map_y = y;
+#ifdef ENABLE_QRCODE
+    /* codes remembered from other levels are at other scales */
+    _zbar_qr_forget(iscn->qr);
+#endif
+    scan_lines(iscn, img);
+}
 
-                    /* recycle */
-                    *symp = sym->next;
-                    syms->nsyms--;
-                    sym->next = NULL;
-                    _zbar_image_scanner_recycle_syms(iscn, sym);
-                    continue;
-                }
-                else if(sym->type < ZBAR_COMPOSITE &&
-                        sym->type != ZBAR_ISBN10)
-                {
-                    if(sym->type > ZBAR_EAN5)
-                        nean++;
-                    else
-                        naddon++;
+/* scan the area [x0, x1) x [y0, y1) of a level */
+static void scan_window (zbar_image_scanner_t *iscn,
+                         zbar_image_t *img,
+                         int level,
+                         int ox,
+                         int oy,
+                         const int *win)
+{
+    unsigned cx = img->crop_x, cy = img->crop_y;
+    unsigned cw = img->crop_w, ch = img->crop_h;
+    zbar_image_t *sub;
+
+    zbar_image_set_crop(img, win[0], win[1], win[2] - win[0], win[3] - win[1]);
+    sub = zbar_image_convert_scaled(img, fourcc('Y','8','0','0'), 1);
+    zbar_image_set_crop(img, cx, cy, cw, ch);
+    if(!sub)
+        return;
+    zprintf(64, "level %d window %d,%d %dx%d\n", level, win[0], win[1],
+            win[2] - win[0], win[3] - win[1]);
+    scan_level(iscn, sub, level, ox + (win[0] << level),
+               oy + (win[1] << level));
+    zbar_image_destroy(sub);
+}
+
+/* areas of a level around the hits found one level up, merged where they
+ * overlap.  returns 0 when the areas cover too much of the level to be
+ * worth scanning separately
+ */
+static int pyramid_windows (const zbar_image_scanner_t *iscn,
+                            const zbar_image_t *img,
+                            int level,
+                            int ox,
+                            int oy,
+                            int win[][4])
+{
+    int x0 = img->crop_x, x1 = x0 + img->crop_w;
+    int y0 = img->crop_y, y1 = y0 + img->crop_h;
+    int m = PYRAMID_MARGIN * 2, n, i, j, merged;
+    unsigned long area = 0;
+
+    for(n = 0; n < iscn->nhits; n++) {
+        int x = (iscn->hits[n][0] - ox) >> level;
+        int y = (iscn->hits[n][1] - oy) >> level;
+        win[n][0] = (x - m > x0) ? x - m : x0;
+        win[n][1] = (y - m > y0) ? y - m : y0;
+        win[n][2] = (x + m < x1) ? x + m : x1;
+        win[n][3] = (y + m < y1) ? y + m : y1;
+    }
+
+    do {
+        merged = 0;
+        for(i = 0; i < n; i++)
+            for(j = i + 1; j < n; j++)
+                if(win[i][0] <= win[j][2] && win[j][0] <= win[i][2] &&
+                   win[i][1] <= win[j][3] && win[j][1] <= win[i][3]) {
+                    if(win[i][0] > win[j][0]) win[i][0] = win[j][0];
+                    if(win[i][1] > win[j][1]) win[i][1] = win[j][1];
+                    if(win[i][2] < win[j][2]) win[i][2] = win[j][2];
+                    if(win[i][3] < win[j][3]) win[i][3] = win[j][3];
+                    memcpy(win[j], win[--n], sizeof(win[j]));
+                    merged = 1;
+                    j = i;
                 }
+    } while(merged);
+
+    for(i = 0; i < n; i++)
+        area += (unsigned long)(win[i][2] - win[i][0]) *
+            (win[i][3] - win[i][1]);
+    if(area * 2 > (unsigned long)img->crop_w * img->crop_h)
+        return(0);
+    return(n);
+}
+
+/* drop the hits explained by a symbol decoded at the current level */
+static void prune_hits (zbar_image_scanner_t *iscn,
+                        int level)
+{
+    int m = (PYRAMID_MARGIN << level) / 4, i;
+    if(iscn->nhits > PYRAMID_MAX_HITS)
+        return;
+    for(i = 0; i < iscn->nhits; ) {
+        int x = iscn->hits[i][0], y = iscn->hits[i][1];
+        const zbar_symbol_t *sym;
+        for(sym = iscn->syms->head; sym; sym = sym->next) {
+            int xmin = INT_MAX, xmax = INT_MIN, ymin = INT_MAX, ymax = INT_MIN;
+            unsigned j;
+            for(j = 0; j < sym->npts; j++) {
+                if(xmin > sym->pts[j].x) xmin = sym->pts[j].x;
+                if(xmax < sym->pts[j].x) xmax = sym->pts[j].x;
+                if(ymin > sym->pts[j].y) ymin = sym->pts[j].y;
+                if(ymax < sym->pts[j].y) ymax = sym->pts[j].y;
             }
-            symp = &sym->next;
+            if(sym->npts &&
+               x >= xmin - m && x <= xmax + m &&
+               y >= ymin - m && y <= ymax + m)
+                break;
         }
+        if(sym) {
+            iscn->nhits--;
+            iscn->hits[i][0] = iscn->hits[iscn->nhits][0];
+            iscn->hits[i][1] = iscn->hits[iscn->nhits][1];
+        }
+        else
+            i++;
+    }
+}
 
-        if(nean == 1 && naddon == 1 && iscn->ean_config) {
-            /* create container symbol for composite result */
-            zbar_symbol_t *ean = NULL, *addon = NULL;
-            for(symp = &syms->head; *symp; ) {
-                zbar_symbol_t *sym = *symp;
-                if(sym->type < ZBAR_COMPOSITE && sym->type > ZBAR_PARTIAL) {
-                    /* move to composite */
-                    *symp = sym->next;
-                    syms->nsyms--;
-                    sym->next = NULL;
-                    if(sym->type <= ZBAR_EAN5)
-                        addon = sym;
-                    else
-                        ean = sym;
-                }
-                else
-                    symp = &sym->next;
-            }
-            assert(ean);
-            assert(addon);
+/* multi-scale scan: the coarsest level is scanned whole, then each finer
+ * level only around the partial hits of the level above it, unless
+ * nothing has been decoded yet
+ */
+static void scan_pyramid (zbar_image_scanner_t *iscn,
+                          zbar_image_t *img,
+                          int nlevels)
+{
+    zbar_image_t *levels[PYRAMID_MAX_LEVELS + 1];
+    int win[PYRAMID_MAX_HITS][4];
+    int top, level;
+
+    if(nlevels > PYRAMID_MAX_LEVELS)
+        nlevels = PYRAMID_MAX_LEVELS;
+    levels[0] = img;
+    for(top = 0; top < nlevels; top++) {
+        unsigned scale = 2 << top;
+        if(img->crop_w / scale < PYRAMID_MIN_SIZE ||
+           img->crop_h / scale < PYRAMID_MIN_SIZE)
+            break;
+        /* reduced levels hold just the crop, and are the same size
+         * from one video frame to the next
+         */
+        levels[top + 1] =
+            zbar_image_pool_convert_scaled(iscn->pool, img,
+                                           fourcc('Y','8','0','0'), scale);
+        if(!levels[top + 1])
+            break;
+    }
 
-            int datalen = ean->datalen + addon->datalen + 1;
-            zbar_symbol_t *ean_sym =
-                _zbar_image_scanner_alloc_sym(iscn, ZBAR_COMPOSITE, datalen);
-            ean_sym->orient = ean->orient;
-            ean_sym->syms = _zbar_symbol_set_create();
-            memcpy(ean_sym->data, ean->data, ean->datalen);
-            memcpy(ean_sym->data + ean->datalen,
-                   addon->data, addon->datalen + 1);
-            ean_sym->syms->head = ean;
-            ean->next = addon;
-            ean_sym->syms->nsyms = 2;
-            _zbar_image_scanner_add_sym(iscn, ean_sym);
+    iscn->pyramid = 1;
+    iscn->nhits = 0;
+    for(level = top; level >= 0; level--) {
+        zbar_image_t *lvl = levels[level];
+        int ox = (level) ? img->crop_x : 0;
+        int oy = (level) ? img->crop_y : 0;
+        int nwin = 0, i;
+
+        if(level < top && iscn->syms->nsyms) {
+            if(!iscn->nhits)
+                break;
+            if(iscn->nhits <= PYRAMID_MAX_HITS)
+                nwin = pyramid_windows(iscn, lvl, level, ox, oy, win);
         }
+        zprintf(32, "level %d: %d hits, %d windows\n",
+                level, iscn->nhits, nwin);
+
+        iscn->nhits = 0;
+        if(!nwin)
+            scan_level(iscn, lvl, level, ox, oy);
+        else
+            for(i = 0; i < nwin; i++)
+                scan_window(iscn, lvl, level, ox, oy, win[i]);
+        prune_hits(iscn, level);
+    }
+    iscn->pyramid = 0;
+    iscn->map_shift = iscn->map_x = iscn->map_y = 0;
+#ifdef ENABLE_QRCODE
+    _zbar_qr_forget(iscn->qr);
+#endif
+
+    for(level = 1; level <= top; level++)
+        zbar_image_destroy(levels[level]);
+}
+
+int zbar_scan_image (zbar_image_scanner_t *iscn,
+                     zbar_image_t *img)
+{
+    zbar_symbol_set_t *syms;
+
+    /* timestamp image, preferring the capture time */
+    iscn->time = (img->time) ? img->time : _zbar_timer_now();
+
+    /* image must be in grayscale format */
+    if(img->format != fourcc('Y','8','0','0') &&
+       img->format != fourcc('G','R','E','Y'))
+        return(-1);
+    iscn->img = img;
+    /* report locations in the full frame of a region of interest */
+    iscn->frame_x = img->frame_x;
+    iscn->frame_y = img->frame_y;
+
+    /* recycle previous scanner and image results */
+    zbar_image_scanner_recycle_image(iscn, img);
+    syms = iscn->syms;
+    if(!syms) {
+        syms = iscn->syms = _zbar_symbol_set_create();
+        STAT(syms_new);
+        zbar_symbol_set_ref(syms, 1);
     }
+    else
+        zbar_symbol_set_ref(syms, 2);
+    img->syms = syms;
+
+    zbar_image_write_png(img, "debug.png");
+    svg_open("debug.svg", 0, 0, img->width, img->height);
+    svg_image("debug.png", img->width, img->height);
+
+    if(CFG(iscn, ZBAR_CFG_PYRAMID) > 0)
+        scan_pyramid(iscn, img, CFG(iscn, ZBAR_CFG_PYRAMID));
+    else
+        scan_lines(iscn, img);
+    iscn->img = NULL;
+    iscn->frame_x = iscn->frame_y = 0;
+
+    filter_results(iscn);
 
     if(syms->nsyms && iscn->handler)
         iscn->handler(img, iscn->userdata);
@@ -890,6 +1421,215 @@ int zbar_scan_image (zbar_image_scanner_t *iscn,
     return(syms->nsyms);
 }
 
+int zbar_image_scanner_begin_strips (zbar_image_scanner_t *iscn,
+                                     unsigned width,
+                                     unsigned height)
+{
+    zbar_symbol_set_t *syms;
+    unsigned i, border;
+    int density;
+
+    strips_free(iscn);
+    if(!width || !height)
+        return(-1);
+
+    iscn->time = _zbar_timer_now();
+
+#ifdef ENABLE_QRCODE
+    _zbar_qr_reset(iscn->qr);
+#endif
+
+    /* recycle previous scanner results */
+    syms = iscn->syms;
+    if(syms && syms->refcnt) {
+        if(recycle_syms(iscn, syms)) {
+            STAT(iscn_syms_inuse);
+            iscn->syms = syms = NULL;
+        }
+        else
+            STAT(iscn_syms_recycle);
+    }
+    if(!syms) {
+        syms = iscn->syms = _zbar_symbol_set_create();
+        STAT(syms_new);
+    }
+    zbar_symbol_set_ref(syms, 1);
+
+    iscn->strip_img = zbar_image_create();
+    if(!iscn->strip_img)
+        return(-1);
+    zbar_image_set_format(iscn->strip_img, fourcc('Y','8','0','0'));
+    zbar_image_set_size(iscn->strip_img, width, height);
+    iscn->strip_y = 0;
+
+    /* same sampling as zbar_scan_image() */
+    density = CFG(iscn, ZBAR_CFG_Y_DENSITY);
+    if(density > 0) {
+        border = (((height - 1) % density) + 1) / 2;
+        if(border > height / 2)
+            border = height / 2;
+        iscn->strip_row = border;
+    }
+    else
+        iscn->strip_row = height;
+
+    density = CFG(iscn, ZBAR_CFG_X_DENSITY);
+    iscn->strip_col0 = iscn->strip_ncols = 0;
+    iscn->strip_dcol = 1;
+    if(density > 0) {
+        border = (((width - 1) % density) + 1) / 2;
+        if(border > width / 2)
+            border = width / 2;
+        iscn->strip_col0 = border;
+        iscn->strip_dcol = density;
+        iscn->strip_ncols = (width - border + density - 1) / density;
+    }
+
+    /* one saved state per column, plus one for the rows */
+    iscn->strip_stride = (STATE_ALIGN(_zbar_scanner_state_size()) +
+                          STATE_ALIGN(_zbar_decoder_state_size()));
+    iscn->strip_state = calloc(iscn->strip_ncols + 1, iscn->strip_stride);
+    if(!iscn->strip_state) {
+        strips_free(iscn);
+        return(-1);
+    }
+    /* nothing held over from previous images */
+    zbar_scanner_reset(iscn->scn);
+    for(i = 0; i <= iscn->strip_ncols; i++)
+        strip_save(iscn, strip_state(iscn, i));
+    return(0);
+}
+
+/* end the scan of each column at the last row received */
+static inline void strips_flush (zbar_image_scanner_t *iscn)
+{
+    unsigned i;
+    iscn->dx = 0;
+    iscn->dy = iscn->du = 1;
+    iscn->umin = 0;
+    for(i = 0; i < iscn->strip_ncols; i++) {
+        unsigned char *state = strip_state(iscn, i);
+        strip_restore(iscn, state);
+        iscn->v = iscn->strip_col0 + i * iscn->strip_dcol;
+        quiet_border(iscn);
+        strip_save(iscn, state);
+    }
+}
+
+int zbar_scan_strip (zbar_image_scanner_t *iscn,
+                     const void *data,
+                     unsigned y,
+                     unsigned rows)
+{
+    zbar_image_t *img = iscn->strip_img;
+    zbar_scanner_t *scn = iscn->scn;
+    const uint8_t *strip = data;
+    unsigned w, y1, x, i;
+    int density;
+
+    if(!img || !data || y > iscn->strip_y || rows > img->height - y)
+        return(-1);
+    y1 = y + rows;
+    if(y1 <= iscn->strip_y)
+        /* nothing new */
+        return(iscn->syms->nsyms);
+    w = img->width;
+    iscn->strip_y0 = y;
+
+#ifdef ENABLE_QRCODE
+    _zbar_qr_trim_lines(iscn->qr, y);
+#endif
+
+    /* rows are scanned as usual, alternating direction */
+    strip_restore(iscn, strip_state(iscn, iscn->strip_ncols));
+    density = CFG(iscn, ZBAR_CFG_Y_DENSITY);
+    iscn->dy = 0;
+    for(; density > 0 && iscn->strip_row < y1;
+        iscn->strip_row += density) {
+        const uint8_t *p = strip + (iscn->strip_row - y) * (uintptr_t)w;
+        zprintf(128, "strip_x: %04d\n", iscn->strip_row);
+        iscn->v = iscn->strip_row;
+        if(!((iscn->strip_row / density) & 1)) {
+            iscn->dx = iscn->du = 1;
+            iscn->umin = 0;
+            for(x = 0; x < w; x++)
+                zbar_scan_y(scn, p[x]);
+        }
+        else {
+            iscn->dx = iscn->du = -1;
+            iscn->umin = w;
+            for(x = w; x > 0; )
+                zbar_scan_y(scn, p[--x]);
+        }
+        quiet_border(iscn);
+    }
+    strip_save(iscn, strip_state(iscn, iscn->strip_ncols));
+
+    /* each column picks up from the end of the previous strip */
+    iscn->dx = 0;
+    iscn->dy = iscn->du = 1;
+    iscn->umin = 0;
+    for(i = 0; i < iscn->strip_ncols; i++) {
+        unsigned char *state = strip_state(iscn, i);
+        const uint8_t *p;
+        unsigned v;
+        x = iscn->strip_col0 + i * iscn->strip_dcol;
+        p = strip + (iscn->strip_y - y) * (uintptr_t)w + x;
+        strip_restore(iscn, state);
+        iscn->v = x;
+        for(v = iscn->strip_y; v < y1; v++, p += w)
+            zbar_scan_y(scn, *p);
+        strip_save(iscn, state);
+    }
+    iscn->strip_y = y1;
+    if(y1 == img->height)
+        strips_flush(iscn);
+#ifdef ENABLE_QRCODE
+    else {
+        /* a finder pattern at the end of a strip is only reported once
+         * the next edge is seen, which may be too late to search for
+         * its code.  peek at what flushing each column would find
+         */
+        iscn->strip_peek = 1;
+        for(i = 0; i < iscn->strip_ncols; i++) {
+            const unsigned char *state = strip_state(iscn, i);
+            strip_restore(iscn, state);
+            iscn->v = iscn->strip_col0 + i * iscn->strip_dcol;
+            quiet_border(iscn);
+        }
+        iscn->strip_peek = 0;
+    }
+#endif
+    iscn->dy = 0;
+
+    /* leave the (quiet) row scan for anything else using the scanner */
+    strip_restore(iscn, strip_state(iscn, iscn->strip_ncols));
+
+#ifdef ENABLE_QRCODE
+    if(_zbar_qr_decode_strip(iscn->qr, iscn, img, strip, y, rows) < 0)
+        /* out of memory searching the strip for codes */
+        return(-1);
+#endif
+
+    return(iscn->syms->nsyms);
+}
+
+int zbar_image_scanner_end_strips (zbar_image_scanner_t *iscn)
+{
+    if(!iscn->strip_img)
+        return(-1);
+    if(iscn->strip_y < iscn->strip_img->height) {
+        /* image was cut short */
+        strips_flush(iscn);
+        iscn->dy = 0;
+        strip_restore(iscn, strip_state(iscn, iscn->strip_ncols));
+    }
+    strips_free(iscn);
+
+    filter_results(iscn);
+    return(iscn->syms->nsyms);
+}
+
 #ifdef DEBUG_SVG
 /* FIXME lame...*/
 # include "svg.c"
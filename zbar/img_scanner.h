@@ -35,4 +35,37 @@ extern void _zbar_image_scanner_add_sym(zbar_image_scanner_t*,
 extern void _zbar_image_scanner_recycle_syms(zbar_image_scanner_t*,
                                              zbar_symbol_t*);
 
+/* scan time of the current image */
+extern unsigned long _zbar_image_scanner_get_time(const zbar_image_scanner_t*);
+
+/* whether results decoded at the given time are still current enough
+ * to be reported again for the image being scanned
+ */
+extern int _zbar_image_scanner_cache_fresh(const zbar_image_scanner_t*,
+                                           unsigned long);
+
+/* hold a copy of one part of a structured append sequence across images.
+ * returns the composite symbol (not yet added) once all parts are seen
+ */
+extern zbar_symbol_t *_zbar_image_scanner_add_part(zbar_image_scanner_t*,
+                                                   const zbar_symbol_t*,
+                                                   int, int, unsigned);
+
+/* map a pixel of the image being scanned, which may be a reduced level
+ * of the root image, to the root image
+ */
+extern void _zbar_image_scanner_map_point(const zbar_image_scanner_t*,
+                                          int*, int*);
+
+/* position of the root image in the full video frame, which mapped
+ * points include (non-zero only for a capture region of interest)
+ */
+extern void _zbar_image_scanner_get_frame(const zbar_image_scanner_t*,
+                                          int*, int*);
+
+/* note a (root image) position where a symbol was seen but not decoded,
+ * to be searched again at a finer level of a multi-scale scan
+ */
+extern void _zbar_image_scanner_add_hit(zbar_image_scanner_t*, int, int);
+
 #endif
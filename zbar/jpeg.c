@@ -143,11 +143,21 @@ void _zbar_jpeg_decomp_destroy (struct jpeg_decompress_struct *cinfo)
     free(cinfo);
 }
 
-/* invoke libjpeg to decompress JPEG format to luminance plane */
-void _zbar_convert_jpeg_to_y (zbar_image_t *dst,
-                              const zbar_format_def_t *dstfmt,
-                              const zbar_image_t *src,
-                              const zbar_format_def_t *srcfmt)
+/* maximum scanlines requested from libjpeg per call */
+#define JPEG_MAX_LINES 16
+
+/* decompress the luminance plane of src into dst, scaled by 1/denom.
+ * the region x,y,w,h (in scaled coordinates) limits which scanlines
+ * are decoded (and columns, where libjpeg supports cropping).
+ * returns the offset of the first decoded row and column in x,y
+ */
+static void jpeg_decompress_y (zbar_image_t *dst,
+                               const zbar_image_t *src,
+                               unsigned denom,
+                               unsigned *x,
+                               unsigned *y,
+                               unsigned w,
+                               unsigned h)
 {
     /* create decompressor, or use cached video stream decompressor */
     errenv_t *jerr = NULL;
@@ -166,6 +176,7 @@ void _zbar_convert_jpeg_to_y (zbar_image_t *dst,
     if(setjmp(jerr->env)) {
         /* FIXME TBD save error to src->src->err */
         (*cinfo->err->output_message)((j_common_ptr)cinfo);
+        jpeg_abort_decompress(cinfo);
         if(dst->data) {
             free((void*)dst->data);
             dst->data = NULL;
@@ -195,49 +206,94 @@ void _zbar_convert_jpeg_to_y (zbar_image_t *dst,
      */
     cinfo->out_color_space = JCS_GRAYSCALE;
 
-    /* FIXME set scaling based on dst->{width,height}
-     * then pass bigger buffer...
-     */
+    /* reduced size output is (much) cheaper to get from the IDCT */
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = denom;
 
     jpeg_start_decompress(cinfo);
 
+    /* clip region to the actual output */
+    unsigned x0 = 0, y0 = 0, y1;
+    if(*x > cinfo->output_width)
+        *x = cinfo->output_width;
+    if(w > cinfo->output_width - *x)
+        w = cinfo->output_width - *x;
+    if(*y > cinfo->output_height)
+        *y = cinfo->output_height;
+    if(h > cinfo->output_height - *y)
+        h = cinfo->output_height - *y;
+    y1 = *y + h;
+
+#ifdef HAVE_JPEG_CROP_SCANLINE
+    if(w && w < cinfo->output_width) {
+        /* NB libjpeg rounds out to an iMCU boundary */
+        JDIMENSION xoff = *x, xw = w;
+        jpeg_crop_scanline(cinfo, &xoff, &xw);
+        x0 = xoff;
+    }
+#endif
+
+#ifdef HAVE_JPEG_SKIP_SCANLINES
+    /* skip before sizing the output: only rows y0..y1 are stored */
+    if(*y)
+        y0 = jpeg_skip_scanlines(cinfo, *y);
+#endif
+
     /* adjust dst image parameters to match(?) decompressor */
     if(dst->width < cinfo->output_width) {
         dst->width = cinfo->output_width;
         if(dst->crop_x + dst->crop_w > dst->width)
             dst->crop_w = dst->width - dst->crop_x;
     }
-    if(dst->height < cinfo->output_height) {
-        dst->height = cinfo->output_height;
+    if(dst->height < y1 - y0) {
+        dst->height = y1 - y0;
         if(dst->crop_y + dst->crop_h > dst->height)
             dst->crop_h = dst->height - dst->crop_y;
     }
     unsigned long datalen = (cinfo->output_width *
-                             cinfo->output_height *
+                             (y1 - y0) *
                              cinfo->out_color_components);
 
-    zprintf(24, "dst=%dx%d %lx src=%dx%d %lx dct=%x\n",
+    zprintf(24, "dst=%dx%d %lx src=%dx%d %lx dct=%x scale=1/%d\n",
             dst->width, dst->height, dst->datalen,
-            src->width, src->height, src->datalen, cinfo->dct_method);
+            src->width, src->height, src->datalen, cinfo->dct_method,
+            denom);
     if(!dst->data) {
         dst->datalen = datalen;
-        dst->data = malloc(dst->datalen);
         dst->cleanup = zbar_image_free_data;
+        dst->data = _zbar_image_pool_alloc(dst);
     }
     else
         assert(datalen <= dst->datalen);
-    if(!dst->data) return;
+    if(!dst->data) {
+        jpeg_abort_decompress(cinfo);
+        goto error;
+    }
 
     unsigned bpl = dst->width * cinfo->output_components;
     JSAMPROW buf = (void*)dst->data;
-    JSAMPARRAY line = &buf;
-    for(; cinfo->output_scanline < cinfo->output_height; buf += bpl) {
-        jpeg_read_scanlines(cinfo, line, 1);
+    JSAMPROW lines[JPEG_MAX_LINES];
+    while(cinfo->output_scanline < y1) {
+        unsigned i, n = y1 - cinfo->output_scanline;
+        if(n > JPEG_MAX_LINES)
+            n = JPEG_MAX_LINES;
+        for(i = 0; i < n; i++)
+            lines[i] = buf + i * bpl;
+        n = jpeg_read_scanlines(cinfo, lines, n);
+        if(!n)
+            break;
+        buf += n * bpl;
         /* FIXME pad out to dst->width */
     }
 
-    /* FIXME always do this? */
-    jpeg_finish_decompress(cinfo);
+    if(cinfo->output_scanline < cinfo->output_height)
+        /* stopped early: discard the rest */
+        jpeg_abort_decompress(cinfo);
+    else
+        jpeg_finish_decompress(cinfo);
+
+    *x = x0;
+    *y = y0;
 
  error:
     if(jerr)
@@ -246,3 +302,57 @@ void _zbar_convert_jpeg_to_y (zbar_image_t *dst,
         /* cleanup only if we allocated locally */
         _zbar_jpeg_decomp_destroy(cinfo);
 }
+
+/* invoke libjpeg to decompress JPEG format to luminance plane */
+void _zbar_convert_jpeg_to_y (zbar_image_t *dst,
+                              const zbar_format_def_t *dstfmt,
+                              const zbar_image_t *src,
+                              const zbar_format_def_t *srcfmt)
+{
+    /* when a reduced size is requested, let the decoder scale down
+     * (by up to 1/8) as far as it can without going below that size
+     */
+    unsigned denom = 1, x = 0, y = 0;
+    while(denom < 8 && dst->width && dst->height &&
+          (src->width + denom * 2 - 1) / (denom * 2) >= dst->width &&
+          (src->height + denom * 2 - 1) / (denom * 2) >= dst->height)
+        denom *= 2;
+    if(denom > 1) {
+        dst->crop_x /= denom;
+        dst->crop_y /= denom;
+        dst->crop_w /= denom;
+        dst->crop_h /= denom;
+    }
+
+    jpeg_decompress_y(dst, src, denom, &x, &y, -1, -1);
+}
+
+/* decompress the crop rectangle of a JPEG image, scaled by 1/denom,
+ * to a new Y800 image w/data from pool (if any).  only the scanlines
+ * (and columns, where supported by libjpeg) that cover the crop are
+ * decoded; the crop rectangle of the result is set to the scaled
+ * source crop
+ */
+zbar_image_t *_zbar_jpeg_decode_crop (zbar_image_pool_t *pool,
+                                      const zbar_image_t *src,
+                                      unsigned denom)
+{
+    unsigned x = src->crop_x / denom, y = src->crop_y / denom;
+    unsigned w = src->crop_w / denom, h = src->crop_h / denom;
+    unsigned x0 = x, y0 = y;
+
+    zbar_image_t *dst = zbar_image_create();
+    dst->format = fourcc('Y','8','0','0');
+    dst->cleanup = zbar_image_free_data;
+    dst->pool = pool;
+    dst->time = src->time;
+    jpeg_decompress_y(dst, src, denom, &x0, &y0, w, h);
+    if(!dst->data || x < x0 || y < y0) {
+        zbar_image_destroy(dst);
+        return(NULL);
+    }
+
+    /* decoded image starts at column x0, row y0 of the scaled source */
+    zbar_image_set_crop(dst, x - x0, y - y0, w, h);
+    return(dst);
+}
@@ -0,0 +1,404 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+#include "image.h"
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#include <string.h>
+#include <limits.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <stdint.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+
+/* image files whose sample data is stored uncompressed and contiguous
+ * are mapped directly: the image data points into the mapping, which
+ * is released by the cleanup handler
+ */
+
+/* bytes of the file examined to parse text headers */
+#define HDR_SIZE 512
+
+/* location of the mapped sample data in the file */
+typedef struct mapped_info_s {
+    uint32_t format;
+    unsigned width, height;
+    off_t offset;
+    unsigned long datalen;
+} mapped_info_t;
+
+static void mapped_cleanup (zbar_image_t *img)
+{
+    /* mapping starts at the page containing the data */
+    uintptr_t data = (uintptr_t)img->data;
+    uintptr_t base = data & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+    munmap((void*)base, img->datalen + (data - base));
+    img->data = NULL;
+}
+
+/* parse an unsigned decimal number, advancing *p */
+static int parse_uint (const char **p,
+                       const char *end,
+                       unsigned *val)
+{
+    const char *s = *p;
+    unsigned v = 0;
+    if(s >= end || *s < '0' || *s > '9')
+        return(-1);
+    for(; s < end && *s >= '0' && *s <= '9'; s++) {
+        if(v > (UINT_MAX - 9) / 10)
+            return(-1);
+        v = v * 10 + *s - '0';
+    }
+    *p = s;
+    *val = v;
+    return(0);
+}
+
+static inline int pgm_space (char c)
+{
+    return(c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+/* binary PGM: P5 <width> <height> <maxval> <data> */
+static int parse_pgm (const char *hdr,
+                      unsigned len,
+                      mapped_info_t *info)
+{
+    const char *p = hdr + 2, *end = hdr + len;
+    unsigned vals[3], i;
+    for(i = 0; i < 3; i++) {
+        /* skip whitespace and comments */
+        while(p < end && (pgm_space(*p) || *p == '#'))
+            if(*(p++) == '#')
+                while(p < end && *p != '\n')
+                    p++;
+        if(parse_uint(&p, end, &vals[i]))
+            return(-1);
+    }
+    /* single whitespace before data */
+    if(p >= end || !pgm_space(*p) || vals[2] > 255 || !vals[2])
+        return(-1);
+    info->format = fourcc('Y','8','0','0');
+    info->width = vals[0];
+    info->height = vals[1];
+    info->offset = p + 1 - hdr;
+    info->datalen = (unsigned long)vals[0] * vals[1];
+    return(0);
+}
+
+/* compare a (not terminated) y4m colorspace tag */
+static inline int y4m_is (const char *color,
+                          unsigned clen,
+                          const char *name)
+{
+    return(strlen(name) == clen && !memcmp(color, name, clen));
+}
+
+/* first frame of a YUV4MPEG2 stream */
+static int parse_y4m (const char *hdr,
+                      unsigned len,
+                      mapped_info_t *info)
+{
+    const char *p = hdr + 9, *end = hdr + len, *color = "420";
+    unsigned clen = 3;
+    info->width = info->height = 0;
+    while(p < end && *p == ' ') {
+        const char *tag = ++p;
+        while(p < end && *p != ' ' && *p != '\n')
+            p++;
+        if(*tag == 'W' || *tag == 'H') {
+            const char *v = tag + 1;
+            if(parse_uint(&v, p, (*tag == 'W') ? &info->width
+                          : &info->height) || v != p)
+                return(-1);
+        }
+        else if(*tag == 'C') {
+            color = tag + 1;
+            clen = p - color;
+        }
+    }
+    if(p >= end || *(p++) != '\n' || !info->width || !info->height)
+        return(-1);
+
+    /* frame header, w/optional parameters */
+    if(end - p < 5 || memcmp(p, "FRAME", 5))
+        return(-1);
+    while(p < end && *p != '\n')
+        p++;
+    if(p >= end)
+        return(-1);
+    info->offset = p + 1 - hdr;
+
+    /* the luma plane comes first; map the whole frame where zbar
+     * knows the planar layout, otherwise just the luma.  colorspaces
+     * w/a bit depth suffix (eg, 420p10, mono16) have wider samples
+     */
+    info->format = fourcc('Y','8','0','0');
+    info->datalen = (unsigned long)info->width * info->height;
+    if(y4m_is(color, clen, "420") || y4m_is(color, clen, "420jpeg") ||
+       y4m_is(color, clen, "420paldv") || y4m_is(color, clen, "420mpeg2")) {
+        if(!(info->width & 1) && !(info->height & 1)) {
+            info->format = fourcc('I','4','2','0');
+            info->datalen += info->datalen / 2;
+        }
+    }
+    else if(y4m_is(color, clen, "422")) {
+        if(!(info->width & 1)) {
+            info->format = fourcc('4','2','2','P');
+            info->datalen *= 2;
+        }
+    }
+    else if(!y4m_is(color, clen, "411") && !y4m_is(color, clen, "444") &&
+            !y4m_is(color, clen, "444alpha") && !y4m_is(color, clen, "mono"))
+        return(-1);
+    return(0);
+}
+
+/* TIFF field access */
+typedef struct tiff_s {
+    int fd;
+    int big;                    /* big endian (MM) */
+} tiff_t;
+
+static inline uint32_t tiff_get (const tiff_t *tif,
+                                 const uint8_t *p,
+                                 int size)
+{
+    if(size == 2)
+        return((tif->big) ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8));
+    return((tif->big)
+           ? ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+           : p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+/* read the array of SHORT or LONG values of an IFD entry */
+static uint32_t *tiff_values (const tiff_t *tif,
+                              const uint8_t *ent,
+                              unsigned *n)
+{
+    unsigned type = tiff_get(tif, ent + 2, 2), i;
+    unsigned size = (type == 3) ? 2 : (type == 4) ? 4 : 0;
+    uint32_t count = tiff_get(tif, ent + 4, 4), *vals;
+    const uint8_t *src = ent + 8;
+    uint8_t *buf = NULL;
+
+    if(!size || !count || count > (1 << 20))
+        return(NULL);
+    if(count * size > 4) {
+        /* values stored elsewhere in the file */
+        buf = malloc(count * size);
+        if(!buf ||
+           pread(tif->fd, buf, count * size, tiff_get(tif, ent + 8, 4)) !=
+           count * size) {
+            free(buf);
+            return(NULL);
+        }
+        src = buf;
+    }
+    vals = malloc(count * sizeof(*vals));
+    if(vals)
+        for(i = 0; i < count; i++)
+            vals[i] = tiff_get(tif, src + i * size, size);
+    free(buf);
+    *n = count;
+    return(vals);
+}
+
+/* first image of an uncompressed 8 bit gray or RGB TIFF,
+ * w/strips stored in order w/out gaps
+ */
+static int parse_tiff (int fd,
+                       const uint8_t *hdr,
+                       mapped_info_t *info)
+{
+    tiff_t tif = { fd, hdr[0] == 'M' };
+    uint32_t ifd = tiff_get(&tif, hdr + 4, 4);
+    uint32_t *offsets = NULL, *counts = NULL, *bits = NULL;
+    unsigned noffsets = 0, ncounts = 0, nbits = 0, spp = 1;
+    unsigned compress = 1, photo = 0, planar = 1, i, n;
+    uint8_t cnt[2], *ents = NULL;
+    int rc = -1;
+
+    info->width = info->height = 0;
+    if(pread(fd, cnt, 2, ifd) != 2)
+        return(-1);
+    n = tiff_get(&tif, cnt, 2);
+    ents = malloc(n * 12);
+    if(!ents || pread(fd, ents, n * 12, ifd + 2) != n * 12)
+        goto done;
+
+    for(i = 0; i < n; i++) {
+        const uint8_t *ent = ents + i * 12;
+        unsigned tag = tiff_get(&tif, ent, 2), nv;
+        uint32_t *v;
+        if(tag == 273) {
+            free(offsets);
+            offsets = tiff_values(&tif, ent, &noffsets);
+            continue;
+        }
+        if(tag == 279) {
+            free(counts);
+            counts = tiff_values(&tif, ent, &ncounts);
+            continue;
+        }
+        if(tag == 258) {
+            free(bits);
+            bits = tiff_values(&tif, ent, &nbits);
+            continue;
+        }
+        if(tag != 256 && tag != 257 && tag != 259 && tag != 262 &&
+           tag != 277 && tag != 284)
+            continue;
+        v = tiff_values(&tif, ent, &nv);
+        if(!v)
+            goto done;
+        switch(tag) {
+        case 256: info->width = v[0]; break;
+        case 257: info->height = v[0]; break;
+        case 259: compress = v[0]; break;
+        case 262: photo = v[0]; break;
+        case 277: spp = v[0]; break;
+        case 284: planar = v[0]; break;
+        }
+        free(v);
+    }
+
+    /* WhiteIsZero (photo 0) would need inverting */
+    if(compress != 1 || !info->width || !info->height ||
+       (!(spp == 1 && photo == 1) && !(spp == 3 && photo == 2)) ||
+       (spp > 1 && planar != 1) ||
+       !offsets || !counts || noffsets != ncounts)
+        goto done;
+    /* NB BitsPerSample defaults to 1 */
+    if(!bits)
+        goto done;
+    for(i = 0; i < nbits; i++)
+        if(bits[i] != 8)
+            goto done;
+
+    info->format = (spp == 1) ? fourcc('Y','8','0','0')
+        : fourcc('R','G','B','3');
+    info->offset = offsets[0];
+    info->datalen = (unsigned long)info->width * info->height * spp;
+
+    /* strips must be contiguous to map as one image */
+    for(i = 1; i < noffsets; i++)
+        if(offsets[i] != offsets[i - 1] + counts[i - 1])
+            goto done;
+    rc = 0;
+
+done:
+    free(ents);
+    free(offsets);
+    free(counts);
+    free(bits);
+    return(rc);
+}
+
+zbar_image_t *zbar_image_open_mapped (const char *filename)
+{
+    char hdr[HDR_SIZE];
+    mapped_info_t info;
+    struct stat st;
+    zbar_image_t *img = NULL;
+    off_t aoff;
+    void *map;
+    ssize_t len;
+    int rc = -1, err = EINVAL;
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+        return(NULL);
+    if(fstat(fd, &st) ||
+       (len = pread(fd, hdr, sizeof(hdr), 0)) < 0) {
+        err = errno;
+        goto done;
+    }
+
+    memset(&info, 0, sizeof(info));
+    zimg_hdr_t zhdr;
+    memcpy(&zhdr, hdr, sizeof(zhdr));
+    if(len >= (ssize_t)sizeof(zhdr) && zhdr.magic == ZIMG_MAGIC) {
+        /* written by zbar_image_write() */
+        info.format = zhdr.format;
+        info.width = zhdr.width;
+        info.height = zhdr.height;
+        info.offset = sizeof(zhdr);
+        info.datalen = zhdr.size;
+        rc = 0;
+    }
+    else if(len >= 3 && hdr[0] == 'P' && hdr[1] == '5')
+        rc = parse_pgm(hdr, len, &info);
+    else if(len >= 10 && !memcmp(hdr, "YUV4MPEG2 ", 10))
+        rc = parse_y4m(hdr, len, &info);
+    else if(len >= 8 && (!memcmp(hdr, "II*\0", 4) ||
+                         !memcmp(hdr, "MM\0*", 4)))
+        rc = parse_tiff(fd, (uint8_t*)hdr, &info);
+
+    if(rc || !info.datalen || info.offset > st.st_size ||
+       info.datalen > st.st_size - info.offset) {
+        zprintf(1, "ERROR: %s: unsupported or truncated image file\n",
+                filename);
+        goto done;
+    }
+
+    /* mmap offset must be page aligned */
+    aoff = info.offset & ~(off_t)(sysconf(_SC_PAGESIZE) - 1);
+    map = mmap(NULL, info.datalen + (info.offset - aoff), PROT_READ,
+               MAP_PRIVATE, fd, aoff);
+    if(map == MAP_FAILED) {
+        err = errno;
+        goto done;
+    }
+
+    img = zbar_image_create();
+    img->format = info.format;
+    zbar_image_set_size(img, info.width, info.height);
+    img->data = (uint8_t*)map + (info.offset - aoff);
+    img->datalen = info.datalen;
+    img->cleanup = mapped_cleanup;
+    zprintf(16, "%s: mapped %.4s(%08" PRIx32 ") %dx%d @%lx\n",
+            filename, (char*)&info.format, info.format,
+            info.width, info.height, (unsigned long)info.offset);
+
+done:
+    close(fd);
+    if(!img)
+        errno = err;
+    return(img);
+}
+
+#else
+
+zbar_image_t *zbar_image_open_mapped (const char *filename)
+{
+# ifdef HAVE_ERRNO_H
+    errno = ENOSYS;
+# endif
+    return(NULL);
+}
+
+#endif
@@ -24,6 +24,9 @@
 #include "processor.h"
 #include "window.h"
 #include "image.h"
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
 
 static inline int proc_enter (zbar_processor_t *proc)
 {
@@ -49,11 +52,113 @@ static inline int proc_open (zbar_processor_t *proc)
     return(_zbar_processor_open(proc, "zbar barcode reader", width, height));
 }
 
+/* wake an application polling the result descriptor.
+ * shared data mutex is already held
+ */
+static inline void proc_signal_results (zbar_processor_t *proc)
+{
+#ifndef _WIN32
+    if(proc->result_fds[1] >= 0 && !proc->result_signaled) {
+        char c = 0;
+        if(write(proc->result_fds[1], &c, 1) == 1)
+            proc->result_signaled = 1;
+    }
+#endif
+}
+
+/* hold results for zbar_processor_poll_results().
+ * shared data mutex is already held
+ */
+static inline void proc_queue_results (zbar_processor_t *proc,
+                                       const zbar_symbol_set_t *syms)
+{
+    if(proc->nresults == PROC_RESULTS_MAX) {
+        /* application is not keeping up, discard the oldest */
+        zbar_symbol_set_ref(proc->results[proc->result_head], -1);
+        proc->result_head = (proc->result_head + 1) % PROC_RESULTS_MAX;
+        proc->nresults--;
+    }
+    zbar_symbol_set_ref(syms, 1);
+    proc->results[(proc->result_head + proc->nresults++) %
+                  PROC_RESULTS_MAX] = syms;
+    proc_signal_results(proc);
+}
+
+/* publish the results of a scanned image.  API lock is already held */
+void _zbar_processor_report (zbar_processor_t *proc,
+                             zbar_image_t *img,
+                             int nsyms)
+{
+    if(proc->syms)
+        zbar_symbol_set_ref(proc->syms, -1);
+    proc->syms = img->syms;
+    if(proc->syms)
+        zbar_symbol_set_ref(proc->syms, 1);
+
+    if(_zbar_verbosity >= 8) {
+        const zbar_symbol_t *sym = zbar_image_first_symbol(img);
+        if(nsyms > 0 && img->time)
+            zprintf(8, "frame %u: reported %lums after capture\n", img->seq,
+                    _zbar_timer_now() - img->time);
+        while(sym) {
+            zbar_symbol_type_t type = zbar_symbol_get_type(sym);
+            int count = zbar_symbol_get_count(sym);
+            zprintf(8, "%s: %s (%d pts) (dir=%d) (q=%d) (%s)\n",
+                    zbar_get_symbol_name(type),
+                    zbar_symbol_get_data(sym),
+                    zbar_symbol_get_loc_size(sym),
+                    zbar_symbol_get_orientation(sym),
+                    zbar_symbol_get_quality(sym),
+                    (count < 0) ? "uncertain" :
+                    (count > 0) ? "duplicate" : "new");
+            sym = zbar_symbol_next(sym);
+        }
+    }
+
+    if(nsyms) {
+        /* FIXME only call after filtering */
+        _zbar_mutex_lock(&proc->mutex);
+        _zbar_processor_notify(proc, EVENT_OUTPUT);
+        if(proc->result_fds[0] >= 0 && img->syms)
+            proc_queue_results(proc, img->syms);
+        _zbar_mutex_unlock(&proc->mutex);
+        if(proc->handler)
+            proc->handler(img, proc->userdata);
+    }
+}
+
+/* display to window if enabled.  API lock is already held */
+static int proc_display (zbar_processor_t *proc,
+                         zbar_image_t *img)
+{
+    uint32_t force_fmt = proc->force_output;
+    if(img && force_fmt) {
+        zbar_symbol_set_t *syms = img->syms;
+        img = zbar_image_convert(img, force_fmt);
+        if(!img)
+            return(err_capture(proc, SEV_ERROR, ZBAR_ERR_UNSUPPORTED,
+                               __func__, "unknown image format"));
+        img->syms = syms;
+        if(syms)
+            zbar_symbol_set_ref(syms, 1);
+    }
+
+    int rc = 0;
+    if(proc->window) {
+        if((rc = zbar_window_draw(proc->window, img)))
+            err_copy(proc, proc->window);
+        _zbar_processor_invalidate(proc);
+    }
+
+    if(force_fmt && img)
+        zbar_image_destroy(img);
+    return(rc);
+}
+
 /* API lock is already held */
 int _zbar_process_image (zbar_processor_t *proc,
                          zbar_image_t *img)
 {
-    uint32_t force_fmt = proc->force_output;
     if(img) {
         if(proc->dumping) {
             zbar_image_write(proc->window->image, "zbar");
@@ -69,7 +174,8 @@ int _zbar_process_image (zbar_processor_t *proc,
         /* FIXME locking all other interfaces while processing is conservative
          * but easier for now and we don't expect this to take long...
          */
-        zbar_image_t *tmp = zbar_image_convert(img, fourcc('Y','8','0','0'));
+        zbar_image_t *tmp =
+            zbar_image_pool_convert(proc->pool, img, fourcc('Y','8','0','0'));
         if(!tmp)
             goto error;
 
@@ -78,7 +184,9 @@ int _zbar_process_image (zbar_processor_t *proc,
             proc->syms = NULL;
         }
         zbar_image_scanner_recycle_image(proc->scanner, img);
+        unsigned long start = _zbar_timer_now();
         int nsyms = zbar_scan_image(proc->scanner, tmp);
+        proc->scan_cost = _zbar_timer_now() - start;
         _zbar_image_swap_symbols(img, tmp);
 
         zbar_image_destroy(tmp);
@@ -86,61 +194,38 @@ int _zbar_process_image (zbar_processor_t *proc,
         if(nsyms < 0)
             goto error;
 
-        proc->syms = zbar_image_scanner_get_results(proc->scanner);
-        if(proc->syms)
-            zbar_symbol_set_ref(proc->syms, 1);
-
-        if(_zbar_verbosity >= 8) {
-            const zbar_symbol_t *sym = zbar_image_first_symbol(img);
-            while(sym) {
-                zbar_symbol_type_t type = zbar_symbol_get_type(sym);
-                int count = zbar_symbol_get_count(sym);
-                zprintf(8, "%s: %s (%d pts) (dir=%d) (q=%d) (%s)\n",
-                        zbar_get_symbol_name(type),
-                        zbar_symbol_get_data(sym),
-                        zbar_symbol_get_loc_size(sym),
-                        zbar_symbol_get_orientation(sym),
-                        zbar_symbol_get_quality(sym),
-                        (count < 0) ? "uncertain" :
-                        (count > 0) ? "duplicate" : "new");
-                sym = zbar_symbol_next(sym);
-            }
-        }
+        _zbar_processor_report(proc, img, nsyms);
+    }
+    return(proc_display(proc, img));
 
-        if(nsyms) {
-            /* FIXME only call after filtering */
-            _zbar_mutex_lock(&proc->mutex);
-            _zbar_processor_notify(proc, EVENT_OUTPUT);
-            _zbar_mutex_unlock(&proc->mutex);
-            if(proc->handler)
-                proc->handler(img, proc->userdata);
-        }
+error:
+    return(err_capture(proc, SEV_ERROR, ZBAR_ERR_UNSUPPORTED,
+                       __func__, "unknown image format"));
+}
 
-        if(force_fmt) {
-            zbar_symbol_set_t *syms = img->syms;
-            img = zbar_image_convert(img, force_fmt);
-            if(!img)
-                goto error;
-            img->syms = syms;
-            zbar_symbol_set_ref(syms, 1);
-        }
+/* hand a captured video frame on to be scanned and displayed, unless
+ * the scan can be skipped while the scene is static.
+ * API lock is already held
+ */
+int _zbar_process_frame (zbar_processor_t *proc,
+                         zbar_image_t *img)
+{
+    int scan = !_zbar_throttle_check(proc, img);
+    if(proc->pipe) {
+        _zbar_pipeline_submit(proc, img, scan);
+        return(0);
     }
-
-    /* display to window if enabled */
-    int rc = 0;
-    if(proc->window) {
-        if((rc = zbar_window_draw(proc->window, img)))
-            err_copy(proc, proc->window);
-        _zbar_processor_invalidate(proc);
+    if(!scan) {
+        /* redisplay w/the newest results */
+        zbar_image_scanner_recycle_image(proc->scanner, img);
+        zbar_image_set_symbols(img, proc->syms);
+        return(proc_display(proc, img));
     }
 
-    if(force_fmt && img)
-        zbar_image_destroy(img);
+    int rc = _zbar_process_image(proc, img);
+    if(!rc)
+        _zbar_throttle_update(proc, img, proc->scan_cost);
     return(rc);
-
-error:
-    return(err_capture(proc, SEV_ERROR, ZBAR_ERR_UNSUPPORTED,
-                       __func__, "unknown image format"));
 }
 
 int _zbar_processor_handle_input (zbar_processor_t *proc,
@@ -210,16 +295,22 @@ static ZTHREAD proc_video_thread (void *arg)
 
         if(!img && !proc->streaming)
             continue;
-        else if(!img)
+        else if(!img) {
             /* FIXME could abort streaming and keep running? */
+            /* wake the application (eg, at the end of a video file) */
+            err_copy(proc, proc->video);
+            proc->input = -1;
+            _zbar_processor_notify(proc, EVENT_INPUT | EVENT_OUTPUT);
+            proc_signal_results(proc);
             break;
+        }
 
         /* acquire API lock */
         _zbar_processor_lock(proc);
         _zbar_mutex_unlock(&proc->mutex);
 
         if(thread->started && proc->streaming)
-            _zbar_process_image(proc, img);
+            _zbar_process_frame(proc, img);
 
         zbar_image_destroy(img);
 
@@ -278,6 +369,8 @@ zbar_processor_t *zbar_processor_create (int threaded)
         free(proc);
         return(NULL);
     }
+    proc->pool = zbar_image_pool_create();
+    proc->result_fds[0] = proc->result_fds[1] = -1;
 
     proc->threaded = !_zbar_mutex_init(&proc->mutex) && threaded;
     _zbar_processor_init(proc);
@@ -292,10 +385,31 @@ void zbar_processor_destroy (zbar_processor_t *proc)
         zbar_symbol_set_ref(proc->syms, -1);
         proc->syms = NULL;
     }
+    while(proc->nresults) {
+        zbar_symbol_set_ref(proc->results[proc->result_head], -1);
+        proc->result_head = (proc->result_head + 1) % PROC_RESULTS_MAX;
+        proc->nresults--;
+    }
+#ifndef _WIN32
+    if(proc->result_fds[0] >= 0) {
+        close(proc->result_fds[0]);
+        close(proc->result_fds[1]);
+        proc->result_fds[0] = proc->result_fds[1] = -1;
+    }
+#endif
     if(proc->scanner) {
         zbar_image_scanner_destroy(proc->scanner);
         proc->scanner = NULL;
     }
+    if(proc->pool) {
+        zbar_image_pool_destroy(proc->pool);
+        proc->pool = NULL;
+    }
+    if(proc->configs) {
+        free(proc->configs);
+        proc->configs = NULL;
+        proc->nconfigs = 0;
+    }
 
     _zbar_mutex_destroy(&proc->mutex);
     _zbar_processor_cleanup(proc);
@@ -328,7 +442,12 @@ int zbar_processor_init (zbar_processor_t *proc,
     _zbar_mutex_lock(&proc->mutex);
     _zbar_thread_stop(&proc->input_thread, &proc->mutex);
     _zbar_thread_stop(&proc->video_thread, &proc->mutex);
+    _zbar_mutex_unlock(&proc->mutex);
+
+    /* release any frames still in flight before the video goes away */
+    _zbar_pipeline_stop(proc);
 
+    _zbar_mutex_lock(&proc->mutex);
     _zbar_processor_lock(proc);
     _zbar_mutex_unlock(&proc->mutex);
 
@@ -368,14 +487,24 @@ int zbar_processor_init (zbar_processor_t *proc,
                                      proc->req_width, proc->req_height);
         if(proc->req_intf)
             zbar_video_request_interface(proc->video, proc->req_intf);
+        if(proc->latest_frame)
+            zbar_video_set_latest_frame(proc->video, 1);
         if((proc->req_iomode &&
             zbar_video_request_iomode(proc->video, proc->req_iomode)) ||
+           (proc->req_buffers &&
+            zbar_video_request_buffers(proc->video, proc->req_buffers)) ||
            zbar_video_open(proc->video, dev)) {
             rc = err_copy(proc, proc->video);
             goto done;
         }
     }
 
+    /* stage frame processing across threads */
+    if(proc->threaded && proc->video && proc->req_workers > 0 &&
+       _zbar_pipeline_start(proc, proc->req_workers))
+        zprintf(1, "WARNING: unable to start frame pipeline,"
+                " processing frames serially\n");
+
     /* spawn blocking video thread */
     int video_threaded = (proc->threaded && proc->video &&
                           zbar_video_get_fd(proc->video) < 0);
@@ -472,7 +601,47 @@ int zbar_processor_set_config (zbar_processor_t *proc,
                                int val)
 {
     proc_enter(proc);
-    int rc = zbar_image_scanner_set_config(proc->scanner, sym, cfg, val);
+    int rc;
+    if(cfg == ZBAR_CFG_LATEST_FRAME) {
+        /* capture policy rather than a scanner setting */
+        proc->latest_frame = val;
+        rc = (proc->video) ? zbar_video_set_latest_frame(proc->video, val) : 0;
+    }
+    else if(cfg == ZBAR_CFG_SKIP_STATIC) {
+        rc = (val < 0);
+        if(!rc) {
+            proc->throttle.max_skip = val;
+            _zbar_throttle_reset(proc);
+        }
+    }
+    else if(!(rc = zbar_image_scanner_set_config(proc->scanner, sym,
+                                                 cfg, val))) {
+        /* remember the setting for the pipeline scan workers, in the
+         * order applied (symbology specific and global settings overlap)
+         */
+        int i;
+        for(i = 0; i < proc->nconfigs; i++)
+            if(proc->configs[i].sym == sym && proc->configs[i].cfg == cfg)
+                break;
+        if(i < proc->nconfigs)
+            memmove(&proc->configs[i], &proc->configs[i + 1],
+                    (--proc->nconfigs - i) * sizeof(proc_config_t));
+        else {
+            proc_config_t *configs =
+                realloc(proc->configs, (i + 1) * sizeof(proc_config_t));
+            if(configs)
+                proc->configs = configs;
+            else
+                i = -1;
+        }
+        if(i >= 0) {
+            proc_config_t *c = &proc->configs[proc->nconfigs++];
+            c->sym = sym;
+            c->cfg = cfg;
+            c->val = val;
+            proc->config_gen++;
+        }
+    }
     proc_leave(proc);
     return(rc);
 }
@@ -506,6 +675,30 @@ int zbar_processor_request_iomode (zbar_processor_t *proc,
     return(0);
 }
 
+int zbar_processor_request_buffers (zbar_processor_t *proc,
+                                    int num)
+{
+    if(num < 0)
+        return(err_capture(proc, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "invalid number of video buffers"));
+    proc_enter(proc);
+    proc->req_buffers = num;
+    proc_leave(proc);
+    return(0);
+}
+
+int zbar_processor_request_workers (zbar_processor_t *proc,
+                                    int workers)
+{
+    if(workers < 0)
+        return(err_capture(proc, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "invalid number of scan workers"));
+    proc_enter(proc);
+    proc->req_workers = workers;
+    proc_leave(proc);
+    return(0);
+}
+
 int zbar_processor_force_format (zbar_processor_t *proc,
                                  unsigned long input,
                                  unsigned long output)
@@ -564,6 +757,75 @@ zbar_processor_get_results (const zbar_processor_t *proc)
     return(syms);
 }
 
+int zbar_processor_get_fd (zbar_processor_t *proc)
+{
+#ifndef _WIN32
+    int rc = 0;
+    _zbar_mutex_lock(&proc->mutex);
+    if(proc->result_fds[0] < 0) {
+        if(pipe(proc->result_fds)) {
+            proc->result_fds[0] = proc->result_fds[1] = -1;
+            rc = -1;
+        }
+        else {
+            /* never block the reporting thread (or a draining application) */
+            int i;
+            for(i = 0; i < 2; i++) {
+                fcntl(proc->result_fds[i], F_SETFL, O_NONBLOCK);
+                fcntl(proc->result_fds[i], F_SETFD, FD_CLOEXEC);
+            }
+            proc->result_signaled = 0;
+        }
+    }
+    int fd = proc->result_fds[0];
+    _zbar_mutex_unlock(&proc->mutex);
+    if(rc)
+        return(err_capture(proc, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                           "failed to open pipe"));
+    return(fd);
+#else
+    return(err_capture(proc, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                       "result descriptor not supported on this platform"));
+#endif
+}
+
+const zbar_symbol_set_t*
+zbar_processor_poll_results (zbar_processor_t *proc)
+{
+    const zbar_symbol_set_t *syms = NULL;
+    _zbar_mutex_lock(&proc->mutex);
+    if(proc->nresults) {
+        /* reference is transferred to the caller */
+        syms = proc->results[proc->result_head];
+        proc->result_head = (proc->result_head + 1) % PROC_RESULTS_MAX;
+        proc->nresults--;
+    }
+#ifndef _WIN32
+    if(!proc->nresults && proc->result_signaled) {
+        /* nothing left, quiet the descriptor */
+        char buf[16];
+        while(read(proc->result_fds[0], buf, sizeof(buf)) > 0)
+            ;
+        proc->result_signaled = 0;
+    }
+#endif
+    _zbar_mutex_unlock(&proc->mutex);
+    return(syms);
+}
+
+unsigned long zbar_processor_get_dropped_frames (zbar_processor_t *proc)
+{
+    proc_enter(proc);
+    unsigned long dropped = 0;
+    if(proc->video)
+        dropped = zbar_video_get_dropped_frames(proc->video);
+    if(proc->pipe)
+        dropped += _zbar_pipeline_get_dropped(proc);
+    dropped += proc->throttle.dropped;
+    proc_leave(proc);
+    return(dropped);
+}
+
 int zbar_processor_user_wait (zbar_processor_t *proc,
                               int timeout)
 {
@@ -603,6 +865,7 @@ int zbar_processor_set_active (zbar_processor_t *proc,
     _zbar_mutex_unlock(&proc->mutex);
 
     zbar_image_scanner_enable_cache(proc->scanner, active);
+    _zbar_throttle_reset(proc);
 
     rc = zbar_video_enable(proc->video, active);
     if(!rc) {
@@ -42,9 +42,46 @@
  */
 #define MAX_INPUT_BLOCK 15/*ms*/
 
+/* decode results held for zbar_processor_poll_results().
+ * the oldest are discarded if the application falls this far behind
+ */
+#define PROC_RESULTS_MAX 16
+
 /* platform specific state wrapper */
 typedef struct processor_state_s processor_state_t;
 
+/* staged frame processing */
+typedef struct proc_pipeline_s proc_pipeline_t;
+
+/* scanner config setting, replayed for the pipeline scan workers */
+typedef struct proc_config_s {
+    zbar_symbol_type_t sym;
+    zbar_config_t cfg;
+    int val;
+} proc_config_t;
+
+/* adaptive frame skipping while the scene is static (see throttle.c) */
+#define THROTTLE_THUMB_W 32             /* downsampled luma for frame */
+#define THROTTLE_THUMB_H 24             /* difference checks */
+
+typedef struct proc_throttle_s {
+    int max_skip;                       /* app requested limit, 0 disables */
+    int skipped;                        /* frames skipped since last scan */
+    unsigned long dropped;              /* frames skipped in total */
+    int settled;                        /* scan found only confirmed results */
+    unsigned moved;                     /* newest frame w/motion */
+    int nsyms;                          /* confirmed results of a full scan */
+    unsigned roi_x, roi_y, roi_w, roi_h; /* area around those results */
+    int cropped;                        /* frames may still have roi crop */
+    unsigned width, height;             /* size of frames w/... */
+    unsigned crop_x, crop_y, crop_w, crop_h; /* ...crop they arrive w/ */
+    unsigned long last_time;            /* capture time of previous frame */
+    unsigned interval;                  /* average frame interval (ms/16) */
+    unsigned cost;                      /* average scan time (ms/16) */
+    int have_ref;                       /* ref holds last scanned frame */
+    uint8_t ref[THROTTLE_THUMB_W * THROTTLE_THUMB_H];
+} proc_throttle_t;
+
 /* specific notification tracking */
 typedef struct proc_waiter_s {
     struct proc_waiter_s *next;
@@ -66,11 +103,17 @@ struct zbar_processor_s {
     zbar_video_t *video;                /* input video device abstraction */
     zbar_window_t *window;              /* output window abstraction */
     zbar_image_scanner_t *scanner;      /* barcode scanner */
+    zbar_image_pool_t *pool;            /* converted frame buffers */
 
     zbar_image_data_handler_t *handler; /* application data handler */
 
     unsigned req_width, req_height;     /* application requested video size */
     int req_intf, req_iomode;           /* application requested interface */
+    int req_buffers;                    /* application requested buffers */
+    int req_workers;                    /* application requested pipeline */
+    int latest_frame;                   /* video skips stale frames */
+    proc_throttle_t throttle;           /* static scene frame skipping */
+    unsigned scan_cost;                 /* duration of newest scan (ms) */
     uint32_t force_input;               /* force input format (debug) */
     uint32_t force_output;              /* force format conversion (debug) */
 
@@ -90,6 +133,17 @@ struct zbar_processor_s {
 
     const zbar_symbol_set_t *syms;      /* previous decode results */
 
+    /* pollable result delivery (see zbar_processor_get_fd()) */
+    int result_fds[2];                  /* readable while results pending */
+    int result_signaled;                /* result_fds has unread data */
+    const zbar_symbol_set_t *results[PROC_RESULTS_MAX];
+    unsigned result_head, nresults;     /* queued results */
+
+    proc_pipeline_t *pipe;              /* staged video frame processing */
+    proc_config_t *configs;             /* scanner settings applied so far */
+    int nconfigs;
+    unsigned config_gen;                /* incremented w/each new setting */
+
     zbar_mutex_t mutex;                 /* shared data mutex */
 
     /* API serialization lock */
@@ -114,7 +168,21 @@ extern int _zbar_processor_input_wait(zbar_processor_t*, zbar_event_t*, int);
 extern int _zbar_processor_enable(zbar_processor_t*);
 
 extern int _zbar_process_image(zbar_processor_t*, zbar_image_t*);
+extern void _zbar_processor_report(zbar_processor_t*, zbar_image_t*, int);
 extern int _zbar_processor_handle_input(zbar_processor_t*, int);
+extern int _zbar_process_frame(zbar_processor_t*, zbar_image_t*);
+
+/* frame skipping API */
+extern int _zbar_throttle_check(zbar_processor_t*, zbar_image_t*);
+extern void _zbar_throttle_update(zbar_processor_t*, const zbar_image_t*,
+                                  unsigned);
+extern void _zbar_throttle_reset(zbar_processor_t*);
+
+/* pipeline API */
+extern int _zbar_pipeline_start(zbar_processor_t*, int);
+extern void _zbar_pipeline_stop(zbar_processor_t*);
+extern void _zbar_pipeline_submit(zbar_processor_t*, zbar_image_t*, int);
+extern unsigned long _zbar_pipeline_get_dropped(zbar_processor_t*);
 
 /* windowing platform API */
 extern int _zbar_processor_open(zbar_processor_t*, char*, unsigned, unsigned);
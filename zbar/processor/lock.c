@@ -174,7 +174,7 @@ static inline int proc_wait_unthreaded (zbar_processor_t *proc,
 
             /* FIXME reacquire API lock! (refactor w/video thread?) */
             _zbar_mutex_lock(&proc->mutex);
-            _zbar_process_image(proc, img);
+            _zbar_process_frame(proc, img);
             zbar_image_destroy(img);
             _zbar_mutex_unlock(&proc->mutex);
         }
@@ -0,0 +1,505 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+#include "processor.h"
+#include "window.h"
+#include "image.h"
+#include "symbol.h"
+
+/* staged video frame processing.  the capture thread only hands each
+ * frame over; a conversion thread makes the Y800 copy to be scanned,
+ * which also releases the video buffer, then queues it for one of the
+ * scan workers, each w/its own image scanner.  an output thread delivers
+ * the results in capture order and independently redraws the window w/
+ * the newest frame as soon as it is captured.
+ *
+ * the stages are connected by bounded queues: capture leaves only the
+ * newest frame for conversion (older frames are dropped when conversion
+ * falls behind, so capture never blocks) and conversion waits for room
+ * in the ring of frames being scanned or waiting to be delivered.
+ * everything is guarded by a pipeline lock separate from the API lock,
+ * which is only taken to deliver results and draw
+ */
+
+#ifdef ZTHREAD
+
+#define PIPE_MAX_WORKERS 8
+
+/* frames in the scan ring: queued for a worker, scanning or waiting to be
+ * delivered in order
+ */
+#define PIPE_RING (2 * PIPE_MAX_WORKERS)
+
+typedef struct pipe_job_s {
+    zbar_image_t *img;                  /* converted frame */
+    int nsyms;                          /* scan result */
+    unsigned cost;                      /* scan time (ms) */
+    int done;                           /* scan complete */
+} pipe_job_t;
+
+typedef struct pipe_worker_s {
+    proc_pipeline_t *pipe;
+    zbar_thread_t thread;
+    zbar_image_scanner_t *scanner;      /* private scanner */
+    unsigned config_gen;                /* processor settings applied */
+} pipe_worker_t;
+
+struct proc_pipeline_s {
+    zbar_processor_t *proc;
+    zbar_mutex_t lock;                  /* pipeline state lock */
+
+    zbar_image_t *frame;                /* newest frame to convert */
+    zbar_image_t *display;              /* newest frame to draw */
+    unsigned long dropped;              /* frames never converted */
+
+    /* ring cursors: queued <= seq, scanning or done in [delivered, scan) */
+    unsigned long seq, scan, delivered;
+    int depth;                          /* max frames in the ring */
+    pipe_job_t jobs[PIPE_RING];
+
+    /* newest results reported to the application */
+    zbar_symbol_set_t *reported;
+    unsigned long reported_at;
+
+    zbar_thread_t convert_thread, output_thread;
+    int nworkers;
+    pipe_worker_t workers[PIPE_MAX_WORKERS];
+};
+
+static ZTHREAD pipe_convert_thread (void *arg)
+{
+    proc_pipeline_t *pipe = arg;
+    zbar_thread_t *thread = &pipe->convert_thread;
+    int i;
+
+    _zbar_mutex_lock(&pipe->lock);
+    _zbar_thread_init(thread);
+    zprintf(4, "spawned pipeline conversion thread\n");
+
+    while(thread->started) {
+        zbar_image_t *img = pipe->frame, *gray;
+        pipe_job_t *job;
+        if(!img) {
+            _zbar_event_wait(&thread->notify, &pipe->lock, NULL);
+            continue;
+        }
+        pipe->frame = NULL;
+        _zbar_mutex_unlock(&pipe->lock);
+
+        gray = zbar_image_pool_convert(pipe->proc->pool, img,
+                                       fourcc('Y','8','0','0'));
+        if(gray)
+            gray->seq = img->seq;
+        else
+            zprintf(1, "ERROR: unable to convert %.4s frame\n",
+                    (char*)&img->format);
+        /* video buffer is free to capture again */
+        zbar_image_destroy(img);
+
+        _zbar_mutex_lock(&pipe->lock);
+        if(!gray)
+            continue;
+        while(thread->started && pipe->seq - pipe->delivered >= pipe->depth)
+            _zbar_event_wait(&thread->notify, &pipe->lock, NULL);
+        if(!thread->started) {
+            zbar_image_destroy(gray);
+            break;
+        }
+
+        job = &pipe->jobs[pipe->seq++ % PIPE_RING];
+        job->img = gray;
+        job->nsyms = 0;
+        job->done = 0;
+        for(i = 0; i < pipe->nworkers; i++)
+            _zbar_event_trigger(&pipe->workers[i].thread.notify);
+    }
+
+    thread->running = 0;
+    _zbar_event_trigger(&thread->activity);
+    _zbar_mutex_unlock(&pipe->lock);
+    return(0);
+}
+
+/* catch up w/processor settings changed since the last scan */
+static inline void pipe_worker_config (pipe_worker_t *worker)
+{
+    zbar_processor_t *proc = worker->pipe->proc;
+    _zbar_mutex_lock(&proc->mutex);
+    if(worker->config_gen != proc->config_gen) {
+        int i;
+        for(i = 0; i < proc->nconfigs; i++)
+            zbar_image_scanner_set_config(worker->scanner,
+                                          proc->configs[i].sym,
+                                          proc->configs[i].cfg,
+                                          proc->configs[i].val);
+        worker->config_gen = proc->config_gen;
+    }
+    _zbar_mutex_unlock(&proc->mutex);
+}
+
+static ZTHREAD pipe_scan_thread (void *arg)
+{
+    pipe_worker_t *worker = arg;
+    proc_pipeline_t *pipe = worker->pipe;
+    zbar_thread_t *thread = &worker->thread;
+
+    _zbar_mutex_lock(&pipe->lock);
+    _zbar_thread_init(thread);
+    zprintf(4, "spawned pipeline scan worker %d\n",
+            (int)(worker - pipe->workers));
+
+    while(thread->started) {
+        pipe_job_t *job;
+        unsigned long start;
+        if(pipe->scan == pipe->seq) {
+            _zbar_event_wait(&thread->notify, &pipe->lock, NULL);
+            continue;
+        }
+        job = &pipe->jobs[pipe->scan++ % PIPE_RING];
+        _zbar_mutex_unlock(&pipe->lock);
+
+        pipe_worker_config(worker);
+        start = _zbar_timer_now();
+        job->nsyms = zbar_scan_image(worker->scanner, job->img);
+        job->cost = _zbar_timer_now() - start;
+
+        _zbar_mutex_lock(&pipe->lock);
+        job->done = 1;
+        _zbar_event_trigger(&pipe->output_thread.notify);
+    }
+
+    thread->running = 0;
+    _zbar_event_trigger(&thread->activity);
+    _zbar_mutex_unlock(&pipe->lock);
+    return(0);
+}
+
+/* acquire the API lock, returning whether results are still wanted */
+static inline int pipe_proc_lock (zbar_processor_t *proc)
+{
+    int streaming;
+    _zbar_mutex_lock(&proc->mutex);
+    _zbar_processor_lock(proc);
+    streaming = proc->streaming;
+    _zbar_mutex_unlock(&proc->mutex);
+    return(streaming);
+}
+
+static inline void pipe_proc_unlock (zbar_processor_t *proc)
+{
+    _zbar_mutex_lock(&proc->mutex);
+    _zbar_processor_unlock(proc, 0);
+    _zbar_mutex_unlock(&proc->mutex);
+}
+
+/* the window holds on to the captured frame through this wrapper, which
+ * carries the overlay w/o touching the frame itself
+ */
+static void pipe_display_cleanup (zbar_image_t *img)
+{
+    zbar_image_destroy((zbar_image_t*)img->userdata);
+}
+
+static void pipe_draw (proc_pipeline_t *pipe,
+                       zbar_image_t *frame)
+{
+    zbar_processor_t *proc = pipe->proc;
+    if(pipe_proc_lock(proc) && proc->window) {
+        zbar_image_t *img = zbar_image_create();
+        img->format = frame->format;
+        zbar_image_set_size(img, frame->width, frame->height);
+        img->seq = frame->seq;
+        img->time = frame->time;
+        img->frame_x = frame->frame_x;
+        img->frame_y = frame->frame_y;
+        img->userdata = frame;
+        zbar_image_ref(frame, 1);
+        zbar_image_set_data(img, frame->data, frame->datalen,
+                            pipe_display_cleanup);
+
+        /* overlay the newest results */
+        img->syms = (zbar_symbol_set_t*)proc->syms;
+        if(img->syms)
+            zbar_symbol_set_ref(img->syms, 1);
+
+        if(proc->dumping) {
+            zbar_image_write(proc->window->image, "zbar");
+            proc->dumping = 0;
+        }
+
+        if(proc->force_output) {
+            zbar_image_t *out = zbar_image_convert(img, proc->force_output);
+            if(out) {
+                out->syms = img->syms;
+                if(out->syms)
+                    zbar_symbol_set_ref(out->syms, 1);
+            }
+            zbar_image_destroy(img);
+            img = out;
+        }
+
+        if(img) {
+            if(zbar_window_draw(proc->window, img))
+                err_copy(proc, proc->window);
+            _zbar_processor_invalidate(proc);
+            zbar_image_destroy(img);
+        }
+    }
+    pipe_proc_unlock(proc);
+}
+
+/* each worker caches results separately, so the same new symbol is
+ * usually found by every worker in turn.  only the first of those
+ * reports is passed on
+ */
+static int pipe_repeated (proc_pipeline_t *pipe,
+                          const zbar_symbol_set_t *syms)
+{
+    const zbar_symbol_t *sym;
+    if(!pipe->reported || pipe->delivered - pipe->reported_at > PIPE_RING)
+        return(0);
+    for(sym = syms->head; sym; sym = sym->next) {
+        const zbar_symbol_t *prev;
+        if(sym->cache_count)
+            continue;
+        for(prev = pipe->reported->head; prev; prev = prev->next)
+            if(prev->type == sym->type &&
+               prev->datalen == sym->datalen &&
+               !memcmp(prev->data, sym->data, sym->datalen))
+                break;
+        if(!prev)
+            return(0);
+    }
+    return(1);
+}
+
+static ZTHREAD pipe_output_thread (void *arg)
+{
+    proc_pipeline_t *pipe = arg;
+    zbar_processor_t *proc = pipe->proc;
+    zbar_thread_t *thread = &pipe->output_thread;
+
+    _zbar_mutex_lock(&pipe->lock);
+    _zbar_thread_init(thread);
+    zprintf(4, "spawned pipeline output thread\n");
+
+    while(thread->started) {
+        zbar_image_t *frame = pipe->display;
+        pipe_job_t *job = NULL;
+        if(pipe->delivered != pipe->scan &&
+           pipe->jobs[pipe->delivered % PIPE_RING].done)
+            job = &pipe->jobs[pipe->delivered % PIPE_RING];
+        if(!job && !frame) {
+            _zbar_event_wait(&thread->notify, &pipe->lock, NULL);
+            continue;
+        }
+        pipe->display = NULL;
+        _zbar_mutex_unlock(&pipe->lock);
+
+        if(job) {
+            int nsyms = job->nsyms;
+            if(nsyms > 0 && pipe_repeated(pipe, job->img->syms))
+                nsyms = 0;
+            else if(nsyms > 0) {
+                if(pipe->reported)
+                    zbar_symbol_set_ref(pipe->reported, -1);
+                pipe->reported = job->img->syms;
+                zbar_symbol_set_ref(pipe->reported, 1);
+                pipe->reported_at = pipe->delivered;
+            }
+            if(pipe_proc_lock(proc) && nsyms >= 0) {
+                _zbar_throttle_update(proc, job->img, job->cost);
+                _zbar_processor_report(proc, job->img, nsyms);
+            }
+            pipe_proc_unlock(proc);
+            zbar_image_destroy(job->img);
+        }
+        if(frame) {
+            pipe_draw(pipe, frame);
+            zbar_image_destroy(frame);
+        }
+
+        _zbar_mutex_lock(&pipe->lock);
+        if(job) {
+            job->img = NULL;
+            pipe->delivered++;
+            _zbar_event_trigger(&pipe->convert_thread.notify);
+        }
+    }
+
+    thread->running = 0;
+    _zbar_event_trigger(&thread->activity);
+    _zbar_mutex_unlock(&pipe->lock);
+    return(0);
+}
+
+/* frames not scanned are only drawn.  API lock is already held */
+void _zbar_pipeline_submit (zbar_processor_t *proc,
+                            zbar_image_t *img,
+                            int scan)
+{
+    proc_pipeline_t *pipe = proc->pipe;
+    _zbar_mutex_lock(&pipe->lock);
+
+    if(scan) {
+        if(pipe->frame) {
+            /* conversion fell behind */
+            zbar_image_destroy(pipe->frame);
+            pipe->dropped++;
+            zprintf(24, "dropped frame (%lu total)\n", pipe->dropped);
+        }
+        zbar_image_ref(img, 1);
+        pipe->frame = img;
+        _zbar_event_trigger(&pipe->convert_thread.notify);
+    }
+
+    if(proc->window) {
+        if(pipe->display)
+            zbar_image_destroy(pipe->display);
+        zbar_image_ref(img, 1);
+        pipe->display = img;
+        _zbar_event_trigger(&pipe->output_thread.notify);
+    }
+
+    _zbar_mutex_unlock(&pipe->lock);
+}
+
+unsigned long _zbar_pipeline_get_dropped (zbar_processor_t *proc)
+{
+    proc_pipeline_t *pipe = proc->pipe;
+    unsigned long dropped;
+    _zbar_mutex_lock(&pipe->lock);
+    dropped = pipe->dropped;
+    _zbar_mutex_unlock(&pipe->lock);
+    return(dropped);
+}
+
+int _zbar_pipeline_start (zbar_processor_t *proc,
+                          int nworkers)
+{
+    proc_pipeline_t *pipe;
+    int i;
+
+    if(proc->pipe)
+        return(0);
+    if(nworkers > PIPE_MAX_WORKERS)
+        nworkers = PIPE_MAX_WORKERS;
+
+    pipe = calloc(1, sizeof(proc_pipeline_t));
+    if(!pipe)
+        return(-1);
+    pipe->proc = proc;
+    pipe->depth = 2 * nworkers;
+    if(_zbar_mutex_init(&pipe->lock)) {
+        free(pipe);
+        return(-1);
+    }
+    proc->pipe = pipe;
+
+    for(i = 0; i < nworkers; i++) {
+        pipe_worker_t *worker = &pipe->workers[i];
+        worker->pipe = pipe;
+        worker->scanner = zbar_image_scanner_create();
+        if(!worker->scanner)
+            goto error;
+        /* settings are applied before the first scan */
+        worker->config_gen = proc->config_gen - 1;
+        zbar_image_scanner_enable_cache(worker->scanner, 1);
+        pipe->nworkers++;
+        if(_zbar_thread_start(&worker->thread, pipe_scan_thread, worker,
+                              &pipe->lock))
+            goto error;
+    }
+
+    if(_zbar_thread_start(&pipe->output_thread, pipe_output_thread, pipe,
+                          &pipe->lock) ||
+       _zbar_thread_start(&pipe->convert_thread, pipe_convert_thread, pipe,
+                          &pipe->lock))
+        goto error;
+
+    zprintf(4, "started frame pipeline w/%d scan workers\n", nworkers);
+    return(0);
+
+ error:
+    _zbar_pipeline_stop(proc);
+    return(-1);
+}
+
+void _zbar_pipeline_stop (zbar_processor_t *proc)
+{
+    proc_pipeline_t *pipe = proc->pipe;
+    int i;
+    if(!pipe)
+        return;
+
+    _zbar_mutex_lock(&pipe->lock);
+    _zbar_thread_stop(&pipe->convert_thread, &pipe->lock);
+    for(i = 0; i < pipe->nworkers; i++)
+        _zbar_thread_stop(&pipe->workers[i].thread, &pipe->lock);
+    _zbar_thread_stop(&pipe->output_thread, &pipe->lock);
+    _zbar_mutex_unlock(&pipe->lock);
+
+    if(pipe->frame)
+        zbar_image_destroy(pipe->frame);
+    if(pipe->display)
+        zbar_image_destroy(pipe->display);
+    for(i = 0; i < PIPE_RING; i++)
+        if(pipe->jobs[i].img)
+            zbar_image_destroy(pipe->jobs[i].img);
+    if(pipe->reported)
+        zbar_symbol_set_ref(pipe->reported, -1);
+    for(i = 0; i < pipe->nworkers; i++) {
+        /* release cached results before the scanner */
+        zbar_image_scanner_enable_cache(pipe->workers[i].scanner, 0);
+        zbar_image_scanner_destroy(pipe->workers[i].scanner);
+    }
+    if(pipe->dropped)
+        zprintf(4, "frame pipeline dropped %lu frames\n", pipe->dropped);
+
+    _zbar_mutex_destroy(&pipe->lock);
+    free(pipe);
+    proc->pipe = NULL;
+}
+
+#else
+
+int _zbar_pipeline_start (zbar_processor_t *proc,
+                          int nworkers)
+{
+    return(-1);
+}
+
+void _zbar_pipeline_stop (zbar_processor_t *proc)
+{
+}
+
+void _zbar_pipeline_submit (zbar_processor_t *proc,
+                            zbar_image_t *img,
+                            int scan)
+{
+}
+
+unsigned long _zbar_pipeline_get_dropped (zbar_processor_t *proc)
+{
+    return(0);
+}
+
+#endif
@@ -191,7 +191,7 @@ static int proc_video_handler (zbar_processor_t *proc,
         /* not expected to block */
         img = zbar_video_next_image(proc->video);
         if(img)
-            _zbar_process_image(proc, img);
+            _zbar_process_frame(proc, img);
     }
 
     _zbar_mutex_lock(&proc->mutex);
@@ -0,0 +1,296 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+#include "processor.h"
+#include "image.h"
+#include "symbol.h"
+
+/* adaptive frame skipping (see ::ZBAR_CFG_SKIP_STATIC).  every captured
+ * frame is reduced to a coarse luma thumbnail and compared w/the frame
+ * last scanned.  once a scan has found nothing the cache has not already
+ * confirmed and the scene has not changed since, frames are skipped to
+ * hold scanning to a fixed share of the measured frame time, and the
+ * frames still scanned are cropped to the area around the confirmed
+ * symbols.  motion, or a scan turning up anything new or unconfirmed,
+ * returns to scanning every full frame
+ */
+
+/* change of a thumbnail cell considered motion, and how many such
+ * cells are tolerated (eg, sensor noise)
+ */
+#define THROTTLE_MOTION       12
+#define THROTTLE_MOTION_CELLS 1
+
+/* static scenes spend at most 1/THROTTLE_DUTY of the frame time scanning
+ */
+#define THROTTLE_DUTY         8
+
+/* longest gap between scans, well inside the result cache proximity
+ */
+#define THROTTLE_MAX_MS       250
+
+/* samples averaged in each direction for a thumbnail cell */
+#define THROTTLE_SAMPLES      4
+
+/* averages in ms/16: frame times are only measured to the ms */
+static inline unsigned throttle_average (unsigned avg,
+                                         unsigned long ms)
+{
+    unsigned sample = ((ms > 1000) ? 1000 : ms) << 4;
+    return((avg) ? (avg * 7 + sample) / 8 : sample);
+}
+
+/* reduce the frame to THROTTLE_THUMB_W x THROTTLE_THUMB_H cells of
+ * averaged luma.  packed RGB uses a single channel, which is enough to
+ * see motion.  returns -1 if the frame can not be sampled (eg, JPEG)
+ */
+static int throttle_thumb (const zbar_image_t *img,
+                           uint8_t *thumb)
+{
+    const zbar_format_def_t *fmt = _zbar_format_lookup(img->format);
+    const uint8_t *data = img->data;
+    unsigned step, offset, cw, ch, tx, ty;
+    if(!fmt || !data)
+        return(-1);
+
+    switch(fmt->group) {
+    case ZBAR_FMT_GRAY:
+    case ZBAR_FMT_YUV_PLANAR:
+    case ZBAR_FMT_YUV_NV:
+        step = 1;
+        offset = 0;
+        break;
+    case ZBAR_FMT_YUV_PACKED:
+        step = 2;
+        offset = (fmt->p.yuv.packorder & 2) ? 1 : 0;
+        break;
+    case ZBAR_FMT_RGB_PACKED:
+        step = fmt->p.rgb.bpp >> 3;
+        offset = (step > 1);
+        break;
+    default:
+        return(-1);
+    }
+
+    cw = img->width / THROTTLE_THUMB_W;
+    ch = img->height / THROTTLE_THUMB_H;
+    if(!cw || !ch ||
+       img->datalen < (unsigned long)img->width * img->height * step)
+        return(-1);
+
+    for(ty = 0; ty < THROTTLE_THUMB_H; ty++)
+        for(tx = 0; tx < THROTTLE_THUMB_W; tx++) {
+            unsigned sum = 0, i, j;
+            for(j = 0; j < THROTTLE_SAMPLES; j++) {
+                unsigned y =
+                    ty * ch + (2 * j + 1) * ch / (2 * THROTTLE_SAMPLES);
+                const uint8_t *row =
+                    data + (unsigned long)y * img->width * step;
+                for(i = 0; i < THROTTLE_SAMPLES; i++) {
+                    unsigned x =
+                        tx * cw + (2 * i + 1) * cw / (2 * THROTTLE_SAMPLES);
+                    sum += row[x * step + offset];
+                }
+            }
+            *(thumb++) = sum / (THROTTLE_SAMPLES * THROTTLE_SAMPLES);
+        }
+    return(0);
+}
+
+static inline int throttle_moved (const uint8_t *a,
+                                  const uint8_t *b)
+{
+    int i, n = 0;
+    for(i = 0; i < THROTTLE_THUMB_W * THROTTLE_THUMB_H; i++)
+        if(abs((int)a[i] - (int)b[i]) > THROTTLE_MOTION &&
+           ++n > THROTTLE_MOTION_CELLS)
+            return(1);
+    return(0);
+}
+
+/* frames that may be skipped between scans of a static scene */
+static inline int throttle_limit (const proc_throttle_t *t)
+{
+    int limit = t->max_skip, n;
+    if(!t->interval)
+        return(0);
+    n = t->cost * THROTTLE_DUTY / t->interval;
+    if(limit > n)
+        limit = n;
+    n = (THROTTLE_MAX_MS << 4) / t->interval;
+    if(limit > n)
+        limit = n;
+    return(limit);
+}
+
+void _zbar_throttle_reset (zbar_processor_t *proc)
+{
+    proc_throttle_t *t = &proc->throttle;
+    proc_throttle_t keep = *t;
+    memset(t, 0, sizeof(*t));
+    t->max_skip = keep.max_skip;
+    t->dropped = keep.dropped;
+    /* reused video images may still have a crop from before */
+    t->cropped = keep.cropped;
+    t->width = keep.width;
+    t->height = keep.height;
+    t->crop_x = keep.crop_x;
+    t->crop_y = keep.crop_y;
+    t->crop_w = keep.crop_w;
+    t->crop_h = keep.crop_h;
+}
+
+/* decide whether a captured frame is scanned, and how much of it.
+ * returns 1 to skip the frame.  API lock is already held
+ */
+int _zbar_throttle_check (zbar_processor_t *proc,
+                          zbar_image_t *img)
+{
+    proc_throttle_t *t = &proc->throttle;
+    uint8_t thumb[THROTTLE_THUMB_W * THROTTLE_THUMB_H];
+
+    if(t->cropped && (img->width != t->width || img->height != t->height))
+        /* resized images no longer have the crop */
+        t->cropped = 0;
+    if(t->cropped)
+        /* video images are reused, undo a crop set on an earlier frame */
+        zbar_image_set_crop(img, t->crop_x, t->crop_y, t->crop_w, t->crop_h);
+    if(!t->max_skip)
+        return(0);
+    if(!t->cropped) {
+        /* the crop frames arrive w/(eg, padded rows) bounds the scan */
+        t->width = img->width;
+        t->height = img->height;
+        t->crop_x = img->crop_x;
+        t->crop_y = img->crop_y;
+        t->crop_w = img->crop_w;
+        t->crop_h = img->crop_h;
+    }
+
+    if(t->last_time && (long)(img->time - t->last_time) > 0)
+        t->interval = throttle_average(t->interval,
+                                       img->time - t->last_time);
+    t->last_time = img->time;
+
+    if(throttle_thumb(img, thumb)) {
+        t->have_ref = t->settled = 0;
+        return(0);
+    }
+
+    if(!t->have_ref || throttle_moved(thumb, t->ref)) {
+        if(t->settled)
+            zprintf(16, "frame %u: motion, resuming full rate\n", img->seq);
+        t->settled = 0;
+        t->moved = img->seq;
+    }
+    else if(t->settled) {
+        if(t->skipped < throttle_limit(t)) {
+            t->skipped++;
+            t->dropped++;
+            return(1);
+        }
+        if(t->roi_w) {
+            zbar_image_set_crop(img, t->roi_x, t->roi_y,
+                                t->roi_w, t->roi_h);
+            t->cropped = 1;
+        }
+    }
+
+    t->skipped = 0;
+    memcpy(t->ref, thumb, sizeof(thumb));
+    t->have_ref = 1;
+    return(0);
+}
+
+/* track the results and cost of a scanned frame.
+ * API lock is already held
+ */
+void _zbar_throttle_update (zbar_processor_t *proc,
+                            const zbar_image_t *img,
+                            unsigned cost)
+{
+    proc_throttle_t *t = &proc->throttle;
+    const zbar_symbol_t *sym;
+    int partial, x0, y0, x1, y1;
+    int nsyms = 0, settled = 1;
+    if(!t->max_skip)
+        return;
+
+    /* only a crop inside the one frames arrive w/is a partial scan */
+    partial = (img->crop_w < t->crop_w || img->crop_h < t->crop_h);
+    x0 = t->crop_x + t->crop_w;
+    y0 = t->crop_y + t->crop_h;
+    x1 = y1 = 0;
+
+    t->cost = throttle_average(t->cost, cost);
+
+    /* include the results the cache filters from the application */
+    for(sym = (img->syms) ? img->syms->head : NULL; sym; sym = sym->next) {
+        unsigned i;
+        if(sym->cache_count <= 0)
+            /* new or not yet confirmed */
+            settled = 0;
+        nsyms++;
+        for(i = 0; i < sym->npts; i++) {
+            int x = sym->pts[i].x - (int)img->frame_x;
+            int y = sym->pts[i].y - (int)img->frame_y;
+            if(x0 > x) x0 = x;
+            if(x1 < x) x1 = x;
+            if(y0 > y) y0 = y;
+            if(y1 < y) y1 = y;
+        }
+    }
+
+    if((int)(img->seq - t->moved) < 0)
+        /* scene changed since this frame was captured */
+        settled = 0;
+    else if(partial && nsyms < t->nsyms)
+        /* lost track of a symbol, look everywhere */
+        settled = 0;
+    else if(!partial) {
+        /* leave a margin for QR finders, quiet zones and jitter */
+        int margin = (((x1 - x0) > (y1 - y0)) ? x1 - x0 : y1 - y0) / 4 + 16;
+        t->nsyms = nsyms;
+        t->roi_w = 0;
+        x0 -= margin;
+        y0 -= margin;
+        x1 += margin;
+        y1 += margin;
+        if(x0 < (int)t->crop_x) x0 = t->crop_x;
+        if(y0 < (int)t->crop_y) y0 = t->crop_y;
+        if(x1 > (int)(t->crop_x + t->crop_w)) x1 = t->crop_x + t->crop_w;
+        if(y1 > (int)(t->crop_y + t->crop_h)) y1 = t->crop_y + t->crop_h;
+        if(nsyms && x1 > x0 && y1 > y0 &&
+           (unsigned long)(x1 - x0) * (y1 - y0) <
+           (unsigned long)t->crop_w * t->crop_h / 2) {
+            t->roi_x = x0;
+            t->roi_y = y0;
+            t->roi_w = x1 - x0;
+            t->roi_h = y1 - y0;
+        }
+    }
+
+    if(settled != t->settled)
+        zprintf(16, "frame %u: %s (scan %ums, frame %ums)\n", img->seq,
+                (settled) ? "static, throttling" : "unsettled, full rate",
+                t->cost >> 4, t->interval >> 4);
+    t->settled = settled;
+}
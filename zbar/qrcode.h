@@ -55,6 +55,8 @@ struct qr_finder_line {
 qr_reader *_zbar_qr_create(void);
 void _zbar_qr_destroy(qr_reader *reader);
 void _zbar_qr_reset(qr_reader *reader);
+void _zbar_qr_set_tracking(qr_reader *reader, int enable);
+void _zbar_qr_forget(qr_reader *reader);
 
 int _zbar_qr_found_line(qr_reader *reader,
                         int direction,
@@ -63,4 +65,18 @@ int _zbar_qr_decode(qr_reader *reader,
                     zbar_image_scanner_t *iscn,
                     zbar_image_t *img);
 
+/* strip scanning: img describes the whole image, while data only holds
+ * rows [y0, y0 + rows), which are searched around the finder centers
+ * located so far.  lines that can't reach a strip starting at row y
+ * are dropped first w/_zbar_qr_trim_lines()
+ */
+void _zbar_qr_trim_lines(qr_reader *reader,
+                         int y);
+int _zbar_qr_decode_strip(qr_reader *reader,
+                          zbar_image_scanner_t *iscn,
+                          zbar_image_t *img,
+                          const unsigned char *data,
+                          int y0,
+                          int rows);
+
 #endif
@@ -18,6 +18,7 @@
 #include "image.h"
 #include "error.h"
 #include "svg.h"
+#include "img_scanner.h"
 
 typedef int qr_line[3];
 
@@ -30,6 +31,8 @@ typedef struct qr_hom qr_hom;
 
 typedef struct qr_finder qr_finder;
 
+typedef struct qr_tracked_code  qr_tracked_code;
+
 typedef struct qr_hom_cell      qr_hom_cell;
 typedef struct qr_sampling_grid qr_sampling_grid;
 typedef struct qr_pack_buf      qr_pack_buf;
@@ -54,6 +57,34 @@ typedef struct qr_pack_buf      qr_pack_buf;
 #define QR_ALIGN_SUBPREC (2)
 
 
+/*The maximum number of codes to follow from one frame to the next.*/
+#define QR_TRACK_MAX (8)
+
+/*The number of consecutive frames for which tracked codes may be decoded
+   before we do a full search again (to pick up any new codes).*/
+#define QR_TRACK_REDETECT (8)
+
+/*The distance (in pixels) each finder center may move from one frame to the
+   next while the codes decoded from them are still reported without being
+   decoded again.*/
+#define QR_REUSE_TOL (2)
+
+/*The number of samples taken along each side of a code's bounding box for the
+   signature used to notice that it was replaced by another code in the same
+   place, and the number of samples that may differ for it to be the same.*/
+#define QR_SIG_NSAMPLES (16)
+#define QR_SIG_BYTES    (QR_SIG_NSAMPLES*QR_SIG_NSAMPLES>>3)
+#define QR_SIG_TOL      (QR_SIG_NSAMPLES*QR_SIG_NSAMPLES>>3)
+
+/*When an image is scanned in strips, codes are searched for in windows around
+   groups of finder centers.
+  The largest distance between two finder centers of the same code (version
+   40), and the margin around the centers (half a finder pattern plus the quiet
+   zone), both in modules.*/
+#define QR_STRIP_SPAN   (170)
+#define QR_STRIP_MARGIN (8)
+
+
 /* collection of finder lines */
 typedef struct qr_finder_lines {
     qr_finder_line *lines;
@@ -61,6 +92,22 @@ typedef struct qr_finder_lines {
 } qr_finder_lines;
 
 
+/*A code located in a previous frame.
+  When tracking is enabled, we first try to sample it again in (nearly) the
+   same place, skipping the search for finder patterns, the homography fit,
+   and the version and format information decoding.*/
+struct qr_tracked_code{
+  /*The finder centers, in the order they were passed to qr_code_decode().*/
+  qr_point pos[3];
+  /*The corners of the code projected by the fitted homography.*/
+  qr_point bbox[4];
+  /*The (decoded) version number.*/
+  int      version;
+  /*The decoded format info (ECC level and mask).*/
+  int      fmt_info;
+};
+
+
 struct qr_reader {
     /*The GF(256) representation used in Reed-Solomon decoding.*/
     rs_gf256  gf;
@@ -68,6 +115,22 @@ struct qr_reader {
     isaac_ctx isaac;
     /* current finder state, horizontal and vertical lines */
     qr_finder_lines finder_lines[2];
+    /* character set converters, opened on demand */
+    qr_iconv_cache iconv_cache;
+    /* codes located in the previous frame, if tracking is enabled */
+    int tracking;
+    qr_tracked_code tracked[QR_TRACK_MAX];
+    int ntracked;
+    int track_frames;   /* frames decoded since the last full search */
+    /* finder centers and decoded codes of the last frame with results */
+    qr_point *last_centers;
+    int nlast_centers, clast_centers;
+    qr_code_data_list last_qrlist;
+    unsigned char (*last_sigs)[QR_SIG_BYTES];
+    unsigned long last_time;    /* scan time of the last actual decode */
+    /* corners of the codes already decoded from earlier strips */
+    qr_point (*strip_bbox)[4];
+    int nstrip_bbox, cstrip_bbox;
 };
 
 
@@ -79,6 +142,7 @@ static void qr_reader_init (qr_reader *reader)
       isaac_init(&_reader->isaac,&now,sizeof(now));*/
     isaac_init(&reader->isaac, NULL, 0);
     rs_gf256_init(&reader->gf, QR_PPOLY);
+    qr_iconv_cache_init(&reader->iconv_cache);
 }
 
 /*Allocates a client reader handle.*/
@@ -99,14 +163,39 @@ void _zbar_qr_destroy (qr_reader *reader)
         free(reader->finder_lines[0].lines);
     if(reader->finder_lines[1].lines)
         free(reader->finder_lines[1].lines);
+    if(reader->last_centers)
+        free(reader->last_centers);
+    if(reader->last_sigs)
+        free(reader->last_sigs);
+    if(reader->strip_bbox)
+        free(reader->strip_bbox);
+    qr_code_data_list_clear(&reader->last_qrlist);
+    qr_iconv_cache_clear(&reader->iconv_cache);
     free(reader);
 }
 
+/* enable or disable tracking of codes between frames */
+void _zbar_qr_set_tracking (qr_reader *reader,
+                            int enable)
+{
+    reader->tracking = (enable != 0);
+    reader->ntracked = 0;
+}
+
+/* drop the codes remembered from earlier scans */
+void _zbar_qr_forget (qr_reader *reader)
+{
+    reader->ntracked = 0;
+    if(reader->last_qrlist.nqrdata)
+        qr_code_data_list_clear(&reader->last_qrlist);
+}
+
 /* reset finder state between scans */
 void _zbar_qr_reset (qr_reader *reader)
 {
     reader->finder_lines[0].nlines = 0;
     reader->finder_lines[1].nlines = 0;
+    reader->nstrip_bbox = 0;
 }
 
 
@@ -3643,10 +3732,12 @@ static int qr_code_decode(qr_code_data *_qrdata,const rs_gf256 *_gf,
 /*Searches for an arrangement of these three finder centers that yields a valid
    configuration.
   _c: On input, the three finder centers to consider in any order.
+  _track: Returns the location, version and format info of the code, if one
+   was found, so that it can be tracked into the next frame.
   Return: The detected version number, or a negative value on error.*/
 static int qr_reader_try_configuration(qr_reader *_reader,
- qr_code_data *_qrdata,const unsigned char *_img,int _width,int _height,
- qr_finder_center *_c[3]){
+ qr_code_data *_qrdata,qr_tracked_code *_track,
+ const unsigned char *_img,int _width,int _height,qr_finder_center *_c[3]){
   int      ci[7];
   unsigned maxd;
   int      ccw;
@@ -3844,6 +3935,12 @@ static int qr_reader_try_configuration(qr_reader *_reader,
       continue;
     }
     fmt_info=qr_finder_fmt_info_decode(&ul,&ur,&dl,&hom,_img,_width,_height);
+    if(fmt_info>=0){
+      memcpy(_track->pos[0],ul.c->pos,sizeof(_track->pos[0]));
+      memcpy(_track->pos[1],ur.c->pos,sizeof(_track->pos[1]));
+      memcpy(_track->pos[2],dl.c->pos,sizeof(_track->pos[2]));
+      memcpy(_track->bbox,bbox,sizeof(bbox));
+    }
     if(fmt_info<0||
      qr_code_decode(_qrdata,&_reader->gf,ul.c->pos,ur.c->pos,dl.c->pos,
      ur_version,fmt_info,_img,_width,_height)<0){
@@ -3871,16 +3968,161 @@ static int qr_reader_try_configuration(qr_reader *_reader,
       QR_SWAP2I(bbox[1][0],bbox[2][0]);
       QR_SWAP2I(bbox[1][1],bbox[2][1]);
       memcpy(_qrdata->bbox,bbox,sizeof(bbox));
+      memcpy(_track->pos[0],ul.c->pos,sizeof(_track->pos[0]));
+      memcpy(_track->pos[1],dl.c->pos,sizeof(_track->pos[1]));
+      memcpy(_track->pos[2],ur.c->pos,sizeof(_track->pos[2]));
+      memcpy(_track->bbox,bbox,sizeof(bbox));
       if(qr_code_decode(_qrdata,&_reader->gf,ul.c->pos,dl.c->pos,ur.c->pos,
        ur_version,fmt_info,_img,_width,_height)<0){
         continue;
       }
     }
+    _track->version=ur_version;
+    _track->fmt_info=fmt_info;
     return ur_version;
   }
   return -1;
 }
 
+/*Re-estimates the position of a finder center using the finder lines found in
+   the current frame that cross it.
+  _q: Returns the new position.
+  _p: The position of the center in the previous frame.
+  _r: The maximum distance a line may be from _p and still be used.
+  Return: 0 on success, or a negative value if there were no lines in one of
+   the directions.*/
+static int qr_finder_center_refine(qr_point _q,const qr_point _p,
+ const qr_finder_lines _lines[2],int _r){
+  int dir;
+  for(dir=0;dir<2;dir++){
+    const qr_finder_lines *lines;
+    long long              sum;
+    int                    n;
+    int                    i;
+    lines=_lines+dir;
+    sum=n=0;
+    for(i=0;i<lines->nlines;i++){
+      const qr_finder_line *l;
+      int                   u;
+      l=lines->lines+i;
+      /*Twice the midpoint of the line, as in qr_finder_find_crossings().*/
+      u=(l->pos[dir]<<1)+l->len;
+      if(l->boffs>0&&l->eoffs>0)u+=l->eoffs-l->boffs;
+      if(abs(u-(_p[dir]<<1))<=_r<<1&&abs(l->pos[1-dir]-_p[1-dir])<=_r){
+        sum+=u;
+        n++;
+      }
+    }
+    if(n<1)return -1;
+    _q[dir]=(int)((sum+n)/(n<<1));
+  }
+  return 0;
+}
+
+/*Moves a tracked code to follow its finder centers in the current frame.
+  The corners of the code are carried along by the affine transform that maps
+   the old finder centers onto the new ones.
+  Return: 0 on success, or a negative value if any of the centers could not be
+   found.*/
+static int qr_tracked_code_refine(qr_tracked_code *_dst,
+ const qr_tracked_code *_src,const qr_finder_lines _lines[2]){
+  long long det;
+  int       ux;
+  int       uy;
+  int       vx;
+  int       vy;
+  int       r;
+  int       i;
+  ux=_src->pos[1][0]-_src->pos[0][0];
+  uy=_src->pos[1][1]-_src->pos[0][1];
+  vx=_src->pos[2][0]-_src->pos[0][0];
+  vy=_src->pos[2][1]-_src->pos[0][1];
+  det=QR_EXTMUL(ux,vy,-QR_EXTMUL(uy,vx,0));
+  if(!det)return -1;
+  /*Search within about 3 modules of the old position.
+    The finder centers are (17+4*version)-7 modules apart.*/
+  r=3*qr_ihypot(ux,uy)/(10+(_src->version<<2));
+  for(i=0;i<3;i++){
+    if(qr_finder_center_refine(_dst->pos[i],_src->pos[i],_lines,r)<0){
+      return -1;
+    }
+  }
+  for(i=0;i<4;i++){
+    long long a;
+    long long b;
+    int       dx;
+    int       dy;
+    dx=_src->bbox[i][0]-_src->pos[0][0];
+    dy=_src->bbox[i][1]-_src->pos[0][1];
+    a=QR_EXTMUL(dx,vy,-QR_EXTMUL(dy,vx,0));
+    b=QR_EXTMUL(ux,dy,-QR_EXTMUL(uy,dx,0));
+    _dst->bbox[i][0]=_dst->pos[0][0]+(int)((a*(_dst->pos[1][0]-_dst->pos[0][0])
+     +b*(_dst->pos[2][0]-_dst->pos[0][0]))/det);
+    _dst->bbox[i][1]=_dst->pos[0][1]+(int)((a*(_dst->pos[1][1]-_dst->pos[0][1])
+     +b*(_dst->pos[2][1]-_dst->pos[0][1]))/det);
+  }
+  _dst->version=_src->version;
+  _dst->fmt_info=_src->fmt_info;
+  return 0;
+}
+
+static int qr_tracked_code_decode(qr_code_data *_qrdata,const rs_gf256 *_gf,
+ const qr_tracked_code *_track,
+ const unsigned char *_img,int _width,int _height){
+  memcpy(_qrdata->bbox,_track->bbox,sizeof(_qrdata->bbox));
+  return qr_code_decode(_qrdata,_gf,_track->pos[0],_track->pos[1],
+   _track->pos[2],_track->version,_track->fmt_info,_img,_width,_height);
+}
+
+/*Decodes the codes found in the previous frame by sampling them directly,
+   after adjusting their location to follow any small motion.
+  Return: 0 if all of the tracked codes were decoded, or a negative value if
+   any of them were not, in which case a full search is required.*/
+static int qr_reader_track(qr_reader *_reader,qr_code_data_list *_qrlist,
+ const unsigned char *_img,int _width,int _height){
+  int i;
+  for(i=0;i<_reader->ntracked;i++){
+    qr_tracked_code *track;
+    qr_tracked_code  refined;
+    qr_code_data     qrdata;
+    int              l;
+    track=_reader->tracked+i;
+    if(qr_tracked_code_refine(&refined,track,_reader->finder_lines)>=0&&
+     qr_tracked_code_decode(&qrdata,&_reader->gf,&refined,
+     _img,_width,_height)>=0){
+      *track=refined;
+    }
+    else if(qr_tracked_code_decode(&qrdata,&_reader->gf,track,
+     _img,_width,_height)<0){
+      return -1;
+    }
+    qr_code_data_list_add(_qrlist,&qrdata);
+    for(l=0;l<4;l++){
+      _qrlist->qrdata[_qrlist->nqrdata-1].bbox[l][0]>>=QR_FINDER_SUBPREC;
+      _qrlist->qrdata[_qrlist->nqrdata-1].bbox[l][1]>>=QR_FINDER_SUBPREC;
+    }
+  }
+  return 0;
+}
+
+/*Returns whether a point lies inside the bounding box of any of the codes in
+   the list.*/
+static int qr_code_data_list_covers(const qr_code_data_list *_qrlist,
+ const qr_point _p){
+  int i;
+  for(i=0;i<_qrlist->nqrdata;i++){
+    const qr_point *bbox;
+    bbox=_qrlist->qrdata[i].bbox;
+    if(qr_point_ccw(bbox[0],bbox[1],_p)>=0&&
+     qr_point_ccw(bbox[1],bbox[3],_p)>=0&&
+     qr_point_ccw(bbox[3],bbox[2],_p)>=0&&
+     qr_point_ccw(bbox[2],bbox[0],_p)>=0){
+      return 1;
+    }
+  }
+  return 0;
+}
+
 void qr_reader_match_centers(qr_reader *_reader,qr_code_data_list *_qrlist,
  qr_finder_center *_centers,int _ncenters,
  const unsigned char *_img,int _width,int _height){
@@ -3903,17 +4145,22 @@ void qr_reader_match_centers(qr_reader *_reader,qr_code_data_list *_qrlist,
       for(k=j+1;!mark[j]&&k<_ncenters;k++)if(!mark[k]){
         qr_finder_center *c[3];
         qr_code_data      qrdata;
+        qr_tracked_code   track;
         int               version;
         c[0]=_centers+i;
         c[1]=_centers+j;
         c[2]=_centers+k;
-        version=qr_reader_try_configuration(_reader,&qrdata,
+        version=qr_reader_try_configuration(_reader,&qrdata,&track,
          _img,_width,_height,c);
         if(version>=0){
           int ninside;
           int l;
           /*Add the data to the list.*/
           qr_code_data_list_add(_qrlist,&qrdata);
+          /*Remember where it was, so we can look there first next time.*/
+          if(_reader->tracking&&_reader->ntracked<QR_TRACK_MAX){
+            _reader->tracked[_reader->ntracked++]=track;
+          }
           /*Convert the bounding box we're returning to the user to normal
              image coordinates.*/
           for(l=0;l<4;l++){
@@ -3998,17 +4245,141 @@ static inline void qr_svg_centers (const qr_finder_center *centers,
     svg_path_end();
 }
 
+/*Computes a coarse signature of the image inside a code's bounding box, moved
+   by (_dx,_dy) (in subpixels): one bit per sample, set where the sample is
+   darker than their average.*/
+static void qr_code_signature(unsigned char _sig[QR_SIG_BYTES],
+ const qr_point _bbox[4],int _dx,int _dy,
+ const unsigned char *_img,int _width,int _height){
+  unsigned char samples[QR_SIG_NSAMPLES*QR_SIG_NSAMPLES];
+  unsigned      mean;
+  int           n;
+  int           i;
+  int           j;
+  n=QR_SIG_NSAMPLES<<1;
+  mean=0;
+  for(i=0;i<QR_SIG_NSAMPLES;i++){
+    int v;
+    v=2*i+1;
+    for(j=0;j<QR_SIG_NSAMPLES;j++){
+      int u;
+      int x;
+      int y;
+      u=2*j+1;
+      x=((_bbox[0][0]*(n-u)+_bbox[1][0]*u)*(n-v)+
+       (_bbox[2][0]*(n-u)+_bbox[3][0]*u)*v)/(n*n)+
+       (_dx>>QR_FINDER_SUBPREC);
+      y=((_bbox[0][1]*(n-u)+_bbox[1][1]*u)*(n-v)+
+       (_bbox[2][1]*(n-u)+_bbox[3][1]*u)*v)/(n*n)+
+       (_dy>>QR_FINDER_SUBPREC);
+      x=QR_CLAMPI(0,x,_width-1);
+      y=QR_CLAMPI(0,y,_height-1);
+      samples[i*QR_SIG_NSAMPLES+j]=_img[y*_width+x];
+      mean+=_img[y*_width+x];
+    }
+  }
+  mean/=QR_SIG_NSAMPLES*QR_SIG_NSAMPLES;
+  memset(_sig,0,QR_SIG_BYTES*sizeof(*_sig));
+  for(i=0;i<QR_SIG_NSAMPLES*QR_SIG_NSAMPLES;i++){
+    if(samples[i]<mean)_sig[i>>3]|=(unsigned char)(1<<(i&7));
+  }
+}
+
+/*Checks whether the last decoded codes can be reported again for this frame:
+   the finder centers located in it must be (nearly) the same as those the
+   codes were found from, and the image inside each code (following the small
+   motion of the centers) must look the same.*/
+static int qr_reader_results_match(const qr_reader *_reader,
+ const qr_finder_center *_centers,int _ncenters,
+ const unsigned char *_img,int _width,int _height,int _fx,int _fy){
+  unsigned char sig[QR_SIG_BYTES];
+  int           tol;
+  int           dx;
+  int           dy;
+  int           i;
+  int           j;
+  if(_ncenters<=0||_ncenters!=_reader->nlast_centers)return 0;
+  tol=QR_REUSE_TOL<<QR_FINDER_SUBPREC;
+  dx=dy=0;
+  for(i=0;i<_ncenters;i++){
+    for(j=0;j<_ncenters;j++){
+      if(abs(_centers[i].pos[0]-_reader->last_centers[j][0])<=tol&&
+       abs(_centers[i].pos[1]-_reader->last_centers[j][1])<=tol){
+        break;
+      }
+    }
+    if(j>=_ncenters)return 0;
+    dx+=_centers[i].pos[0]-_reader->last_centers[j][0];
+    dy+=_centers[i].pos[1]-_reader->last_centers[j][1];
+  }
+  dx/=_ncenters;
+  dy/=_ncenters;
+  /*The saved codes are located in the full video frame.*/
+  dx-=_fx<<QR_FINDER_SUBPREC;
+  dy-=_fy<<QR_FINDER_SUBPREC;
+  for(i=0;i<_reader->last_qrlist.nqrdata;i++){
+    int ndiff;
+    qr_code_signature(sig,_reader->last_qrlist.qrdata[i].bbox,dx,dy,
+     _img,_width,_height);
+    ndiff=0;
+    for(j=0;j<QR_SIG_BYTES;j++){
+      unsigned c;
+      for(c=sig[j]^_reader->last_sigs[i][j];c;c&=c-1)ndiff++;
+    }
+    zprintf(14, "QR code %d signature differs in %d samples\n", i, ndiff);
+    if(ndiff>QR_SIG_TOL)return 0;
+  }
+  return 1;
+}
+
+/*Remembers the codes decoded in this frame (taking over the contents of
+   _qrlist) along with the finder centers they were found from.*/
+static void qr_reader_save_results(qr_reader *_reader,
+ qr_code_data_list *_qrlist,const qr_finder_center *_centers,int _ncenters,
+ const unsigned char *_img,int _width,int _height,int _fx,int _fy,
+ unsigned long _time){
+  int i;
+  qr_code_data_list_clear(&_reader->last_qrlist);
+  _reader->last_qrlist=*_qrlist;
+  qr_code_data_list_init(_qrlist);
+  _reader->last_sigs=(unsigned char (*)[QR_SIG_BYTES])realloc(
+   _reader->last_sigs,_reader->last_qrlist.nqrdata*sizeof(*_reader->last_sigs));
+  for(i=0;i<_reader->last_qrlist.nqrdata;i++){
+    qr_code_signature(_reader->last_sigs[i],
+     _reader->last_qrlist.qrdata[i].bbox,-(_fx<<QR_FINDER_SUBPREC),
+     -(_fy<<QR_FINDER_SUBPREC),_img,_width,_height);
+  }
+  if(_ncenters>_reader->clast_centers){
+    _reader->clast_centers=_ncenters;
+    _reader->last_centers=(qr_point *)realloc(_reader->last_centers,
+     _ncenters*sizeof(*_reader->last_centers));
+  }
+  for(i=0;i<_ncenters;i++){
+    _reader->last_centers[i][0]=_centers[i].pos[0];
+    _reader->last_centers[i][1]=_centers[i].pos[1];
+  }
+  _reader->nlast_centers=_ncenters;
+  _reader->last_time=_time;
+}
+
 int _zbar_qr_decode (qr_reader *reader,
                      zbar_image_scanner_t *iscn,
                      zbar_image_t *img)
 {
-    int nqrdata = 0, ncenters;
+    int nqrdata = 0, ncenters, i;
     qr_finder_edge_pt *edge_pts = NULL;
     qr_finder_center *centers = NULL;
+    qr_code_data_list qrlist;
+    void *bin = NULL;
+    int fx, fy;
 
     if(reader->finder_lines[0].nlines < 9 ||
-       reader->finder_lines[1].nlines < 9)
+       reader->finder_lines[1].nlines < 9) {
+        reader->ntracked = 0;
+        if(reader->last_qrlist.nqrdata)
+            qr_code_data_list_clear(&reader->last_qrlist);
         return(0);
+    }
 
     svg_group_start("finder", 0, 1. / (1 << QR_FINDER_SUBPREC), 0, 0, 0);
 
@@ -4020,26 +4391,337 @@ int _zbar_qr_decode (qr_reader *reader,
             ncenters);
     qr_svg_centers(centers, ncenters);
 
-    if(ncenters >= 3) {
-        void *bin = qr_binarize(img->data, img->width, img->height);
+    qr_code_data_list_init(&qrlist);
+    _zbar_image_scanner_get_frame(iscn, &fx, &fy);
+
+    /* nothing moved since the last decode: report the same codes again */
+    if(reader->last_qrlist.nqrdata &&
+       _zbar_image_scanner_cache_fresh(iscn, reader->last_time) &&
+       qr_reader_results_match(reader, centers, ncenters,
+                               img->data, img->width, img->height,
+                               fx, fy)) {
+        zprintf(14, "reusing %d QR codes\n", reader->last_qrlist.nqrdata);
+        nqrdata = qr_code_data_list_extract_text(&reader->last_qrlist,
+                                                 &reader->iconv_cache,
+                                                 iscn, img);
+    }
+    else {
+        /* try to pick up where the codes were last time */
+        if(reader->ntracked && reader->track_frames < QR_TRACK_REDETECT) {
+            bin = qr_binarize(img->data, img->width, img->height);
+            if(qr_reader_track(reader, &qrlist, bin,
+                               img->width, img->height)) {
+                zprintf(14, "lost %d tracked QR codes\n", reader->ntracked);
+                qr_code_data_list_clear(&qrlist);
+            }
+            else
+                reader->track_frames++;
+        }
+
+        if(!qrlist.nqrdata) {
+            reader->ntracked = 0;
+            reader->track_frames = 0;
 
-        qr_code_data_list qrlist;
-        qr_code_data_list_init(&qrlist);
+            if(ncenters >= 3) {
+                if(!bin)
+                    bin = qr_binarize(img->data, img->width, img->height);
 
-        qr_reader_match_centers(reader, &qrlist, centers, ncenters,
-                                bin, img->width, img->height);
+                qr_reader_match_centers(reader, &qrlist, centers, ncenters,
+                                        bin, img->width, img->height);
+            }
+        }
 
-        if(qrlist.nqrdata > 0)
-            nqrdata = qr_code_data_list_extract_text(&qrlist, iscn, img);
+        if(qrlist.nqrdata > 0) {
+            int j;
+            /* report positions in the root image */
+            for(i = 0; i < qrlist.nqrdata; i++)
+                for(j = 0; j < 4; j++)
+                    _zbar_image_scanner_map_point(iscn,
+                                                  &qrlist.qrdata[i].bbox[j][0],
+                                                  &qrlist.qrdata[i].bbox[j][1]);
+            nqrdata = qr_code_data_list_extract_text(&qrlist,
+                                                     &reader->iconv_cache,
+                                                     iscn, img);
+            qr_reader_save_results(reader, &qrlist, centers, ncenters,
+                                   img->data, img->width, img->height,
+                                   fx, fy, _zbar_image_scanner_get_time(iscn));
+        }
+        else if(reader->last_qrlist.nqrdata)
+            qr_code_data_list_clear(&reader->last_qrlist);
+    }
 
-        qr_code_data_list_clear(&qrlist);
-        free(bin);
+    /* finder patterns that are not part of a code found here may belong
+     * to one too small for this scale
+     */
+    for(i = 0; i < ncenters; i++) {
+        qr_point p;
+        p[0] = centers[i].pos[0] >> QR_FINDER_SUBPREC;
+        p[1] = centers[i].pos[1] >> QR_FINDER_SUBPREC;
+        _zbar_image_scanner_map_point(iscn, &p[0], &p[1]);
+        if(!qr_code_data_list_covers(&reader->last_qrlist, p))
+            _zbar_image_scanner_add_hit(iscn, p[0], p[1]);
     }
     svg_group_end();
 
+    qr_code_data_list_clear(&qrlist);
+    if(bin)
+        free(bin);
     if(centers)
         free(centers);
     if(edge_pts)
         free(edge_pts);
     return(nqrdata);
 }
+
+/* drop the lines that end above row y before scanning a strip starting
+ * there: they can't be part of a code the strip still has pixels for
+ */
+void _zbar_qr_trim_lines (qr_reader *reader,
+                          int y)
+{
+    qr_finder_lines *lines;
+    int i, n;
+    y <<= QR_FINDER_SUBPREC;
+
+    lines = &reader->finder_lines[0];
+    for(i = n = 0; i < lines->nlines; i++)
+        if(lines->lines[i].pos[1] >= y)
+            lines->lines[n++] = lines->lines[i];
+    lines->nlines = n;
+
+    lines = &reader->finder_lines[1];
+    for(i = n = 0; i < lines->nlines; i++) {
+        const qr_finder_line *line = lines->lines + i;
+        if(line->pos[1] + line->len + line->eoffs >= y)
+            lines->lines[n++] = *line;
+    }
+    lines->nlines = n;
+}
+
+/*Searches one window of a strip for codes, given the finder centers (in image
+   coordinates) that lie inside it.
+  _data points to the top row of the window, at image position (_x0,_y0).
+  Only the window is copied out and binarized; the corners of any codes found
+   are translated back to image coordinates.
+  Return: 0 on success, or -1 if the window could not be allocated.*/
+static int qr_reader_match_window(qr_reader *_reader,
+ qr_code_data_list *_qrlist,qr_finder_center *_centers,int _ncenters,
+ const unsigned char *_data,int _stride,int _x0,int _y0,int _width,
+ int _height){
+  unsigned char *win;
+  unsigned char *bin;
+  int            dx;
+  int            dy;
+  int            i;
+  int            j;
+  win=(unsigned char *)malloc(_width*_height*sizeof(*win));
+  if(win==NULL)return -1;
+  for(j=0;j<_height;j++){
+    memcpy(win+j*_width,_data+j*(size_t)_stride+_x0,_width);
+  }
+  /*Each center belongs to exactly one window, so its edge points can be
+     moved in place.*/
+  dx=_x0<<QR_FINDER_SUBPREC;
+  dy=_y0<<QR_FINDER_SUBPREC;
+  for(i=0;i<_ncenters;i++){
+    _centers[i].pos[0]-=dx;
+    _centers[i].pos[1]-=dy;
+    for(j=0;j<_centers[i].nedge_pts;j++){
+      _centers[i].edge_pts[j].pos[0]-=dx;
+      _centers[i].edge_pts[j].pos[1]-=dy;
+    }
+  }
+  bin=qr_binarize(win,_width,_height);
+  free(win);
+  if(bin==NULL)return -1;
+  i=_qrlist->nqrdata;
+  qr_reader_match_centers(_reader,_qrlist,_centers,_ncenters,
+   bin,_width,_height);
+  for(;i<_qrlist->nqrdata;i++){
+    for(j=0;j<4;j++){
+      _qrlist->qrdata[i].bbox[j][0]+=_x0;
+      _qrlist->qrdata[i].bbox[j][1]+=_y0;
+    }
+  }
+  free(bin);
+  return 0;
+}
+
+/*Checks whether a code was already decoded from an earlier strip (it was in
+   the overlap between the two), and remembers it otherwise.*/
+static int qr_reader_strip_seen(qr_reader *_reader,const qr_point _bbox[4]){
+  int cx;
+  int cy;
+  int tol;
+  int i;
+  cx=_bbox[0][0]+_bbox[1][0]+_bbox[2][0]+_bbox[3][0];
+  cy=_bbox[0][1]+_bbox[1][1]+_bbox[2][1]+_bbox[3][1];
+  /*A quarter of the code size (the sums are of four corners).*/
+  tol=QR_MAXI(abs(_bbox[1][0]-_bbox[0][0]),abs(_bbox[1][1]-_bbox[0][1]));
+  tol=QR_MAXI(tol,4*QR_REUSE_TOL);
+  for(i=0;i<_reader->nstrip_bbox;i++){
+    qr_point *b;
+    b=_reader->strip_bbox[i];
+    if(abs(b[0][0]+b[1][0]+b[2][0]+b[3][0]-cx)<=tol&&
+     abs(b[0][1]+b[1][1]+b[2][1]+b[3][1]-cy)<=tol){
+      return 1;
+    }
+  }
+  if(_reader->nstrip_bbox>=_reader->cstrip_bbox){
+    qr_point (*strip_bbox)[4];
+    int       cstrip_bbox;
+    cstrip_bbox=_reader->cstrip_bbox<<1|1;
+    strip_bbox=(qr_point (*)[4])realloc(_reader->strip_bbox,
+     cstrip_bbox*sizeof(*strip_bbox));
+    /*Without room to remember it, a code in the next overlap may be
+       reported twice.*/
+    if(strip_bbox==NULL)return 0;
+    _reader->strip_bbox=strip_bbox;
+    _reader->cstrip_bbox=cstrip_bbox;
+  }
+  memcpy(_reader->strip_bbox[_reader->nstrip_bbox++],_bbox,
+   sizeof(*_reader->strip_bbox));
+  return 0;
+}
+
+int _zbar_qr_decode_strip (qr_reader *reader,
+                           zbar_image_scanner_t *iscn,
+                           zbar_image_t *img,
+                           const unsigned char *data,
+                           int y0,
+                           int rows)
+{
+    int nqrdata = 0, ncenters, i, j, k;
+    qr_finder_edge_pt *edge_pts = NULL;
+    qr_finder_center *centers = NULL, *group = NULL;
+    int *size, *label;
+    qr_code_data_list qrlist;
+
+    /* positions of codes tracked in one window mean nothing in the next */
+    reader->ntracked = 0;
+
+    if(reader->finder_lines[0].nlines < 9 ||
+       reader->finder_lines[1].nlines < 9)
+        return(0);
+
+    ncenters = qr_finder_centers_locate(&centers, &edge_pts, reader, 0, 0);
+    zprintf(14, "strip @%d: %dx%d finders, %d centers\n", y0,
+            reader->finder_lines[0].nlines,
+            reader->finder_lines[1].nlines,
+            ncenters);
+    if(ncenters < 3) {
+        if(centers)
+            free(centers);
+        if(edge_pts)
+            free(edge_pts);
+        return(0);
+    }
+
+    /* estimate module size from the finder edges (~3 modules from the
+     * center), rounding up so windows err on the large side
+     */
+    size = malloc(ncenters * sizeof(*size));
+    label = malloc(ncenters * sizeof(*label));
+    if(!size || !label) {
+        nqrdata = -1;
+        goto done;
+    }
+    for(i = 0; i < ncenters; i++) {
+        const qr_finder_center *c = centers + i;
+        int m = 0;
+        for(j = 0; j < c->nedge_pts; j++) {
+            m = QR_MAXI(m, abs(c->edge_pts[j].pos[0] - c->pos[0]));
+            m = QR_MAXI(m, abs(c->edge_pts[j].pos[1] - c->pos[1]));
+        }
+        size[i] = (m >> 1) + 1;
+        label[i] = i;
+    }
+
+    /* group centers that may belong to the same code */
+    for(i = 0; i < ncenters; i++)
+        for(j = i + 1; j < ncenters; j++) {
+            int span = QR_STRIP_SPAN * QR_MAXI(size[i], size[j]);
+            int li = label[i], lj = label[j];
+            if(li == lj ||
+               abs(centers[i].pos[0] - centers[j].pos[0]) > span ||
+               abs(centers[i].pos[1] - centers[j].pos[1]) > span)
+                continue;
+            if(li > lj) {
+                int tmp = li;
+                li = lj;
+                lj = tmp;
+            }
+            for(k = 0; k < ncenters; k++)
+                if(label[k] == lj)
+                    label[k] = li;
+        }
+
+    group = malloc(ncenters * sizeof(*group));
+    if(!group) {
+        nqrdata = -1;
+        goto done;
+    }
+    qr_code_data_list_init(&qrlist);
+    for(i = 0; i < ncenters; i++) {
+        int n = 0, x0 = INT_MAX, x1 = INT_MIN, wy0 = INT_MAX, wy1 = INT_MIN;
+        if(label[i] != i)
+            continue;
+        for(j = i; j < ncenters; j++)
+            if(label[j] == i) {
+                int m = QR_STRIP_MARGIN * size[j];
+                x0 = QR_MINI(x0, centers[j].pos[0] - m);
+                x1 = QR_MAXI(x1, centers[j].pos[0] + m);
+                wy0 = QR_MINI(wy0, centers[j].pos[1] - m);
+                wy1 = QR_MAXI(wy1, centers[j].pos[1] + m);
+                group[n++] = centers[j];
+            }
+        if(n < 3)
+            continue;
+
+        /* window in pixels, clipped to the strip */
+        x0 = QR_MAXI(x0 >> QR_FINDER_SUBPREC, 0);
+        x1 = QR_MINI((x1 >> QR_FINDER_SUBPREC) + 1, (int)img->width);
+        wy0 = QR_MAXI(wy0 >> QR_FINDER_SUBPREC, y0);
+        wy1 = QR_MINI((wy1 >> QR_FINDER_SUBPREC) + 1, y0 + rows);
+        /* smallest (version 1) code is 21 modules */
+        if(x1 - x0 < 21 || wy1 - wy0 < 21)
+            continue;
+
+        zprintf(14, "  window %d,%d %dx%d: %d centers\n",
+                x0, wy0, x1 - x0, wy1 - wy0, n);
+        if(qr_reader_match_window(reader, &qrlist, group, n,
+                                  data + (wy0 - y0) * (long)img->width,
+                                  img->width,
+                                  x0, wy0, x1 - x0, wy1 - wy0)) {
+            nqrdata = -1;
+            break;
+        }
+    }
+
+    /* codes in the overlap w/the previous strip were reported already */
+    for(i = 0; i < qrlist.nqrdata; )
+        if(qr_reader_strip_seen(reader,
+                                (const qr_point*)qrlist.qrdata[i].bbox)) {
+            qr_code_data_clear(qrlist.qrdata + i);
+            qrlist.qrdata[i] = qrlist.qrdata[--qrlist.nqrdata];
+        }
+        else
+            i++;
+
+    if(!nqrdata && qrlist.nqrdata > 0)
+        nqrdata = qr_code_data_list_extract_text(&qrlist,
+                                                 &reader->iconv_cache,
+                                                 iscn, img);
+
+    qr_code_data_list_clear(&qrlist);
+done:
+    if(group)
+        free(group);
+    if(label)
+        free(label);
+    if(size)
+        free(size);
+    free(centers);
+    free(edge_pts);
+    return(nqrdata);
+}
@@ -6,11 +6,13 @@
 #if !defined(_qrdec_H)
 # define _qrdec_H (1)
 
+#include <iconv.h>
 #include <zbar.h>
 
 typedef struct qr_code_data_entry qr_code_data_entry;
 typedef struct qr_code_data       qr_code_data;
 typedef struct qr_code_data_list  qr_code_data_list;
+typedef struct qr_iconv_cache     qr_iconv_cache;
 
 typedef enum qr_mode{
   /*Numeric digits ('0'...'9').*/
@@ -91,6 +93,20 @@ typedef enum qr_eci_encoding{
 }qr_eci_encoding;
 
 
+/*The number of ECI codes we may need a converter for.*/
+#define QR_NECI_CONVERTERS (QR_ECI_UTF8+1)
+
+/*A cache of character set converters to UTF-8, indexed by ECI code.
+  Converters are opened the first time they are needed and kept until the
+   cache is cleared, since iconv_open() is expensive with some C libraries.*/
+struct qr_iconv_cache{
+  iconv_t  cd[QR_NECI_CONVERTERS];
+  /*A bit mask of the converters we have already tried to open.*/
+  unsigned opened;
+};
+
+
+
 /*A single unit of parsed QR code data.*/
 struct qr_code_data_entry{
   /*The mode of this data block.*/
@@ -151,6 +167,12 @@ struct qr_code_data_list{
 };
 
 
+void qr_iconv_cache_init(qr_iconv_cache *_cache);
+void qr_iconv_cache_clear(qr_iconv_cache *_cache);
+
+void qr_code_data_list_init(qr_code_data_list *_qrlist);
+void qr_code_data_list_clear(qr_code_data_list *_qrlist);
+
 /*Extract symbol data from a list of QR codes and attach to the image.
   All text is converted to UTF-8.
   Any structured-append group that does not have all of its members is decoded
@@ -158,9 +180,11 @@ struct qr_code_data_list{
   Note that isolated members of a structured-append group may be decoded with
    the wrong character set, since the correct setting cannot be propagated
    between codes.
+  Character set converters are taken from (and added to) _cache.
   Return: The number of symbols which were successfully extracted from the
    codes; this will be at most the number of codes.*/
 int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
+                                   qr_iconv_cache *_cache,
                                    zbar_image_scanner_t *iscn,
                                    zbar_image_t *img);
 
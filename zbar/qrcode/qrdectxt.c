@@ -32,7 +32,40 @@ static int text_is_latin1(const unsigned char *_text,int _len){
   return 1;
 }
 
-static void enc_list_mtf(iconv_t _enc_list[3],iconv_t _enc){
+/*Checks that text is valid UTF-8.
+  Overlong forms, surrogates and code points beyond U+10FFFF are rejected, as
+   iconv() would.*/
+static int text_is_utf8(const unsigned char *_text,int _len){
+  int i;
+  for(i=0;i<_len;){
+    unsigned c;
+    unsigned lo;
+    unsigned hi;
+    int      n;
+    c=_text[i++];
+    if(c<0x80)continue;
+    lo=0x80;
+    hi=0xBF;
+    if(c<0xC2)return 0;
+    else if(c<0xE0)n=1;
+    else if(c<0xF0){
+      n=2;
+      if(c==0xE0)lo=0xA0;
+      else if(c==0xED)hi=0x9F;
+    }
+    else if(c<0xF5){
+      n=3;
+      if(c==0xF0)lo=0x90;
+      else if(c==0xF4)hi=0x8F;
+    }
+    else return 0;
+    if(_len-i<n||_text[i]<lo||_text[i]>hi)return 0;
+    for(i++;--n>0;i++)if((_text[i]&0xC0)!=0x80)return 0;
+  }
+  return 1;
+}
+
+static void enc_list_mtf(int _enc_list[3],int _enc){
   int i;
   for(i=0;i<3;i++)if(_enc_list[i]==_enc){
     int j;
@@ -42,13 +75,108 @@ static void enc_list_mtf(iconv_t _enc_list[3],iconv_t _enc){
   }
 }
 
+/*Returns the name iconv uses for the character set signaled by an ECI code,
+   or NULL if it is not one we recognize.*/
+static const char *qr_eci_charset(unsigned _eci,char _buf[16]){
+  if(_eci<=QR_ECI_ISO8859_16&&_eci!=14){
+    if(_eci!=QR_ECI_GLI0&&_eci!=QR_ECI_CP437){
+      sprintf(_buf,"ISO8859-%i",QR_MAXI(_eci,3)-2);
+      return _buf;
+    }
+    /*Note that CP437 requires an iconv compiled with
+       --enable-extra-encodings, and thus may not be available.*/
+    else return "CP437";
+  }
+  else if(_eci==QR_ECI_SJIS)return "SJIS";
+  else if(_eci==QR_ECI_UTF8)return "UTF-8";
+  return NULL;
+}
+
+void qr_iconv_cache_init(qr_iconv_cache *_cache){
+  int i;
+  for(i=0;i<QR_NECI_CONVERTERS;i++)_cache->cd[i]=(iconv_t)-1;
+  _cache->opened=0;
+}
+
+void qr_iconv_cache_clear(qr_iconv_cache *_cache){
+  int i;
+  for(i=0;i<QR_NECI_CONVERTERS;i++){
+    if(_cache->cd[i]!=(iconv_t)-1)iconv_close(_cache->cd[i]);
+  }
+  qr_iconv_cache_init(_cache);
+}
+
+/*Returns a converter from the character set for the given ECI code to UTF-8,
+   opening it if this is the first time it has been requested.
+  The converter is reset to its initial shift state before it is returned.*/
+static iconv_t qr_iconv_cache_get(qr_iconv_cache *_cache,unsigned _eci){
+  iconv_t cd;
+  /*The GLI encodings only differ in how they are reset between codes.*/
+  if(_eci==QR_ECI_GLI0)_eci=QR_ECI_CP437;
+  else if(_eci==QR_ECI_GLI1)_eci=QR_ECI_ISO8859_1;
+  if(_eci>=QR_NECI_CONVERTERS)return (iconv_t)-1;
+  if(!(_cache->opened&1U<<_eci)){
+    const char *enc;
+    char        buf[16];
+    _cache->opened|=1U<<_eci;
+    enc=qr_eci_charset(_eci,buf);
+    if(enc!=NULL)_cache->cd[_eci]=iconv_open("UTF-8",enc);
+  }
+  cd=_cache->cd[_eci];
+  if(cd!=(iconv_t)-1)iconv(cd,NULL,NULL,NULL,NULL);
+  return cd;
+}
+
+/*Converts text in the character set for the given ECI code to UTF-8.
+  UTF-8 input (including plain ASCII) is validated and copied directly,
+   without going through iconv().
+  Return: 0 on success, or a non-zero value if the text could not be
+   converted or did not fit in the output buffer.*/
+static int qr_iconv_convert(qr_iconv_cache *_cache,unsigned _eci,
+ char **_in,size_t *_inleft,char **_out,size_t *_outleft){
+  iconv_t cd;
+  if(_eci==QR_ECI_UTF8){
+    if(*_inleft>*_outleft||!text_is_utf8((unsigned char *)*_in,*_inleft)){
+      return -1;
+    }
+    memcpy(*_out,*_in,*_inleft);
+    *_in+=*_inleft;
+    *_out+=*_inleft;
+    *_outleft-=*_inleft;
+    *_inleft=0;
+    return 0;
+  }
+  cd=qr_iconv_cache_get(_cache,_eci);
+  return cd==(iconv_t)-1||
+   iconv(cd,_in,_inleft,_out,_outleft)==(size_t)-1;
+}
+
+/*Hands the segments of an incomplete S-A group over to the image scanner,
+   which holds on to them across images.
+  Return: The composite symbol for the whole group if this completed it (the
+   partial _sa_sym is recycled), or _sa_sym itself otherwise.*/
+static zbar_symbol_t *qr_sa_reassemble(zbar_image_scanner_t *iscn,
+ zbar_symbol_t *_sa_sym,const int *_sa,int _sa_size,unsigned _sa_parity){
+  zbar_symbol_t *sym;
+  zbar_symbol_t *merged;
+  int            j;
+  merged=NULL;
+  for(j=0,sym=_sa_sym->syms->head;sym!=NULL&&merged==NULL;sym=sym->next){
+    if(sym->type==ZBAR_PARTIAL)continue;
+    while(_sa[j]<0)j++;
+    sym->modifiers=_sa_sym->modifiers;
+    merged=_zbar_image_scanner_add_part(iscn,sym,j++,_sa_size,_sa_parity);
+  }
+  if(merged==NULL)return _sa_sym;
+  _zbar_image_scanner_recycle_syms(iscn,_sa_sym);
+  return merged;
+}
+
 int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
+                                   qr_iconv_cache *_cache,
                                    zbar_image_scanner_t *iscn,
                                    zbar_image_t *img)
 {
-  iconv_t              sjis_cd;
-  iconv_t              utf8_cd;
-  iconv_t              latin1_cd;
   const qr_code_data  *qrdata;
   int                  nqrdata;
   unsigned char       *mark;
@@ -58,19 +186,13 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
   nqrdata=_qrlist->nqrdata;
   mark=(unsigned char *)calloc(nqrdata,sizeof(*mark));
   ntext=0;
-  /*This is the encoding the standard says is the default.*/
-  latin1_cd=iconv_open("UTF-8","ISO8859-1");
-  /*But this one is often used, as well.*/
-  sjis_cd=iconv_open("UTF-8","SJIS");
-  /*This is a trivial conversion just to check validity without extra code.*/
-  utf8_cd=iconv_open("UTF-8","UTF-8");
   for(i=0;i<nqrdata;i++)if(!mark[i]){
     const qr_code_data       *qrdataj;
     const qr_code_data_entry *entry;
-    iconv_t                   enc_list[3];
-    iconv_t                   eci_cd;
+    int                       enc_list[3];
     int                       sa[16];
     int                       sa_size;
+    unsigned                  sa_parity;
     char                     *sa_text;
     size_t                    sa_ntext;
     size_t                    sa_ctext;
@@ -87,7 +209,6 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
 
     /*Step 0: Collect the other QR codes belonging to this S-A group.*/
     if(qrdata[i].sa_size){
-      unsigned sa_parity;
       sa_size=qrdata[i].sa_size;
       sa_parity=qrdata[i].sa_parity;
       for(j=0;j<sa_size;j++)sa[j]=-1;
@@ -105,6 +226,7 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
     else{
       sa[0]=i;
       sa_size=1;
+      sa_parity=0;
     }
 
     sa_ctext=0;
@@ -160,10 +282,11 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
       else sa_text[sa_ntext++]=(char)(fnc1_2ai-100);
     }
     eci=-1;
-    enc_list[0]=sjis_cd;
-    enc_list[1]=latin1_cd;
-    enc_list[2]=utf8_cd;
-    eci_cd=(iconv_t)-1;
+    /*ISO8859-1 is the encoding the standard says is the default, but SJIS is
+       often used, as well.*/
+    enc_list[0]=QR_ECI_SJIS;
+    enc_list[1]=QR_ECI_ISO8859_1;
+    enc_list[2]=QR_ECI_UTF8;
     err=0;
     for(j = 0; j < sa_size && !err; j++, sym = &(*sym)->next) {
       *sym = _zbar_image_scanner_alloc_sym(iscn, ZBAR_QRCODE, 0);
@@ -179,11 +302,11 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
 
         /* mark break in data */
         sa_text[sa_ntext++]='\0';
-        (*sym)->datalen = sa_ntext;
 
         /* advance to next symbol */
         sym = &(*sym)->next;
         *sym = _zbar_image_scanner_alloc_sym(iscn, ZBAR_QRCODE, 0);
+        (*sym)->datalen = sa_ntext;
       }
 
       qrdataj=qrdata+sa[j];
@@ -264,7 +387,7 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
             if(eci<0){
               int ei;
               /*If there was data encoded in kanji mode, assume it's SJIS.*/
-              if(has_kanji)enc_list_mtf(enc_list,sjis_cd);
+              if(has_kanji)enc_list_mtf(enc_list,QR_ECI_SJIS);
               /*Otherwise check for the UTF-8 BOM.
                 UTF-8 is rarely specified with ECI, and few decoders
                  currently support doing so, so this is the best way for
@@ -274,11 +397,11 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
                 in+=3;
                 inleft-=3;
                 /*Actually try converting (to check validity).*/
-                err=utf8_cd==(iconv_t)-1||
-                 iconv(utf8_cd,&in,&inleft,&out,&outleft)==(size_t)-1;
+                err=qr_iconv_convert(_cache,QR_ECI_UTF8,
+                 &in,&inleft,&out,&outleft);
                 if(!err){
                   sa_ntext=out-sa_text;
-                  enc_list_mtf(enc_list,utf8_cd);
+                  enc_list_mtf(enc_list,QR_ECI_UTF8);
                   continue;
                 }
                 in=(char *)entry->payload.data.buf;
@@ -289,10 +412,10 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
               /*If the text is 8-bit clean, prefer UTF-8 over SJIS, since
                  SJIS will corrupt the backslashes used for DoCoMo formats.*/
               else if(text_is_ascii((unsigned char *)in,inleft)){
-                enc_list_mtf(enc_list,utf8_cd);
+                enc_list_mtf(enc_list,QR_ECI_UTF8);
               }
               /*Try our list of encodings.*/
-              for(ei=0;ei<3;ei++)if(enc_list[ei]!=(iconv_t)-1){
+              for(ei=0;ei<3;ei++){
                 /*According to the 2005 version of the standard,
                    ISO/IEC 8859-1 (one hyphen) is supposed to be used, but
                    reality is not always so (and in the 2000 version of the
@@ -304,13 +427,14 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
                    number of seldom-used control code characters there.
                   So if we see any of those characters, move this
                    conversion to the end of the list.*/
-                if(ei<2&&enc_list[ei]==latin1_cd&&
+                if(ei<2&&enc_list[ei]==QR_ECI_ISO8859_1&&
                  !text_is_latin1((unsigned char *)in,inleft)){
                   int ej;
                   for(ej=ei+1;ej<3;ej++)enc_list[ej-1]=enc_list[ej];
-                  enc_list[2]=latin1_cd;
+                  enc_list[2]=QR_ECI_ISO8859_1;
                 }
-                err=iconv(enc_list[ei],&in,&inleft,&out,&outleft)==(size_t)-1;
+                err=qr_iconv_convert(_cache,enc_list[ei],
+                 &in,&inleft,&out,&outleft);
                 if(!err){
                   sa_ntext=out-sa_text;
                   enc_list_mtf(enc_list,enc_list[ei]);
@@ -327,45 +451,27 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
                came from the given character set even when encoded in kanji
                mode.*/
             else{
-              err=eci_cd==(iconv_t)-1||
-               iconv(eci_cd,&in,&inleft,&out,&outleft)==(size_t)-1;
+              err=qr_iconv_convert(_cache,eci,&in,&inleft,&out,&outleft);
               if(!err)sa_ntext=out-sa_text;
             }
           }break;
           /*Check to see if a character set was specified.*/
           case QR_MODE_ECI:{
-            const char *enc;
-            char        buf[16];
-            unsigned    cur_eci;
+            char     buf[16];
+            unsigned cur_eci;
             cur_eci=entry->payload.eci;
-            if(cur_eci<=QR_ECI_ISO8859_16&&cur_eci!=14){
-              if(cur_eci!=QR_ECI_GLI0&&cur_eci!=QR_ECI_CP437){
-                sprintf(buf,"ISO8859-%i",QR_MAXI(cur_eci,3)-2);
-                enc=buf;
-              }
-              /*Note that CP437 requires an iconv compiled with
-                 --enable-extra-encodings, and thus may not be available.*/
-              else enc="CP437";
-            }
-            else if(cur_eci==QR_ECI_SJIS)enc="SJIS";
-            else if(cur_eci==QR_ECI_UTF8)enc="UTF-8";
             /*Don't know what this ECI code specifies, but not an encoding that
                we recognize.*/
-            else continue;
+            if(qr_eci_charset(cur_eci,buf)==NULL)continue;
             eci=cur_eci;
-            eci_cd=iconv_open("UTF-8",enc);
           }break;
           /*Silence stupid compiler warnings.*/
           default:break;
         }
       }
       /*If eci should be reset between codes, do so.*/
-      if(eci<=QR_ECI_GLI1){
-        eci=-1;
-        if(eci_cd!=(iconv_t)-1)iconv_close(eci_cd);
-      }
+      if(eci<=QR_ECI_GLI1)eci=-1;
     }
-    if(eci_cd!=(iconv_t)-1)iconv_close(eci_cd);
     if(!err){
       zbar_symbol_t *sa_sym;
       sa_text[sa_ntext++]='\0';
@@ -402,8 +508,11 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
                   }
               syms->data = sa_text + syms->datalen;
               next = (syms->next) ? syms->next->datalen : sa_ntext;
-              assert(next > syms->datalen);
-              syms->datalen = next - syms->datalen - 1;
+              /* placeholders and the last segment end at a '\0' */
+              if(syms->type == ZBAR_PARTIAL || !syms->next)
+                  next--;
+              assert(next >= syms->datalen);
+              syms->datalen = next - syms->datalen;
           }
           if(xmax >= -1) {
               sym_add_point(sa_sym, xmin, ymin);
@@ -417,6 +526,9 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
       sa_sym->datalen = sa_ntext - 1;
       sa_sym->modifiers = fnc1;
 
+      if(sa_sym->type == ZBAR_PARTIAL)
+          sa_sym = qr_sa_reassemble(iscn, sa_sym, sa, sa_size, sa_parity);
+
       _zbar_image_scanner_add_sym(iscn, sa_sym);
     }
     else {
@@ -424,9 +536,6 @@ int qr_code_data_list_extract_text(const qr_code_data_list *_qrlist,
         free(sa_text);
     }
   }
-  if(utf8_cd!=(iconv_t)-1)iconv_close(utf8_cd);
-  if(sjis_cd!=(iconv_t)-1)iconv_close(sjis_cd);
-  if(latin1_cd!=(iconv_t)-1)iconv_close(latin1_cd);
   free(mark);
   return ntext;
 }
@@ -8,6 +8,16 @@
 #include <string.h>
 #include "rs.h"
 
+#if defined(__GNUC__)&&(defined(__i386__)||defined(__x86_64__))
+/*The SSSE3 kernels are compiled for that target explicitly and only used if
+   the CPU reports support for it at run time.*/
+# define RS_HAVE_SSSE3 (1)
+# include <tmmintrin.h>
+#endif
+
+/*The number of elements processed at once by the vector kernels.*/
+#define RS_VEC_SIZE (16)
+
 /*Reed-Solomon encoder and decoder.
   Original implementation (C) Henry Minsky (hqm@ua.com, hqm@ai.mit.edu),
    Universal Access 1991-1995.
@@ -40,6 +50,69 @@ void rs_gf256_init(rs_gf256 *_gf,unsigned _ppoly){
   for(i=0;i<255;i++)_gf->log[_gf->exp[i]]=i;
   /*Note that we rely on the fact that _gf->log[0]=0 below.*/
   _gf->log[0]=0;
+  /*Build the split-nibble multiplication tables.*/
+  memset(_gf->mul_lo[0],0,sizeof(_gf->mul_lo[0]));
+  memset(_gf->mul_hi[0],0,sizeof(_gf->mul_hi[0]));
+  for(i=1;i<256;i++){
+    unsigned logi;
+    int      x;
+    logi=_gf->log[i];
+    _gf->mul_lo[i][0]=_gf->mul_hi[i][0]=0;
+    for(x=1;x<16;x++){
+      _gf->mul_lo[i][x]=_gf->exp[logi+_gf->log[x]];
+      _gf->mul_hi[i][x]=_gf->exp[logi+_gf->log[x<<4]];
+    }
+  }
+}
+
+#if defined(RS_HAVE_SSSE3)
+__attribute__((target("ssse3")))
+static int rs_gf256_mul_add_ssse3(const rs_gf256 *_gf,unsigned char *_dst,
+ const unsigned char *_src,unsigned _c,int _n){
+  __m128i lo;
+  __m128i hi;
+  __m128i mask;
+  int     i;
+  lo=_mm_loadu_si128((const __m128i *)_gf->mul_lo[_c]);
+  hi=_mm_loadu_si128((const __m128i *)_gf->mul_hi[_c]);
+  mask=_mm_set1_epi8(0x0F);
+  for(i=0;i+RS_VEC_SIZE<=_n;i+=RS_VEC_SIZE){
+    __m128i x;
+    __m128i p;
+    x=_mm_loadu_si128((const __m128i *)(_src+i));
+    p=_mm_xor_si128(_mm_shuffle_epi8(lo,_mm_and_si128(x,mask)),
+     _mm_shuffle_epi8(hi,_mm_and_si128(_mm_srli_epi16(x,4),mask)));
+    p=_mm_xor_si128(p,_mm_loadu_si128((const __m128i *)(_dst+i)));
+    _mm_storeu_si128((__m128i *)(_dst+i),p);
+  }
+  return i;
+}
+
+static int rs_cpu_has_ssse3(void){
+  static int has_ssse3=-1;
+  if(has_ssse3<0){
+    __builtin_cpu_init();
+    has_ssse3=__builtin_cpu_supports("ssse3")!=0;
+  }
+  return has_ssse3;
+}
+#endif
+
+void rs_gf256_mul_add(const rs_gf256 *_gf,unsigned char *_dst,
+ const unsigned char *_src,unsigned _c,int _n){
+  const unsigned char *lo;
+  const unsigned char *hi;
+  int                  i;
+  if(!_c)return;
+  i=0;
+#if defined(RS_HAVE_SSSE3)
+  if(_n>=RS_VEC_SIZE&&rs_cpu_has_ssse3()){
+    i=rs_gf256_mul_add_ssse3(_gf,_dst,_src,_c,_n);
+  }
+#endif
+  lo=_gf->mul_lo[_c];
+  hi=_gf->mul_hi[_c];
+  for(;i<_n;i++)_dst[i]^=lo[_src[i]&0xF]^hi[_src[i]>>4];
 }
 
 /*Multiplication in GF(2**8) using logarithms.*/
@@ -369,19 +442,55 @@ static void rs_poly_mult(const rs_gf256 *_gf,unsigned char *_p,int _dp1,
 
 /*Decoding.*/
 
-/*Computes the syndrome of a codeword.*/
+/*Computes the syndrome of a codeword.
+  Rather than evaluating the codeword at each root of the generator polynomial
+   in turn, we evaluate it at all of them at once, RS_VEC_SIZE bytes at a
+   time: for each group of bytes, every syndrome is scaled by the root raised to
+   the size of the group, and each byte is then multiplied by a vector of
+   precomputed powers of the roots and accumulated.
+  The syndrome buffer and the powers are padded out to a multiple of the vector
+   size, so _s must have room for 256 entries.*/
 static void rs_calc_syndrome(const rs_gf256 *_gf,int _m0,
  unsigned char *_s,int _npar,const unsigned char *_data,int _ndata){
-  int i;
-  int j;
-  for(j=0;j<_npar;j++){
+  unsigned char pows[RS_VEC_SIZE][256];
+  unsigned char logv[256];
+  int           nvec;
+  int           m;
+  int           i;
+  int           j;
+  int           k;
+  nvec=_npar+RS_VEC_SIZE-1&~(RS_VEC_SIZE-1);
+  /*pows[k][j] contains alpha**((j+_m0)*(RS_VEC_SIZE-1-k)).*/
+  for(j=0;j<nvec;j++){
     unsigned alphaj;
-    unsigned sj;
-    sj=0;
     alphaj=_gf->log[_gf->exp[j+_m0]];
-    for(i=0;i<_ndata;i++)sj=_data[i]^rs_hgmul(_gf,sj,alphaj);
-    _s[j]=sj;
+    for(k=0;k<RS_VEC_SIZE;k++){
+      pows[k][j]=_gf->exp[alphaj*(RS_VEC_SIZE-1-k)%255];
+    }
+    logv[j]=alphaj*RS_VEC_SIZE%255;
   }
+  rs_poly_zero(_s,nvec);
+  /*Handle any leftover bytes at the start as a shorter group.*/
+  m=_ndata&RS_VEC_SIZE-1;
+  for(k=0;k<m;k++){
+    rs_gf256_mul_add(_gf,_s,pows[RS_VEC_SIZE-m+k],_data[k],nvec);
+  }
+  for(i=m;i<_ndata;i+=RS_VEC_SIZE){
+    if(i>0)for(j=0;j<_npar;j++)_s[j]=rs_hgmul(_gf,_s[j],logv[j]);
+    for(k=0;k<RS_VEC_SIZE;k++){
+      rs_gf256_mul_add(_gf,_s,pows[k],_data[i+k],nvec);
+    }
+  }
+}
+
+/*Checks whether all the syndrome values are zero, i.e., whether the codeword
+   is valid and no correction is required.*/
+static int rs_syndrome_is_zero(const unsigned char *_s,int _npar){
+  unsigned s;
+  int      i;
+  s=0;
+  for(i=0;i<_npar;i++)s|=_s[i];
+  return !s;
 }
 
 /*Berlekamp-Peterson and Berlekamp-Massey Algorithms for error-location,
@@ -485,16 +594,31 @@ static int rs_find_roots(const rs_gf256 *_gf,unsigned char *_epos,
     }
     return nroots;
   }
-  else for(alpha=0;(int)alpha<_ndata;alpha++){
-    unsigned alphai;
-    unsigned sum;
-    sum=0;
-    alphai=0;
+  else{
+    unsigned char pows[256][RS_VEC_SIZE];
+    /*Chien search: evaluate the polynomial at RS_VEC_SIZE consecutive powers
+       of alpha at once.
+      The i'th term at alpha**(a+k) is _lambda[_nerrors-i]*alpha**(i*a) times
+       alpha**(i*k), so each term is a scalar times a fixed vector of powers.*/
     for(i=0;i<=_nerrors;i++){
-      sum^=rs_hgmul(_gf,_lambda[_nerrors-i],alphai);
-      alphai=_gf->log[_gf->exp[alphai+alpha]];
+      int k;
+      for(k=0;k<RS_VEC_SIZE;k++)pows[i][k]=_gf->exp[i*k%255];
+    }
+    for(alpha=0;(int)alpha<_ndata;alpha+=RS_VEC_SIZE){
+      unsigned char sum[RS_VEC_SIZE];
+      unsigned      alphai;
+      int           k;
+      rs_poly_zero(sum,RS_VEC_SIZE);
+      alphai=0;
+      for(i=0;i<=_nerrors;i++){
+        rs_gf256_mul_add(_gf,sum,pows[i],
+         rs_hgmul(_gf,_lambda[_nerrors-i],alphai),RS_VEC_SIZE);
+        alphai=_gf->log[_gf->exp[alphai+alpha]];
+      }
+      for(k=0;k<RS_VEC_SIZE&&(int)alpha+k<_ndata;k++){
+        if(!sum[k])_epos[nroots++]=alpha+k;
+      }
     }
-    if(!sum)_epos[nroots++]=alpha;
   }
   return nroots;
 }
@@ -520,7 +644,7 @@ int rs_correct(const rs_gf256 *_gf,int _m0,unsigned char *_data,int _ndata,
   /*Compute the syndrome values.*/
   rs_calc_syndrome(_gf,_m0,s,_npar,_data,_ndata);
   /*Check for a non-zero value.*/
-  for(i=0;i<_npar;i++)if(s[i]){
+  if(!rs_syndrome_is_zero(s,_npar)){
     int nerrors;
     int j;
     /*Construct the error locator polynomial.*/
@@ -37,12 +37,25 @@ struct rs_gf256{
     The extra 256 entries are used to do arithmetic mod 255, since some extra
      table lookups are generally faster than doing the modulus.*/
   unsigned char exp[511];
+  /*Split-nibble multiplication tables: the product of c and x is
+     mul_lo[c][x&0xF]^mul_hi[c][x>>4].
+    These let us multiply a whole vector by a constant with two table lookups
+     (or two byte shuffles) per element, and no branches.*/
+  unsigned char mul_lo[256][16];
+  unsigned char mul_hi[256][16];
 };
 
 /*Initialize discrete logarithm tables for GF(2**8) using a given primitive
    irreducible polynomial.*/
 void rs_gf256_init(rs_gf256 *_gf,unsigned _ppoly);
 
+/*Multiplies the _n elements of _src by the constant _c and adds the products
+   to _dst, i.e., _dst[i]^=_c*_src[i].
+  This is the inner loop of most Reed-Solomon computations, and uses SIMD
+   instructions when the CPU supports them.*/
+void rs_gf256_mul_add(const rs_gf256 *_gf,unsigned char *_dst,
+ const unsigned char *_src,unsigned _c,int _n);
+
 /*Corrects a codeword with _ndata<256 bytes, of which the last _npar are parity
    bytes.
   Known locations of errors can be passed in the _erasures array.
@@ -27,6 +27,7 @@
 #include <string.h>     /* memset */
 
 #include <zbar.h>
+#include "scanner.h"
 #include "svg.h"
 
 #ifdef DEBUG_SCANNER
@@ -213,6 +214,26 @@ zbar_symbol_type_t zbar_scanner_new_scan (zbar_scanner_t *scn)
     return(edge);
 }
 
+/* save and restore a scan in progress, see scanner.h */
+unsigned _zbar_scanner_state_size (void)
+{
+    return(sizeof(zbar_scanner_t));
+}
+
+void _zbar_scanner_save_state (const zbar_scanner_t *scn,
+                               void *state)
+{
+    memcpy(state, scn, sizeof(zbar_scanner_t));
+}
+
+void _zbar_scanner_restore_state (zbar_scanner_t *scn,
+                                  const void *state)
+{
+    zbar_decoder_t *dcode = scn->decoder;
+    memcpy(scn, state, sizeof(zbar_scanner_t));
+    scn->decoder = dcode;
+}
+
 zbar_symbol_type_t zbar_scan_y (zbar_scanner_t *scn,
                                 int y)
 {
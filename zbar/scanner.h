@@ -0,0 +1,45 @@
+/*------------------------------------------------------------------------
+ *  Copyright 2007-2009 (c) Jeff Brown <spadix@users.sourceforge.net>
+ *
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+#ifndef _SCANNER_H_
+#define _SCANNER_H_
+
+#include <zbar.h>
+
+/* internal linear scanner and decoder APIs */
+
+/* the state of a scan in progress may be saved and restored later, so
+ * several scans can be interleaved through one scanner and decoder (eg,
+ * image columns fed a strip at a time).  saved decoder state must be
+ * zero initialized before first use and released
+ * w/_zbar_decoder_free_state()
+ */
+extern unsigned _zbar_scanner_state_size(void);
+extern void _zbar_scanner_save_state(const zbar_scanner_t*, void*);
+extern void _zbar_scanner_restore_state(zbar_scanner_t*, const void*);
+
+extern unsigned _zbar_decoder_state_size(void);
+extern void _zbar_decoder_save_state(const zbar_decoder_t*, void*);
+extern void _zbar_decoder_restore_state(zbar_decoder_t*, const void*);
+extern void _zbar_decoder_free_state(void*);
+
+#endif
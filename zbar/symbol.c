@@ -69,8 +69,13 @@ const char *zbar_get_config_name (zbar_config_t cfg)
     case ZBAR_CFG_MAX_LEN: return("MAX_LEN");
     case ZBAR_CFG_UNCERTAINTY: return("UNCERTAINTY");
     case ZBAR_CFG_POSITION: return("POSITION");
+    case ZBAR_CFG_TRACKING: return("TRACKING");
     case ZBAR_CFG_X_DENSITY: return("X_DENSITY");
     case ZBAR_CFG_Y_DENSITY: return("Y_DENSITY");
+    case ZBAR_CFG_SA_TIMEOUT: return("SA_TIMEOUT");
+    case ZBAR_CFG_PYRAMID: return("PYRAMID");
+    case ZBAR_CFG_LATEST_FRAME: return("LATEST_FRAME");
+    case ZBAR_CFG_SKIP_STATIC: return("SKIP_STATIC");
     default: return("");
     }
 }
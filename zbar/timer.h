@@ -43,11 +43,21 @@
 
 typedef struct timespec zbar_timer_t;
 
-static inline int _zbar_timer_now ()
+/* timestamps only measure intervals, so they are taken from the
+ * monotonic clock (also used by V4L2 buffer timestamps) where available.
+ * timers still use the realtime clock expected by timed waits.
+ * timestamps are unsigned long ms like image capture times: compare
+ * them by their (unsigned) difference
+ */
+static inline unsigned long _zbar_timer_now ()
 {
     struct timespec now;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
     clock_gettime(CLOCK_REALTIME, &now);
-    return(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+    return((unsigned long)now.tv_sec * 1000 + now.tv_nsec / 1000000);
 }
 
 static inline zbar_timer_t *_zbar_timer_init (zbar_timer_t *timer,
@@ -83,7 +93,7 @@ static inline int _zbar_timer_check (zbar_timer_t *timer)
 
 typedef DWORD zbar_timer_t;
 
-static inline int _zbar_timer_now ()
+static inline unsigned long _zbar_timer_now ()
 {
     return(timeGetTime());
 }
@@ -113,11 +123,11 @@ static inline int _zbar_timer_check (zbar_timer_t *timer)
 
 typedef struct timeval zbar_timer_t;
 
-static inline int _zbar_timer_now ()
+static inline unsigned long _zbar_timer_now ()
 {
     struct timeval now;
     gettimeofday(&now, NULL);
-    return(now.tv_sec * 1000 + now.tv_usec / 1000);
+    return((unsigned long)now.tv_sec * 1000 + now.tv_usec / 1000);
 }
 
 static inline zbar_timer_t *_zbar_timer_init (zbar_timer_t *timer,
@@ -23,6 +23,7 @@
 
 #include "video.h"
 #include "image.h"
+#include "timer.h"
 
 
 #ifdef HAVE_LIBJPEG
@@ -30,29 +31,114 @@ extern struct jpeg_decompress_struct *_zbar_jpeg_decomp_create(void);
 extern void _zbar_jpeg_decomp_destroy(struct jpeg_decompress_struct *cinfo);
 #endif
 
+/* video images and shadow copies share a cleanup handler, as a held
+ * frame may be detached from its buffer while the application releases it
+ */
 static void _zbar_video_recycle_image (zbar_image_t *img)
 {
     zbar_video_t *vdo = img->src;
     assert(vdo);
-    assert(img->srcidx >= 0);
     video_lock(vdo);
+    if(img->srcidx < 0) {
+        /* recycle the shadow images */
+        img->next = vdo->shadow_image;
+        vdo->shadow_image = img;
+        video_unlock(vdo);
+        return;
+    }
     if(vdo->images[img->srcidx] != img)
         vdo->images[img->srcidx] = img;
+    if(vdo->held == img)
+        vdo->held = NULL;
+    img->time = 0;
     if(vdo->active)
-        vdo->nq(vdo, img);
+        video_nq(vdo, img);
     else
         video_unlock(vdo);
 }
 
-static void _zbar_video_recycle_shadow (zbar_image_t *img)
+/* fetch an idle shadow image, or allocate a new one.
+ * called w/video lock held
+ */
+static zbar_image_t *video_shadow_image (zbar_video_t *vdo)
 {
-    zbar_video_t *vdo = img->src;
-    assert(vdo);
-    assert(img->srcidx == -1);
-    video_lock(vdo);
-    img->next = vdo->shadow_image;
-    vdo->shadow_image = img;
-    video_unlock(vdo);
+    zbar_image_t *img = vdo->shadow_image;
+    if(img) {
+        vdo->shadow_image = img->next;
+        img->next = NULL;
+        return(img);
+    }
+    img = zbar_image_create();
+    if(!img)
+        return(NULL);
+    img->data = malloc(vdo->datalen);
+    if(!img->data) {
+        free(img);
+        return(NULL);
+    }
+    img->datalen = vdo->datalen;
+    img->refcnt = 0;
+    img->src = vdo;
+    img->srcidx = -1;
+    img->cleanup = _zbar_video_recycle_image;
+    img->format = vdo->format;
+    zbar_image_set_size(img, vdo->width, vdo->height);
+    return(img);
+}
+
+/* the application still holds the last frame from the only buffer:
+ * move it into a private copy and hand the buffer back to the driver.
+ * called w/video lock held, which is held again on return.  the copy
+ * and swap are completed before the lock is released to requeue the
+ * buffer, so a concurrent release of the held frame (which recycles
+ * under the same lock) sees either the original or the copy.  the data
+ * only moves while the caller holds the sole reference; any other
+ * holder may be reading it, so the frame must be released first
+ */
+static int video_copy_held (zbar_video_t *vdo)
+{
+    zbar_image_t *held = vdo->held, *img;
+    const void *data;
+    unsigned long datalen;
+    if(!held->refcnt) {
+        /* already released, recycle is pending */
+        vdo->held = NULL;
+        return(0);
+    }
+    if(held->refcnt > 1)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_BUSY, __func__,
+                           "held frame is shared, unable to copy it"));
+    vdo->held = NULL;
+
+    img = video_shadow_image(vdo);
+    if(!img)
+        return(err_capture(vdo, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                           "unable to allocate shadow image"));
+
+    /* swap buffers: the held frame keeps the copy,
+     * the shadow takes over the driver buffer
+     */
+    data = held->data;
+    datalen = held->datalen;
+    memcpy((void*)img->data, data,
+           (datalen < img->datalen) ? datalen : img->datalen);
+    held->data = img->data;
+    held->datalen = img->datalen;
+    img->data = data;
+    img->datalen = datalen;
+    img->format = held->format;
+    _zbar_image_copy_size(img, held);
+    img->srcidx = held->srcidx;
+    held->srcidx = -1;
+    vdo->images[img->srcidx] = img;
+    zprintf(32, "copied held frame %d\n", held->seq);
+
+    if(!vdo->active)
+        return(0);
+    if(video_nq(vdo, img))
+        err_capture(vdo, SEV_WARNING, ZBAR_ERR_SYSTEM, __func__,
+                    "unable to requeue held buffer");
+    return(video_lock(vdo));
 }
 
 zbar_video_t *zbar_video_create ()
@@ -67,7 +153,7 @@ zbar_video_t *zbar_video_create ()
     (void)_zbar_mutex_init(&vdo->qlock);
 
     /* pre-allocate images */
-    vdo->num_images = ZBAR_VIDEO_IMAGES_MAX;
+    vdo->req_images = vdo->num_images = ZBAR_VIDEO_IMAGES_DEFAULT;
     vdo->images = calloc(ZBAR_VIDEO_IMAGES_MAX, sizeof(zbar_image_t*));
     if(!vdo->images) {
         zbar_video_destroy(vdo);
@@ -111,6 +197,8 @@ void zbar_video_destroy (zbar_video_t *vdo)
         free(vdo->buf);
     if(vdo->formats)
         free(vdo->formats);
+    if(vdo->dmabufs)
+        free(vdo->dmabufs);
     err_cleanup(&vdo->err);
     _zbar_mutex_destroy(&vdo->qlock);
 
@@ -141,6 +229,7 @@ int zbar_video_open (zbar_video_t *vdo,
         }
         zprintf(1, "closed camera (fd=%d)\n", vdo->fd);
         vdo->intf = VIDEO_INVALID;
+        vdo->set_roi = NULL;
     }
     video_unlock(vdo);
 
@@ -154,7 +243,11 @@ int zbar_video_open (zbar_video_t *vdo,
         ldev[10] = '0' + id;
     }
 
-    rc = _zbar_video_open(vdo, dev);
+    vdo->num_images = vdo->req_images;
+    if(!strncmp(dev, "file:", 5))
+        rc = _zbar_video_file_open(vdo, dev + 5);
+    else
+        rc = _zbar_video_open(vdo, dev);
 
     if(ldev)
         free(ldev);
@@ -172,6 +265,13 @@ int zbar_video_get_fd (const zbar_video_t *vdo)
     return(vdo->fd);
 }
 
+int _zbar_video_get_poll_fd (const zbar_video_t *vdo)
+{
+    if(vdo->intf == VIDEO_FILE)
+        return(_zbar_video_file_get_fd(vdo));
+    return(zbar_video_get_fd(vdo));
+}
+
 int zbar_video_request_size (zbar_video_t *vdo,
                              unsigned width,
                              unsigned height)
@@ -187,6 +287,76 @@ int zbar_video_request_size (zbar_video_t *vdo,
     return(0);
 }
 
+int zbar_video_set_roi (zbar_video_t *vdo,
+                        unsigned x,
+                        unsigned y,
+                        unsigned width,
+                        unsigned height)
+{
+    unsigned old[4];
+    int rc;
+    if(!width || !height)
+        x = y = width = height = 0;
+
+    if(!vdo->initialized) {
+        /* applied w/the video format */
+        vdo->roi_x = x;
+        vdo->roi_y = y;
+        vdo->roi_w = width;
+        vdo->roi_h = height;
+        zprintf(1, "request region of interest: %d x %d @ (%d, %d)\n",
+                width, height, x, y);
+        return(0);
+    }
+
+    /* buffers were sized for the region, so it can only move */
+    if(!vdo->roi_w || width != vdo->roi_w || height != vdo->roi_h)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "already initialized, unable to resize"
+                           " region of interest"));
+    if(x == vdo->roi_x && y == vdo->roi_y)
+        return(0);
+
+    if(video_lock(vdo))
+        return(-1);
+    old[0] = vdo->roi_x;
+    old[1] = vdo->roi_y;
+    old[2] = vdo->roi_w;
+    old[3] = vdo->roi_h;
+    vdo->roi_x = x;
+    vdo->roi_y = y;
+    rc = vdo->set_roi(vdo);
+    if(rc) {
+        vdo->roi_x = old[0];
+        vdo->roi_y = old[1];
+        vdo->roi_w = old[2];
+        vdo->roi_h = old[3];
+    }
+    else
+        vdo->roi_gen++;
+    if(video_unlock(vdo))
+        return(-1);
+    return(rc);
+}
+
+void zbar_video_get_roi (const zbar_video_t *vdo,
+                         unsigned *x,
+                         unsigned *y,
+                         unsigned *width,
+                         unsigned *height)
+{
+    if(x) *x = vdo->roi_x;
+    if(y) *y = vdo->roi_y;
+    if(vdo->roi_w || !vdo->initialized) {
+        if(width) *width = vdo->roi_w;
+        if(height) *height = vdo->roi_h;
+    }
+    else {
+        if(width) *width = vdo->width;
+        if(height) *height = vdo->height;
+    }
+}
+
 int zbar_video_request_interface (zbar_video_t *vdo,
                                   int ver)
 {
@@ -204,13 +374,72 @@ int zbar_video_request_iomode (zbar_video_t *vdo,
     if(vdo->intf != VIDEO_INVALID)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
                          "device already opened, unable to change iomode"));
-    if(iomode < 0 || iomode > VIDEO_USERPTR)
+    if(iomode < 0 || iomode > VIDEO_DMABUF)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
                          "invalid iomode requested"));
     vdo->iomode = iomode;
     return(0);
 }
 
+int zbar_video_request_buffers (zbar_video_t *vdo,
+                                int num)
+{
+    if(vdo->intf != VIDEO_INVALID)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                         "device already opened, unable to change buffers"));
+    if(num < 1 || num > ZBAR_VIDEO_IMAGES_MAX)
+        return(err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                               "invalid number of buffers requested (%d)",
+                               num));
+    vdo->req_images = vdo->num_images = num;
+    zprintf(1, "request %d buffers\n", num);
+    return(0);
+}
+
+int zbar_video_set_copy_on_hold (zbar_video_t *vdo,
+                                 int enable)
+{
+    vdo->copy_on_hold = (enable) ? 1 : 0;
+    return(0);
+}
+
+int zbar_video_set_latest_frame (zbar_video_t *vdo,
+                                 int latest)
+{
+    vdo->latest = (latest) ? 1 : 0;
+    return(0);
+}
+
+unsigned long zbar_video_get_dropped_frames (const zbar_video_t *vdo)
+{
+    return(vdo->dropped);
+}
+
+int zbar_video_import_dmabufs (zbar_video_t *vdo,
+                               const int *fds,
+                               int num)
+{
+    if(vdo->initialized)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "already initialized, unable to change buffers"));
+    if(num < 0 || (num && !fds))
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "invalid dma-buf descriptors"));
+    if(vdo->dmabufs)
+        free(vdo->dmabufs);
+    vdo->dmabufs = NULL;
+    vdo->num_dmabufs = 0;
+    if(num) {
+        vdo->dmabufs = malloc(num * sizeof(int));
+        if(!vdo->dmabufs)
+            return(err_capture(vdo, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                               "unable to allocate dma-buf list"));
+        memcpy(vdo->dmabufs, fds, num * sizeof(int));
+        vdo->num_dmabufs = num;
+    }
+    return(0);
+}
+
 int zbar_video_get_width (const zbar_video_t *vdo)
 {
     return(vdo->width);
@@ -229,8 +458,10 @@ uint32_t zbar_video_get_format (const zbar_video_t *vdo)
 static inline int video_init_images (zbar_video_t *vdo)
 {
     int i;
+    /* driver mapped buffers are set up by the interface */
+    int mapped = (vdo->iomode == VIDEO_MMAP || vdo->iomode == VIDEO_DMABUF);
     assert(vdo->datalen);
-    if(vdo->iomode != VIDEO_MMAP) {
+    if(!mapped) {
         assert(!vdo->buf);
         vdo->buflen = vdo->num_images * vdo->datalen;
         vdo->buf = calloc(1, vdo->buflen);
@@ -245,7 +476,7 @@ static inline int video_init_images (zbar_video_t *vdo)
         zbar_image_t *img = vdo->images[i];
         img->format = vdo->format;
         zbar_image_set_size(img, vdo->width, vdo->height);
-        if(vdo->iomode != VIDEO_MMAP) {
+        if(!mapped) {
             unsigned long offset = i * vdo->datalen;
             img->datalen = vdo->datalen;
             img->data = (uint8_t*)vdo->buf + offset;
@@ -265,6 +496,10 @@ int zbar_video_init (zbar_video_t *vdo,
         /* FIXME re-init different format? */
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
                            "already initialized, re-init unimplemented"));
+    if(vdo->roi_w && !vdo->set_roi)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                           "video driver does not support a region of"
+                           " interest"));
 
     if(vdo->init(vdo, fmt))
         return(-1);
@@ -315,7 +550,7 @@ int zbar_video_enable (zbar_video_t *vdo,
         /* enqueue all buffers */
         int i;
         for(i = 0; i < vdo->num_images; i++)
-            if(vdo->nq(vdo, vdo->images[i]) ||
+            if(video_nq(vdo, vdo->images[i]) ||
                ((i + 1 < vdo->num_images) && video_lock(vdo)))
                 return(-1);
         
@@ -326,6 +561,9 @@ int zbar_video_enable (zbar_video_t *vdo,
         for(i = 0; i < vdo->num_images; i++)
             vdo->images[i]->next = NULL;
         vdo->nq_image = vdo->dq_image = NULL;
+        vdo->held = NULL;
+        if(vdo->dropped)
+            zprintf(1, "skipped %lu stale frames\n", vdo->dropped);
         if(video_unlock(vdo))
             return(-1);
 
@@ -345,39 +583,71 @@ zbar_image_t *zbar_video_next_image (zbar_video_t *vdo)
         return(NULL);
     }
 
+    /* the driver can not deliver another frame until the only buffer
+     * is released
+     */
+    if(vdo->held && video_copy_held(vdo)) {
+        video_unlock(vdo);
+        return(NULL);
+    }
+
     frame = vdo->frame++;
     img = vdo->dq(vdo);
+    while(img) {
+        if(video_lock(vdo))
+            return(NULL);
+        if(img->roi_gen == vdo->roi_gen) {
+            img->frame_x = vdo->roi_x;
+            img->frame_y = vdo->roi_y;
+            video_unlock(vdo);
+            break;
+        }
+        /* the buffer was queued before the region of interest moved, so
+         * the frame may have been captured at either position
+         */
+        vdo->dropped++;
+        zprintf(24, "dropped frame %d captured before region moved\n",
+                frame);
+        if(video_nq(vdo, img) || video_lock(vdo))
+            return(NULL);
+        img = vdo->dq(vdo);
+    }
     if(img) {
         img->seq = frame;
-        if(vdo->num_images < 2) {
+        if(!img->time)
+            /* driver did not timestamp the frame */
+            img->time = _zbar_timer_now();
+        if(vdo->num_images < 2 && vdo->copy_on_hold) {
+            /* copied out only if still held at the next dequeue */
+            video_lock(vdo);
+            vdo->held = img;
+            video_unlock(vdo);
+        }
+        else if(vdo->num_images < 2) {
             /* return a *copy* of the video image and immediately recycle
              * the driver's buffer to avoid deadlocking the resources
              */
             zbar_image_t *tmp = img;
-            video_lock(vdo);
-            img = vdo->shadow_image;
-            vdo->shadow_image = (img) ? img->next : NULL;
+            if(video_lock(vdo)) {
+                _zbar_video_recycle_image(tmp);
+                return(NULL);
+            }
+            img = video_shadow_image(vdo);
             video_unlock(vdo);
-                
             if(!img) {
-                img = zbar_image_create();
-                assert(img);
-                img->refcnt = 0;
-                img->src = vdo;
-                /* recycle the shadow images */
-
-                img->format = vdo->format;
-                zbar_image_set_size(img, vdo->width, vdo->height);
-                img->datalen = vdo->datalen;
-                img->data = malloc(vdo->datalen);
+                _zbar_video_recycle_image(tmp);
+                err_capture(vdo, SEV_ERROR, ZBAR_ERR_NOMEM, __func__,
+                            "unable to allocate shadow image");
+                return(NULL);
             }
-            img->cleanup = _zbar_video_recycle_shadow;
+
+            img->format = tmp->format;
+            _zbar_image_copy_size(img, tmp);
             img->seq = frame;
+            img->time = tmp->time;
             memcpy((void*)img->data, tmp->data, img->datalen);
             _zbar_video_recycle_image(tmp);
         }
-        else
-            img->cleanup = _zbar_video_recycle_image;
         _zbar_image_refcnt(img, 1);
     }
     return(img);
@@ -39,19 +39,24 @@
 #include "mutex.h"
 
 /* number of images to preallocate */
-#define ZBAR_VIDEO_IMAGES_MAX  4
+#define ZBAR_VIDEO_IMAGES_MAX  32
+
+/* number of buffers requested by default */
+#define ZBAR_VIDEO_IMAGES_DEFAULT  4
 
 typedef enum video_interface_e {
     VIDEO_INVALID = 0,          /* uninitialized */
     VIDEO_V4L1,                 /* v4l protocol version 1 */
     VIDEO_V4L2,                 /* v4l protocol version 2 */
     VIDEO_VFW,                  /* video for windows */
+    VIDEO_FILE,                 /* recorded video file */
 } video_interface_t;
 
 typedef enum video_iomode_e {
     VIDEO_READWRITE = 1,        /* standard system calls */
     VIDEO_MMAP,                 /* mmap interface */
     VIDEO_USERPTR,              /* userspace buffers */
+    VIDEO_DMABUF,               /* imported dma-buf buffers */
 } video_iomode_t;
 
 typedef struct video_state_s video_state_t;
@@ -60,6 +65,9 @@ struct zbar_video_s {
     errinfo_t err;              /* error reporting */
     int fd;                     /* open camera device */
     unsigned width, height;     /* video frame size */
+    unsigned roi_x, roi_y;      /* capture region of interest in the */
+    unsigned roi_w, roi_h;      /*   full frame (0 size for all of it) */
+    unsigned roi_gen;           /* incremented each time the region moves */
 
     video_interface_t intf;     /* input interface type */
     video_iomode_t iomode;      /* video data transfer mode */
@@ -74,14 +82,22 @@ struct zbar_video_s {
     unsigned long buflen;       /* total size of image data buffer */
     void *buf;                  /* image data buffer */
 
+    int *dmabufs;               /* application dma-buf fds (DMABUF I/O) */
+    int num_dmabufs;
+
     unsigned frame;             /* frame count */
+    int latest;                 /* skip to the newest captured frame */
+    unsigned long dropped;      /* stale frames skipped */
 
     zbar_mutex_t qlock;         /* lock image queue */
+    int req_images;             /* application requested buffer count */
     int num_images;             /* number of allocated images */
     zbar_image_t **images;      /* indexed list of images */
     zbar_image_t *nq_image;     /* last image enqueued */
     zbar_image_t *dq_image;     /* first image to dequeue (when ordered) */
     zbar_image_t *shadow_image; /* special case internal double buffering */
+    zbar_image_t *held;         /* single buffer frame not yet recycled */
+    int copy_on_hold;           /* copy single buffer frames only if held */
 
     video_state_t *state;       /* platform/interface specific state */
 
@@ -97,6 +113,7 @@ struct zbar_video_s {
     int (*stop)(zbar_video_t*);
     int (*nq)(zbar_video_t*, zbar_image_t*);
     zbar_image_t* (*dq)(zbar_video_t*);
+    int (*set_roi)(zbar_video_t*);
 };
 
 
@@ -140,6 +157,16 @@ static inline int video_nq_image (zbar_video_t *vdo,
     return(video_unlock(vdo));
 }
 
+/* hand a buffer to the driver, recording the region of interest it is
+ * queued for.  called w/video lock held, which is released
+ */
+static inline int video_nq (zbar_video_t *vdo,
+                            zbar_image_t *img)
+{
+    img->roi_gen = vdo->roi_gen;
+    return(vdo->nq(vdo, img));
+}
+
 static inline zbar_image_t *video_dq_image (zbar_video_t *vdo)
 {
     zbar_image_t *img = vdo->dq_image;
@@ -156,5 +183,10 @@ static inline zbar_image_t *video_dq_image (zbar_video_t *vdo)
 
 /* PAL interface */
 extern int _zbar_video_open(zbar_video_t*, const char*);
+extern int _zbar_video_file_open(zbar_video_t*, const char*);
+extern int _zbar_video_file_get_fd(const zbar_video_t*);
+
+/* like zbar_video_get_fd(), but video files may be polled too */
+extern int _zbar_video_get_poll_fd(const zbar_video_t*);
 
 #endif
@@ -0,0 +1,516 @@
+/*------------------------------------------------------------------------
+ *  This file is part of the ZBar Bar Code Reader.
+ *
+ *  The ZBar Bar Code Reader is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser Public License as
+ *  published by the Free Software Foundation; either version 2.1 of
+ *  the License, or (at your option) any later version.
+ *
+ *  The ZBar Bar Code Reader is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ *  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser Public License
+ *  along with the ZBar Bar Code Reader; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ *  Boston, MA  02110-1301  USA
+ *
+ *  http://sourceforge.net/projects/zbar
+ *------------------------------------------------------------------------*/
+
+#include <config.h>
+#include <stdio.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+# include <sys/timerfd.h>
+#endif
+
+#include "video.h"
+#include "timer.h"
+#include "event.h"
+
+/* file backed video source, for reproducible benchmarks w/o a camera.
+ * replays a YUV4MPEG2 (.y4m) stream or a sequence of images dumped
+ * by zbar_image_write() (.zimg), selected by the device string
+ *
+ *     file:<path>[?<option>[&<option>...]]
+ *
+ * options:
+ *     fps=<num>[/<den>]  pace frames at the specified rate,
+ *                        0 delivers frames as fast as possible
+ *     loop[=<n>]         play the file n times (0 or omitted: forever)
+ *
+ * y4m streams are paced at their own frame rate by default, while
+ * image dumps, which carry no rate, are delivered as fast as possible.
+ * the descriptor to poll (internally, the processor reads files from a
+ * blocking video thread) becomes readable when the next frame is due,
+ * so a paced file does not block a caller that polls several sources.
+ * unpaced frames are always ready, and so are paced frames where timer
+ * descriptors are not supported: the descriptor is then a pipe that is
+ * never drained
+ */
+
+#define Y4M_MAGIC "YUV4MPEG2 "
+#define Y4M_LINE_MAX 256
+
+struct video_state_s {
+    FILE *file;                 /* open video file */
+    int y4m;                    /* YUV4MPEG2 stream (else image dumps) */
+    long start;                 /* file offset of first frame */
+    uint32_t format;            /* fourcc of frame data */
+    unsigned long datalen;      /* size of frame data read into images */
+    unsigned long skiplen;      /* size of frame data skipped (y4m) */
+    unsigned fps_num, fps_den;  /* pacing rate, 0 for as fast as possible */
+    int loops;                  /* remaining plays, 0 for forever */
+    unsigned long epoch;        /* start time of paced playback (ms) */
+    unsigned long frames;       /* frames delivered since start */
+    int ready_fds[2];           /* never drained pipe, for polling */
+    int timer_fd;               /* expires when the next frame is due */
+    zbar_event_t event;         /* buffer released or video stopped */
+};
+
+/* capture time of the indicated frame (ms) */
+static inline unsigned long file_frame_time (video_state_t *state,
+                                             unsigned long frame)
+{
+    return(state->epoch + (unsigned long)((uint64_t)frame * 1000 *
+                                          state->fps_den / state->fps_num));
+}
+
+/* consume the header preceding the next frame.
+ * returns 0 if successful, 1 at end of file or -1 if an error occurs
+ */
+static int file_frame_header (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    if(state->y4m) {
+        char line[Y4M_LINE_MAX];
+        if(!fgets(line, sizeof(line), state->file))
+            return(1);
+        if(strncmp(line, "FRAME", 5))
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                               "invalid y4m frame header"));
+        /* ignore (long) frame parameters */
+        while(!strchr(line, '\n'))
+            if(!fgets(line, sizeof(line), state->file))
+                return(1);
+    }
+    else {
+        zimg_hdr_t hdr;
+        if(fread(&hdr, sizeof(hdr), 1, state->file) != 1)
+            return(1);
+        if(hdr.magic != ZIMG_MAGIC || hdr.format != state->format ||
+           hdr.width != vdo->width || hdr.height != vdo->height ||
+           hdr.size != state->datalen)
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                               "image dump does not match first frame"));
+    }
+    return(0);
+}
+
+/* read the next frame into data, or skip it if data is NULL,
+ * rewinding the file to loop playback.
+ * returns 0 if successful, 1 at end of file or -1 if an error occurs
+ */
+static int file_read_frame (zbar_video_t *vdo,
+                            void *data)
+{
+    video_state_t *state = vdo->state;
+    int rc = file_frame_header(vdo);
+    if(rc > 0 && state->loops != 1) {
+        if(state->loops)
+            state->loops--;
+        zprintf(8, "looping video file\n");
+        if(fseek(state->file, state->start, SEEK_SET))
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                               "rewinding video file"));
+        rc = file_frame_header(vdo);
+    }
+    if(rc)
+        return(rc);
+
+    if(!data) {
+        if(fseek(state->file, state->datalen + state->skiplen, SEEK_CUR))
+            return(1);
+    }
+    else if(fread(data, 1, state->datalen, state->file) != state->datalen ||
+            (state->skiplen &&
+             fseek(state->file, state->skiplen, SEEK_CUR)))
+        return(1);
+    return(0);
+}
+
+static int file_nq (zbar_video_t *vdo,
+                    zbar_image_t *img)
+{
+    video_state_t *state = vdo->state;
+    _zbar_event_trigger(&state->event);
+    return(video_nq_image(vdo, img));
+}
+
+/* arm the poll descriptor to expire when the next frame is due */
+static inline void file_arm (video_state_t *state)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+    struct itimerspec due;
+    unsigned long ms;
+    if(state->timer_fd < 0)
+        return;
+    ms = file_frame_time(state, state->frames);
+    memset(&due, 0, sizeof(due));
+    due.it_value.tv_sec = ms / 1000;
+    due.it_value.tv_nsec = (ms % 1000) * 1000000;
+    if(!ms)
+        /* zero disarms */
+        due.it_value.tv_nsec = 1;
+    if(timerfd_settime(state->timer_fd, TFD_TIMER_ABSTIME, &due, NULL))
+        zprintf(1, "WARNING: unable to arm video file timer\n");
+#endif
+}
+
+/* wait w/the video lock held until the indicated capture time (ms).
+ * returns 0 when the frame is due, or 1 if the video was stopped
+ */
+static int file_wait (zbar_video_t *vdo,
+                      unsigned long due)
+{
+    video_state_t *state = vdo->state;
+    zbar_timer_t timer;
+    long delay;
+    while(vdo->active && (delay = (long)(due - _zbar_timer_now())) > 0)
+        /* woken early by released buffers */
+        _zbar_event_wait(&state->event, &vdo->qlock,
+                         _zbar_timer_init(&timer, delay));
+    return(!vdo->active);
+}
+
+static zbar_image_t *file_dq (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    zbar_image_t *img;
+    int rc;
+
+    /* like a driver, wait for the application to release a buffer */
+    while(!vdo->dq_image && vdo->active)
+        if(_zbar_event_wait(&state->event, &vdo->qlock, NULL) < 0) {
+            video_unlock(vdo);
+            err_capture(vdo, SEV_ERROR, ZBAR_ERR_BUSY, __func__,
+                        "all video buffers are held");
+            return(NULL);
+        }
+    img = video_dq_image(vdo);
+    if(!img)
+        return(NULL);
+
+    if(state->fps_num && vdo->latest) {
+        /* skip the frames a camera would have captured meanwhile */
+        unsigned long now = ((uint64_t)(_zbar_timer_now() - state->epoch) *
+                             state->fps_num / (state->fps_den * 1000));
+        while(state->frames < now && !file_read_frame(vdo, NULL)) {
+            state->frames++;
+            vdo->dropped++;
+        }
+    }
+
+    rc = file_read_frame(vdo, (void*)img->data);
+    if(rc) {
+        if(rc > 0)
+            err_capture(vdo, SEV_WARNING, ZBAR_ERR_CLOSED, __func__,
+                        "end of video file");
+        /* hand the buffer back */
+        if(!video_lock(vdo))
+            video_nq_image(vdo, img);
+        return(NULL);
+    }
+
+    if(state->fps_num) {
+        unsigned long due = file_frame_time(state, state->frames);
+        if(video_lock(vdo))
+            return(NULL);
+        if(file_wait(vdo, due)) {
+            /* stopped meanwhile, the buffer queue was reset */
+            video_unlock(vdo);
+            return(NULL);
+        }
+        video_unlock(vdo);
+        img->time = due;
+    }
+    state->frames++;
+    file_arm(state);
+    return(img);
+}
+
+static int file_start (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    state->epoch = _zbar_timer_now();
+    state->frames = 0;
+    file_arm(state);
+    return(0);
+}
+
+static int file_stop (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    /* wake a frame waiting for a buffer or its capture time */
+    if(video_lock(vdo))
+        return(-1);
+    _zbar_event_trigger(&state->event);
+    return(video_unlock(vdo));
+}
+
+static int file_cleanup (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    if(!state)
+        return(0);
+    if(state->file)
+        fclose(state->file);
+    if(state->ready_fds[0] >= 0)
+        close(state->ready_fds[0]);
+    if(state->ready_fds[1] >= 0)
+        close(state->ready_fds[1]);
+    if(state->timer_fd >= 0)
+        close(state->timer_fd);
+    _zbar_event_destroy(&state->event);
+    free(state);
+    vdo->state = NULL;
+    return(0);
+}
+
+static int file_init (zbar_video_t *vdo,
+                      uint32_t fmt)
+{
+    video_state_t *state = vdo->state;
+    if(fmt != state->format)
+        return(err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                               "video file does not contain format %08x",
+                               fmt));
+    vdo->datalen = state->datalen;
+    return(0);
+}
+
+static int file_probe_y4m (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    char line[Y4M_LINE_MAX], *tok;
+    const char *cs = "420jpeg";
+    unsigned long w, h, cw = 0, ch = 0, planes = 0;
+
+    if(!fgets(line, sizeof(line), state->file) || !strchr(line, '\n'))
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "invalid y4m stream header"));
+    state->y4m = 1;
+    state->start = ftell(state->file);
+    state->fps_num = 30;
+    state->fps_den = 1;
+
+    vdo->width = vdo->height = 0;
+    for(tok = strtok(line + strlen(Y4M_MAGIC), " \n"); tok;
+        tok = strtok(NULL, " \n"))
+        switch(*tok) {
+        case 'W':
+            vdo->width = strtoul(tok + 1, NULL, 10);
+            break;
+        case 'H':
+            vdo->height = strtoul(tok + 1, NULL, 10);
+            break;
+        case 'F':
+            if(sscanf(tok + 1, "%u:%u", &state->fps_num, &state->fps_den) != 2 ||
+               !state->fps_den)
+                state->fps_num = 0;
+            break;
+        case 'C':
+            cs = tok + 1;
+            break;
+        }
+    w = vdo->width;
+    h = vdo->height;
+    if(!w || !h)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                           "y4m stream has no frame size"));
+
+    if(!strncmp(cs, "420", 3) && (!cs[3] || !strcmp(cs + 3, "jpeg") ||
+                                  !strcmp(cs + 3, "paldv") ||
+                                  !strcmp(cs + 3, "mpeg2"))) {
+        state->format = fourcc('I','4','2','0');
+        cw = (w + 1) / 2;
+        ch = (h + 1) / 2;
+    }
+    else if(!strcmp(cs, "422")) {
+        state->format = fourcc('4','2','2','P');
+        cw = (w + 1) / 2;
+        ch = h;
+    }
+    else if(!strcmp(cs, "411")) {
+        state->format = fourcc('4','1','1','P');
+        cw = (w + 3) / 4;
+        ch = h;
+    }
+    else if(!strcmp(cs, "mono"))
+        state->format = fourcc('G','R','E','Y');
+    else if(!strcmp(cs, "444"))
+        planes = 2;
+    else if(!strcmp(cs, "444alpha"))
+        planes = 3;
+    else
+        return(err_capture_str(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                               "unsupported y4m colorspace (%s)", cs));
+
+    if(planes) {
+        /* no matching planar format: only the luma plane is read */
+        state->format = fourcc('G','R','E','Y');
+        state->skiplen = planes * w * h;
+    }
+    state->datalen = w * h + 2 * cw * ch;
+    return(0);
+}
+
+static int file_probe_zimg (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    zimg_hdr_t hdr;
+    if(fread(&hdr, sizeof(hdr), 1, state->file) != 1 ||
+       hdr.magic != ZIMG_MAGIC ||
+       !hdr.width || !hdr.height || !hdr.size)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                           "unrecognized video file format"));
+    state->format = hdr.format;
+    state->datalen = hdr.size;
+    vdo->width = hdr.width;
+    vdo->height = hdr.height;
+    /* the first frame header is consumed like the others */
+    state->start = 0;
+    rewind(state->file);
+    return(0);
+}
+
+static int file_parse_options (zbar_video_t *vdo,
+                               char *opts)
+{
+    video_state_t *state = vdo->state;
+    char *opt;
+    for(opt = strtok(opts, "&"); opt; opt = strtok(NULL, "&")) {
+        if(!strncmp(opt, "fps=", 4)) {
+            state->fps_den = 1;
+            if(sscanf(opt + 4, "%u/%u", &state->fps_num, &state->fps_den) < 1 ||
+               !state->fps_den)
+                return(err_capture_str(vdo, SEV_ERROR, ZBAR_ERR_INVALID,
+                                       __func__, "invalid frame rate (%s)",
+                                       opt));
+        }
+        else if(!strcmp(opt, "loop"))
+            state->loops = 0;
+        else if(!strncmp(opt, "loop=", 5))
+            state->loops = strtol(opt + 5, NULL, 10);
+        else
+            return(err_capture_str(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                                   "unknown video file option (%s)", opt));
+    }
+    return(0);
+}
+
+int _zbar_video_file_get_fd (const zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    if(state && state->timer_fd >= 0)
+        return(state->timer_fd);
+    if(!state || state->ready_fds[0] < 0)
+        return(err_capture(vdo, SEV_WARNING, ZBAR_ERR_UNSUPPORTED, __func__,
+                           "video file does not support polling"));
+    return(state->ready_fds[0]);
+}
+
+int _zbar_video_file_open (zbar_video_t *vdo,
+                           const char *dev)
+{
+    video_state_t *state;
+    char *path = strdup(dev), *opts = strrchr(path, '?');
+    char magic[sizeof(Y4M_MAGIC) - 1];
+    int rc = -1;
+
+    if(opts)
+        *(opts++) = '\0';
+    if(vdo->iomode && vdo->iomode != VIDEO_READWRITE) {
+        err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                        "unsupported iomode requested (%d)", vdo->iomode);
+        goto done;
+    }
+
+    state = vdo->state = calloc(1, sizeof(video_state_t));
+    if(!state) {
+        err_capture(vdo, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                    "allocating video file state");
+        goto done;
+    }
+    state->loops = 1;
+    state->ready_fds[0] = state->ready_fds[1] = -1;
+    state->timer_fd = -1;
+    _zbar_event_init(&state->event);
+    state->file = fopen(path, "rb");
+    if(!state->file) {
+        err_capture_str(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                        "opening video file '%s'", path);
+        goto done;
+    }
+
+    if(fread(magic, sizeof(magic), 1, state->file) == 1 &&
+       !memcmp(magic, Y4M_MAGIC, sizeof(magic))) {
+        rewind(state->file);
+        rc = file_probe_y4m(vdo);
+    }
+    else {
+        rewind(state->file);
+        rc = file_probe_zimg(vdo);
+    }
+    if(!rc && opts)
+        rc = file_parse_options(vdo, opts);
+    if(rc)
+        goto done;
+
+    if(vdo->formats)
+        free(vdo->formats);
+    vdo->formats = calloc(2, sizeof(uint32_t));
+    if(!vdo->formats) {
+        rc = err_capture(vdo, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                         "allocating format list");
+        goto done;
+    }
+    vdo->formats[0] = state->format;
+
+#ifdef HAVE_UNISTD_H
+    if(pipe(state->ready_fds) || write(state->ready_fds[1], "", 1) != 1)
+        zprintf(1, "WARNING: video file will not support polling\n");
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+    /* same clock as _zbar_timer_now() */
+    if(state->fps_num &&
+       (state->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0)
+        zprintf(1, "WARNING: paced video file will block when polled\n");
+#endif
+
+    zprintf(1, "opened video file %s: %.4s(%08" PRIx32 ") %u x %u"
+            " @%u/%u fps\n", path, (char*)&state->format, state->format,
+            vdo->width, vdo->height, state->fps_num, state->fps_den);
+
+    vdo->intf = VIDEO_FILE;
+    vdo->iomode = VIDEO_READWRITE;
+    vdo->init = file_init;
+    vdo->cleanup = file_cleanup;
+    vdo->start = file_start;
+    vdo->stop = file_stop;
+    vdo->nq = file_nq;
+    vdo->dq = file_dq;
+
+done:
+    if(rc)
+        file_cleanup(vdo);
+    free(path);
+    return(rc);
+}
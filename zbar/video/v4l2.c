@@ -38,13 +38,138 @@
 #ifdef HAVE_SYS_MMAN_H
 # include <sys/mman.h>
 #endif
+#include <fcntl.h>
+#include <poll.h>
 #include <linux/videodev2.h>
+#ifdef HAVE_LINUX_DMA_BUF_H
+# include <linux/dma-buf.h>
+#endif
+#ifdef HAVE_LINUX_DMA_HEAP_H
+# include <linux/dma-heap.h>
+#endif
 
 #include "video.h"
 #include "image.h"
 
 #define V4L2_FORMATS_MAX 64
 
+/* DMABUF buffers are allocated here when the application supplies none */
+#define V4L2_DMA_HEAP "/dev/dma_heap/system"
+
+/* multi-planar formats that start w/a full resolution 8-bit luma plane.
+ * these are captured as GREY by scanning only the first plane
+ */
+static const uint32_t v4l2_luma_formats[] = {
+    V4L2_PIX_FMT_NV12M, V4L2_PIX_FMT_NV21M,
+    V4L2_PIX_FMT_NV16M, V4L2_PIX_FMT_NV61M,
+    V4L2_PIX_FMT_YUV420M, V4L2_PIX_FMT_YVU420M,
+    V4L2_PIX_FMT_YUV422M, V4L2_PIX_FMT_YVU422M,
+    V4L2_PIX_FMT_YUV444M, V4L2_PIX_FMT_YVU444M,
+    0
+};
+
+struct video_state_s {
+    enum v4l2_buf_type buftype;         /* single or multi-planar capture */
+    uint32_t luma_fmt;                  /* multi-planar format for GREY */
+    int nplanes;                        /* planes per buffer */
+    unsigned stride;                    /* luma bytes per line */
+    unsigned long planelen[VIDEO_MAX_PLANES]; /* required plane sizes */
+    int cropping;                       /* driver supports cropping */
+    struct v4l2_rect defrect;           /* full frame crop window */
+
+    /* DMABUF fds for each plane of each buffer, w/the heap allocated
+     * ones closed at cleanup
+     */
+    int dmabufs[ZBAR_VIDEO_IMAGES_MAX][VIDEO_MAX_PLANES];
+    unsigned long dmalen[ZBAR_VIDEO_IMAGES_MAX][VIDEO_MAX_PLANES];
+    unsigned char allocated[ZBAR_VIDEO_IMAGES_MAX][VIDEO_MAX_PLANES];
+};
+
+/* access the format fields shared by the single and multi-planar APIs */
+#define V4L2_PIX(state, vfmt, field)                                    \
+    (*(((state)->buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)         \
+       ? &(vfmt)->fmt.pix_mp.field : &(vfmt)->fmt.pix.field))
+
+static inline int v4l2_mplane (const zbar_video_t *vdo)
+{
+    return(vdo->state->buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+}
+
+static inline enum v4l2_memory v4l2_memory (const zbar_video_t *vdo)
+{
+    switch(vdo->iomode) {
+    case VIDEO_MMAP: return(V4L2_MEMORY_MMAP);
+    case VIDEO_DMABUF: return(V4L2_MEMORY_DMABUF);
+    default: return(V4L2_MEMORY_USERPTR);
+    }
+}
+
+/* prepare a buffer descriptor for the current type and memory */
+static inline void v4l2_init_buffer (const zbar_video_t *vdo,
+                                     struct v4l2_buffer *vbuf,
+                                     struct v4l2_plane *planes)
+{
+    memset(vbuf, 0, sizeof(*vbuf));
+    vbuf->type = vdo->state->buftype;
+    vbuf->memory = v4l2_memory(vdo);
+    if(v4l2_mplane(vdo)) {
+        memset(planes, 0, VIDEO_MAX_PLANES * sizeof(*planes));
+        vbuf->m.planes = planes;
+        vbuf->length = vdo->state->nplanes;
+    }
+}
+
+/* bracket CPU access to an imported buffer */
+static inline void v4l2_sync_dmabuf (zbar_video_t *vdo,
+                                     int idx,
+                                     int end)
+{
+#ifdef DMA_BUF_IOCTL_SYNC
+    struct dma_buf_sync sync;
+    sync.flags = ((end) ? DMA_BUF_SYNC_END : DMA_BUF_SYNC_START) |
+        DMA_BUF_SYNC_READ;
+    if(ioctl(vdo->state->dmabufs[idx][0], DMA_BUF_IOCTL_SYNC, &sync) < 0)
+        zprintf(1, "WARNING: dma-buf sync failed (%d)\n", errno);
+#endif
+}
+
+/* hand a buffer (back) to the driver */
+static int v4l2_qbuf (zbar_video_t *vdo,
+                      zbar_image_t *img)
+{
+    video_state_t *state = vdo->state;
+    struct v4l2_buffer vbuf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    v4l2_init_buffer(vdo, &vbuf, planes);
+    vbuf.index = img->srcidx; /* FIXME workaround broken drivers */
+    if(vdo->iomode == VIDEO_USERPTR) {
+        if(v4l2_mplane(vdo)) {
+            planes[0].m.userptr = (unsigned long)img->data;
+            planes[0].length = img->datalen;
+        }
+        else {
+            vbuf.m.userptr = (unsigned long)img->data;
+            vbuf.length = img->datalen;
+        }
+    }
+    else if(vdo->iomode == VIDEO_DMABUF) {
+        int i = img->srcidx, p;
+        if(v4l2_mplane(vdo))
+            for(p = 0; p < state->nplanes; p++) {
+                planes[p].m.fd = state->dmabufs[i][p];
+                planes[p].length = state->dmalen[i][p];
+            }
+        else {
+            vbuf.m.fd = state->dmabufs[i][0];
+            vbuf.length = state->dmalen[i][0];
+        }
+    }
+    if(ioctl(vdo->fd, VIDIOC_QBUF, &vbuf) < 0)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                           "queuing video buffer (VIDIOC_QBUF)"));
+    return(0);
+}
+
 static int v4l2_nq (zbar_video_t *vdo,
                     zbar_image_t *img)
 {
@@ -53,24 +178,34 @@ static int v4l2_nq (zbar_video_t *vdo,
 
     if(video_unlock(vdo))
         return(-1);
+    if(vdo->iomode == VIDEO_DMABUF)
+        v4l2_sync_dmabuf(vdo, img->srcidx, 1);
+    return(v4l2_qbuf(vdo, img));
+}
 
-    struct v4l2_buffer vbuf;
-    memset(&vbuf, 0, sizeof(vbuf));
-    vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if(vdo->iomode == VIDEO_MMAP) {
-        vbuf.memory = V4L2_MEMORY_MMAP;
-        vbuf.index = img->srcidx;
+/* map a dequeued buffer back to its image */
+static zbar_image_t *v4l2_buffer_image (zbar_video_t *vdo,
+                                        const struct v4l2_buffer *vbuf)
+{
+    zbar_image_t *img;
+    if(vdo->iomode != VIDEO_USERPTR) {
+        assert(vbuf->index >= 0);
+        assert(vbuf->index < vdo->num_images);
+        img = vdo->images[vbuf->index];
     }
     else {
-        vbuf.memory = V4L2_MEMORY_USERPTR;
-        vbuf.m.userptr = (unsigned long)img->data;
-        vbuf.length = img->datalen;
-        vbuf.index = img->srcidx; /* FIXME workaround broken drivers */
+        /* reverse map pointer back to image (FIXME) */
+        unsigned long userptr = (v4l2_mplane(vdo))
+            ? vbuf->m.planes[0].m.userptr : vbuf->m.userptr;
+        assert(userptr >= (unsigned long)vdo->buf);
+        assert(userptr < (unsigned long)(vdo->buf + vdo->buflen));
+        int i = (userptr - (unsigned long)vdo->buf) / vdo->datalen;
+        assert(i >= 0);
+        assert(i < vdo->num_images);
+        img = vdo->images[i];
+        assert(userptr == (unsigned long)img->data);
     }
-    if(ioctl(vdo->fd, VIDIOC_QBUF, &vbuf) < 0)
-        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
-                           "queuing video buffer (VIDIOC_QBUF)"));
-    return(0);
+    return(img);
 }
 
 static zbar_image_t *v4l2_dq (zbar_video_t *vdo)
@@ -79,36 +214,66 @@ static zbar_image_t *v4l2_dq (zbar_video_t *vdo)
     int fd = vdo->fd;
 
     if(vdo->iomode != VIDEO_READWRITE) {
-        video_iomode_t iomode = vdo->iomode;
         if(video_unlock(vdo))
             return(NULL);
 
+        /* descriptors alternate when skipping stale frames */
         struct v4l2_buffer vbuf;
-        memset(&vbuf, 0, sizeof(vbuf));
-        vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        if(iomode == VIDEO_MMAP)
-            vbuf.memory = V4L2_MEMORY_MMAP;
-        else
-            vbuf.memory = V4L2_MEMORY_USERPTR;
-
-        if(ioctl(fd, VIDIOC_DQBUF, &vbuf) < 0)
+        struct v4l2_plane planes[2][VIDEO_MAX_PLANES];
+        int cur = 0;
+        v4l2_init_buffer(vdo, &vbuf, planes[cur]);
+
+        if(ioctl(fd, VIDIOC_DQBUF, &vbuf) < 0) {
+            err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                        "dequeuing video buffer (VIDIOC_DQBUF)");
             return(NULL);
+        }
 
-        if(iomode == VIDEO_MMAP) {
-            assert(vbuf.index >= 0);
-            assert(vbuf.index < vdo->num_images);
-            img = vdo->images[vbuf.index];
+        if(vdo->latest) {
+            /* drain frames completed while the last one was processed,
+             * handing all but the newest straight back to the driver
+             */
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            unsigned long dropped = 0;
+            /* bounded, in case the device refills as fast as we drain */
+            while(dropped < vdo->num_images &&
+                  poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+                struct v4l2_buffer next;
+                v4l2_init_buffer(vdo, &next, planes[!cur]);
+                if(ioctl(fd, VIDIOC_DQBUF, &next) < 0)
+                    break;
+                zbar_image_t *stale = v4l2_buffer_image(vdo, &vbuf);
+                stale->roi_gen = vdo->roi_gen;
+                if(v4l2_qbuf(vdo, stale))
+                    /* buffer is lost, but the frame is still good */
+                    zprintf(1, "WARNING: unable to requeue stale buffer\n");
+                vbuf = next;
+                cur = !cur;
+                dropped++;
+            }
+            if(dropped) {
+                vdo->dropped += dropped;
+                zprintf(24, "skipped %lu stale frames\n", dropped);
+            }
         }
-        else {
-            /* reverse map pointer back to image (FIXME) */
-            assert(vbuf.m.userptr >= (unsigned long)vdo->buf);
-            assert(vbuf.m.userptr < (unsigned long)(vdo->buf + vdo->buflen));
-            int i = (vbuf.m.userptr - (unsigned long)vdo->buf) / vdo->datalen;
-            assert(i >= 0);
-            assert(i < vdo->num_images);
-            img = vdo->images[i];
-            assert(vbuf.m.userptr == (unsigned long)img->data);
+
+        img = v4l2_buffer_image(vdo, &vbuf);
+        if(vdo->iomode == VIDEO_DMABUF)
+            v4l2_sync_dmabuf(vdo, img->srcidx, 0);
+
+        if(vdo->state->stride > img->width) {
+            /* padded GREY rows: expose the padding and crop it off */
+            zbar_image_set_size(img, vdo->state->stride, vdo->height);
+            zbar_image_set_crop(img, 0, 0, vdo->width, vdo->height);
         }
+
+#ifdef V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+        /* capture time, on the same clock as _zbar_timer_now() */
+        if((vbuf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+           V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+            img->time = ((unsigned long)vbuf.timestamp.tv_sec * 1000 +
+                         vbuf.timestamp.tv_usec / 1000);
+#endif
     }
     else {
         img = video_dq_image(vdo);
@@ -131,7 +296,7 @@ static int v4l2_start (zbar_video_t *vdo)
     if(vdo->iomode == VIDEO_READWRITE)
         return(0);
 
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    enum v4l2_buf_type type = vdo->state->buftype;
     if(ioctl(vdo->fd, VIDIOC_STREAMON, &type) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "starting video stream (VIDIOC_STREAMON)"));
@@ -143,7 +308,7 @@ static int v4l2_stop (zbar_video_t *vdo)
     if(vdo->iomode == VIDEO_READWRITE)
         return(0);
 
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    enum v4l2_buf_type type = vdo->state->buftype;
     if(ioctl(vdo->fd, VIDIOC_STREAMOFF, &type) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "stopping video stream (VIDIOC_STREAMOFF)"));
@@ -152,85 +317,102 @@ static int v4l2_stop (zbar_video_t *vdo)
 
 static int v4l2_cleanup (zbar_video_t *vdo)
 {
-    if(vdo->iomode == VIDEO_READWRITE)
-        return(0);
+    video_state_t *state = vdo->state;
+    if(vdo->iomode != VIDEO_READWRITE) {
+        struct v4l2_requestbuffers rb;
+        memset(&rb, 0, sizeof(rb));
+        rb.type = state->buftype;
+        rb.memory = v4l2_memory(vdo);
+        if(vdo->iomode == VIDEO_MMAP || vdo->iomode == VIDEO_DMABUF) {
+            int i;
+            for(i = 0; i < vdo->num_images; i++) {
+                zbar_image_t *img = vdo->images[i];
+                if(img->data &&
+                   munmap((void*)img->data, img->datalen))
+                    err_capture(vdo, SEV_WARNING, ZBAR_ERR_SYSTEM, __func__,
+                                "unmapping video frame buffers");
+                img->data = NULL;
+                img->datalen = 0;
+            }
+        }
 
-    struct v4l2_requestbuffers rb;
-    memset(&rb, 0, sizeof(rb));
-    rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if(vdo->iomode == VIDEO_MMAP) {
-        rb.memory = V4L2_MEMORY_MMAP;
-        int i;
-        for(i = 0; i < vdo->num_images; i++) {
-            zbar_image_t *img = vdo->images[i];
-            if(img->data &&
-               munmap((void*)img->data, img->datalen))
-                err_capture(vdo, SEV_WARNING, ZBAR_ERR_SYSTEM, __func__,
-                            "unmapping video frame buffers");
-            img->data = NULL;
-            img->datalen = 0;
+        /* requesting 0 buffers
+         * should implicitly disable streaming
+         */
+        if(ioctl(vdo->fd, VIDIOC_REQBUFS, &rb) < 0)
+            err_capture(vdo, SEV_WARNING, ZBAR_ERR_SYSTEM, __func__,
+                        "releasing video frame buffers (VIDIOC_REQBUFS)");
+
+        if(vdo->iomode == VIDEO_DMABUF) {
+            int i, p;
+            for(i = 0; i < ZBAR_VIDEO_IMAGES_MAX; i++)
+                for(p = 0; p < VIDEO_MAX_PLANES; p++)
+                    if(state->allocated[i][p])
+                        close(state->dmabufs[i][p]);
         }
     }
-    else
-        rb.memory = V4L2_MEMORY_USERPTR;
-
-    /* requesting 0 buffers
-     * should implicitly disable streaming
-     */
-    if(ioctl(vdo->fd, VIDIOC_REQBUFS, &rb) < 0)
-        err_capture(vdo, SEV_WARNING, ZBAR_ERR_SYSTEM, __func__,
-                    "releasing video frame buffers (VIDIOC_REQBUFS)");
-
 
     /* close open device */
     if(vdo->fd >= 0) {
         close(vdo->fd);
         vdo->fd = -1;
     }
+    free(state);
+    vdo->state = NULL;
     return(0);
 }
 
-static int v4l2_mmap_buffers (zbar_video_t *vdo)
+static int v4l2_request_buffers (zbar_video_t *vdo)
 {
     struct v4l2_requestbuffers rb;
     memset(&rb, 0, sizeof(rb));
     rb.count = vdo->num_images;
-    rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    rb.memory = V4L2_MEMORY_MMAP;
+    rb.type = vdo->state->buftype;
+    rb.memory = v4l2_memory(vdo);
     if(ioctl(vdo->fd, VIDIOC_REQBUFS, &rb) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "requesting video frame buffers (VIDIOC_REQBUFS)"));
-    zprintf(1, "mapping %u buffers (of %d requested)\n",
+    zprintf(1, "using %u buffers (of %d requested)\n",
             rb.count, vdo->num_images);
     if(!rb.count)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
                            "driver returned 0 buffers"));
     if(vdo->num_images > rb.count)
         vdo->num_images = rb.count;
+    return(0);
+}
 
-    struct v4l2_buffer vbuf;
-    memset(&vbuf, 0, sizeof(vbuf));
-    vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vbuf.memory = V4L2_MEMORY_MMAP;
+static int v4l2_mmap_buffers (zbar_video_t *vdo)
+{
+    if(v4l2_request_buffers(vdo))
+        return(-1);
 
+    struct v4l2_buffer vbuf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
     int i;
     for(i = 0; i < vdo->num_images; i++) {
+        v4l2_init_buffer(vdo, &vbuf, planes);
         vbuf.index = i;
         if(ioctl(vdo->fd, VIDIOC_QUERYBUF, &vbuf) < 0)
             /* FIXME cleanup */
             return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                                "querying video buffer (VIDIOC_QUERYBUF)"));
 
-        if(vbuf.length < vdo->datalen)
+        /* only the first plane is scanned */
+        unsigned long length = (v4l2_mplane(vdo)) ? planes[0].length
+                                                  : vbuf.length;
+        unsigned long offset = (v4l2_mplane(vdo)) ? planes[0].m.mem_offset
+                                                  : vbuf.m.offset;
+        if(length < vdo->datalen)
             fprintf(stderr, "WARNING: insufficient v4l2 video buffer size:\n"
-                    "\tvbuf[%d].length=%x datalen=%lx image=%d x %d %.4s(%08x)\n",
-                    i, vbuf.length, vdo->datalen, vdo->width, vdo->height,
+                    "\tvbuf[%d].length=%lx datalen=%lx image=%d x %d %.4s(%08x)\n",
+                    i, length, vdo->datalen, vdo->width, vdo->height,
                     (char*)&vdo->format, vdo->format);
 
         zbar_image_t *img = vdo->images[i];
-        img->datalen = vbuf.length;
-        img->data = mmap(NULL, vbuf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
-                         vdo->fd, vbuf.m.offset);
+        img->datalen = length;
+        img->data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         vdo->fd, offset);
         if(img->data == MAP_FAILED)
             /* FIXME cleanup */
             return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
@@ -241,17 +423,116 @@ static int v4l2_mmap_buffers (zbar_video_t *vdo)
     return(0);
 }
 
+static int v4l2_alloc_dmabuf (zbar_video_t *vdo,
+                              int heap,
+                              unsigned long len)
+{
+#ifdef DMA_HEAP_IOCTL_ALLOC
+    struct dma_heap_allocation_data alloc;
+    memset(&alloc, 0, sizeof(alloc));
+    alloc.len = len;
+    alloc.fd_flags = O_RDWR | O_CLOEXEC;
+    if(heap >= 0 && !ioctl(heap, DMA_HEAP_IOCTL_ALLOC, &alloc))
+        return(alloc.fd);
+#endif
+    return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                       "allocating dma-buf from " V4L2_DMA_HEAP));
+}
+
+static int v4l2_dmabuf_buffers (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    int nplanes = state->nplanes;
+    int heap = -1, i, p;
+
+    if(vdo->num_dmabufs) {
+        /* application buffers, one fd per plane */
+        if(vdo->num_dmabufs % nplanes)
+            return(err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
+                                   "dma-buf count is not a multiple of"
+                                   " the %d format planes", nplanes));
+        if(vdo->num_images > vdo->num_dmabufs / nplanes)
+            vdo->num_images = vdo->num_dmabufs / nplanes;
+    }
+    if(v4l2_request_buffers(vdo))
+        return(-1);
+
+    if(!vdo->num_dmabufs) {
+        heap = open(V4L2_DMA_HEAP, O_RDWR | O_CLOEXEC);
+        if(heap < 0)
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                               "opening " V4L2_DMA_HEAP));
+    }
+
+    for(i = 0; i < vdo->num_images; i++) {
+        for(p = 0; p < nplanes; p++) {
+            int dmabuf;
+            unsigned long len;
+            if(vdo->num_dmabufs) {
+                off_t end;
+                dmabuf = vdo->dmabufs[i * nplanes + p];
+                end = lseek(dmabuf, 0, SEEK_END);
+                len = (end > 0) ? end : state->planelen[p];
+                if(len < state->planelen[p]) {
+                    err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_INVALID,
+                                    __func__, "dma-buf %d is too small",
+                                    i * nplanes + p);
+                    goto error;
+                }
+            }
+            else {
+                len = state->planelen[p];
+                dmabuf = v4l2_alloc_dmabuf(vdo, heap, len);
+                if(dmabuf < 0)
+                    goto error;
+                state->allocated[i][p] = 1;
+            }
+            state->dmabufs[i][p] = dmabuf;
+            state->dmalen[i][p] = len;
+        }
+
+        /* only the first plane is scanned */
+        zbar_image_t *img = vdo->images[i];
+        img->datalen = state->dmalen[i][0];
+        img->data = mmap(NULL, img->datalen, PROT_READ, MAP_SHARED,
+                         state->dmabufs[i][0], 0);
+        if(img->data == MAP_FAILED) {
+            img->data = NULL;
+            img->datalen = 0;
+            err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                        "mapping dma-buf video frame buffers");
+            goto error;
+        }
+        zprintf(2, "    buf[%d] fd=%d 0x%lx bytes @%p\n",
+                i, state->dmabufs[i][0], img->datalen, img->data);
+    }
+    if(heap >= 0)
+        close(heap);
+    return(0);
+
+ error:
+    if(heap >= 0)
+        close(heap);
+    return(-1);
+}
+
 static int v4l2_set_format (zbar_video_t *vdo,
                             uint32_t fmt)
 {
+    video_state_t *state = vdo->state;
+
+    /* luma only capture from a multi-planar format */
+    uint32_t vfourcc = fmt;
+    if(fmt == V4L2_PIX_FMT_GREY && state->luma_fmt)
+        vfourcc = state->luma_fmt;
+
     struct v4l2_format vfmt;
-    struct v4l2_pix_format *vpix = &vfmt.fmt.pix;
     memset(&vfmt, 0, sizeof(vfmt));
-    vfmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vpix->width = vdo->width;
-    vpix->height = vdo->height;
-    vpix->pixelformat = fmt;
-    vpix->field = V4L2_FIELD_NONE;
+    vfmt.type = state->buftype;
+    V4L2_PIX(state, &vfmt, width) = vdo->width;
+    V4L2_PIX(state, &vfmt, height) = vdo->height;
+    V4L2_PIX(state, &vfmt, pixelformat) = vfourcc;
+    V4L2_PIX(state, &vfmt, field) = V4L2_FIELD_NONE;
     int rc = 0;
     if((rc = ioctl(vdo->fd, VIDIOC_S_FMT, &vfmt)) < 0) {
         /* several broken drivers return an error if we request
@@ -262,63 +543,191 @@ static int v4l2_set_format (zbar_video_t *vdo,
                 rc, errno);
 
         /* FIXME this might be _ANY once we can de-interlace */
-        vpix->field = V4L2_FIELD_INTERLACED;
+        V4L2_PIX(state, &vfmt, field) = V4L2_FIELD_INTERLACED;
 
         if(ioctl(vdo->fd, VIDIOC_S_FMT, &vfmt) < 0)
             return(err_capture_int(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
-                                   "setting format %x (VIDIOC_S_FMT)", fmt));
+                                   "setting format %x (VIDIOC_S_FMT)",
+                                   vfourcc));
 
         zprintf(0, "WARNING: broken driver returned error when non-interlaced"
                 " format requested\n");
     }
 
     struct v4l2_format newfmt;
-    struct v4l2_pix_format *newpix = &newfmt.fmt.pix;
     memset(&newfmt, 0, sizeof(newfmt));
-    newfmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    newfmt.type = state->buftype;
     if(ioctl(vdo->fd, VIDIOC_G_FMT, &newfmt) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "querying format (VIDIOC_G_FMT)"));
 
-    if(newpix->field != V4L2_FIELD_NONE)
+    if(V4L2_PIX(state, &newfmt, field) != V4L2_FIELD_NONE)
         err_capture(vdo, SEV_WARNING, ZBAR_ERR_INVALID, __func__,
                     "video driver only supports interlaced format,"
                     " vertical scanning may not work");
 
-    if(newpix->pixelformat != fmt
+    if(V4L2_PIX(state, &newfmt, pixelformat) != vfourcc
        /* FIXME bpl/bpp checks? */)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_INVALID, __func__,
                            "video driver can't provide compatible format"));
 
     vdo->format = fmt;
-    vdo->width = newpix->width;
-    vdo->height = newpix->height;
-    vdo->datalen = newpix->sizeimage;
+    vdo->width = V4L2_PIX(state, &newfmt, width);
+    vdo->height = V4L2_PIX(state, &newfmt, height);
+    state->stride = 0;
+    if(v4l2_mplane(vdo)) {
+        struct v4l2_pix_format_mplane *mp = &newfmt.fmt.pix_mp;
+        int p;
+        state->nplanes = mp->num_planes;
+        for(p = 0; p < mp->num_planes; p++)
+            state->planelen[p] = mp->plane_fmt[p].sizeimage;
+        vdo->datalen = mp->plane_fmt[0].sizeimage;
+        if(fmt == V4L2_PIX_FMT_GREY &&
+           mp->plane_fmt[0].bytesperline > vdo->width)
+            state->stride = mp->plane_fmt[0].bytesperline;
+        if(vdo->iomode == VIDEO_USERPTR && state->nplanes > 1)
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                               "USERPTR I/O of multi-planar formats"
+                               " not supported"));
+    }
+    else {
+        state->nplanes = 1;
+        state->planelen[0] = vdo->datalen = newfmt.fmt.pix.sizeimage;
+    }
 
     zprintf(1, "set new format: %.4s(%08x) %u x %u (0x%lx)\n",
-            (char*)&vdo->format, vdo->format, vdo->width, vdo->height,
+            (char*)&vfourcc, vfourcc, vdo->width, vdo->height,
             vdo->datalen);
+    if(vfourcc != fmt)
+        zprintf(1, "    scanning %d byte luma plane of %d as %.4s\n",
+                (int)vdo->datalen, state->nplanes, (char*)&fmt);
     return(0);
 }
 
+/* read back the crop window the driver actually applied */
+static int v4l2_get_roi (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    struct v4l2_rect r;
+#ifdef VIDIOC_G_SELECTION
+    struct v4l2_selection sel;
+    memset(&sel, 0, sizeof(sel));
+    sel.type = state->buftype;
+    sel.target = V4L2_SEL_TGT_CROP;
+    if(!ioctl(vdo->fd, VIDIOC_G_SELECTION, &sel))
+        r = sel.r;
+    else
+#endif
+    {
+        struct v4l2_crop crop;
+        memset(&crop, 0, sizeof(crop));
+        crop.type = state->buftype;
+        if(ioctl(vdo->fd, VIDIOC_G_CROP, &crop) < 0)
+            return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                               "querying crop window (VIDIOC_G_CROP)"));
+        r = crop.c;
+    }
+
+    vdo->roi_x = (r.left > state->defrect.left)
+        ? r.left - state->defrect.left : 0;
+    vdo->roi_y = (r.top > state->defrect.top)
+        ? r.top - state->defrect.top : 0;
+    vdo->roi_w = r.width;
+    vdo->roi_h = r.height;
+    zprintf(1, "region of interest: %d x %d @ (%d, %d)\n",
+            vdo->roi_w, vdo->roi_h, vdo->roi_x, vdo->roi_y);
+    return(0);
+}
+
+/* crop the sensor readout to the region of interest, preferring the
+ * selection API.  moving the window while streaming is up to the driver
+ */
+static int v4l2_set_roi (zbar_video_t *vdo)
+{
+    video_state_t *state = vdo->state;
+    if(!state->cropping)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                           "video driver does not support cropping"));
+
+    struct v4l2_rect r;
+    r.left = state->defrect.left + vdo->roi_x;
+    r.top = state->defrect.top + vdo->roi_y;
+    r.width = vdo->roi_w;
+    r.height = vdo->roi_h;
+
+    int rc = -1;
+#ifdef VIDIOC_S_SELECTION
+    struct v4l2_selection sel;
+    memset(&sel, 0, sizeof(sel));
+    sel.type = state->buftype;
+    sel.target = V4L2_SEL_TGT_CROP;
+    sel.r = r;
+    rc = ioctl(vdo->fd, VIDIOC_S_SELECTION, &sel);
+    if(rc < 0 && errno != ENOTTY && errno != EINVAL && errno != EBUSY)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                           "setting crop selection (VIDIOC_S_SELECTION)"));
+#endif
+    if(rc < 0 && errno != EBUSY) {
+        struct v4l2_crop crop;
+        memset(&crop, 0, sizeof(crop));
+        crop.type = state->buftype;
+        crop.c = r;
+        rc = ioctl(vdo->fd, VIDIOC_S_CROP, &crop);
+    }
+    if(rc < 0 && errno == EBUSY)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_BUSY, __func__,
+                           "video driver can not move the crop window"
+                           " while streaming"));
+    else if(rc < 0)
+        return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
+                           "setting crop window (VIDIOC_S_CROP)"));
+    return(v4l2_get_roi(vdo));
+}
+
 static int v4l2_init (zbar_video_t *vdo,
                       uint32_t fmt)
 {
+    if(vdo->roi_w) {
+        /* capture the region at full resolution */
+        if(v4l2_set_roi(vdo))
+            return(-1);
+        vdo->width = vdo->roi_w;
+        vdo->height = vdo->roi_h;
+    }
     if(v4l2_set_format(vdo, fmt))
         return(-1);
+    if(vdo->roi_w) {
+        /* the format may have adjusted the window */
+        if(v4l2_get_roi(vdo))
+            return(-1);
+        if(vdo->roi_w != vdo->width || vdo->roi_h != vdo->height)
+            err_capture(vdo, SEV_WARNING, ZBAR_ERR_INVALID, __func__,
+                        "video driver scales the region of interest,"
+                        " symbol locations will be inaccurate");
+    }
     if(vdo->iomode == VIDEO_MMAP)
         return(v4l2_mmap_buffers(vdo));
+    if(vdo->iomode == VIDEO_DMABUF)
+        return(v4l2_dmabuf_buffers(vdo));
     return(0);
 }
 
 static int v4l2_probe_iomode (zbar_video_t *vdo)
 {
+    if(!vdo->iomode && v4l2_mplane(vdo)) {
+        /* USERPTR only covers single plane formats */
+        vdo->iomode = VIDEO_MMAP;
+        return(0);
+    }
+
     struct v4l2_requestbuffers rb;
     memset(&rb, 0, sizeof(rb));
     rb.count = vdo->num_images; /* FIXME workaround broken drivers */
-    rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    rb.type = vdo->state->buftype;
     if(vdo->iomode == VIDEO_MMAP)
         rb.memory = V4L2_MEMORY_MMAP;
+    else if(vdo->iomode == VIDEO_DMABUF)
+        rb.memory = V4L2_MEMORY_DMABUF;
     else
         rb.memory = V4L2_MEMORY_USERPTR;
 
@@ -338,17 +747,42 @@ static int v4l2_probe_iomode (zbar_video_t *vdo)
         if(!vdo->iomode)
             vdo->iomode = VIDEO_USERPTR;
         if(rb.count)
-            vdo->num_images = rb.count;
+            vdo->num_images = (rb.count < ZBAR_VIDEO_IMAGES_MAX)
+                ? rb.count : ZBAR_VIDEO_IMAGES_MAX;
     }
     return(0);
 }
 
+static inline void v4l2_dump_format (const char *label,
+                                     const video_state_t *state,
+                                     struct v4l2_format *fmt)
+{
+    uint32_t pixfmt = V4L2_PIX(state, fmt, pixelformat);
+    unsigned line, size;
+    if(state->buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        line = fmt->fmt.pix_mp.plane_fmt[0].bytesperline;
+        size = fmt->fmt.pix_mp.plane_fmt[0].sizeimage;
+    }
+    else {
+        line = fmt->fmt.pix.bytesperline;
+        size = fmt->fmt.pix.sizeimage;
+    }
+    zprintf(1, "%s format: %.4s(%08x) %u x %u%s (line=0x%x size=0x%x)\n",
+            label, (char*)&pixfmt, pixfmt,
+            V4L2_PIX(state, fmt, width), V4L2_PIX(state, fmt, height),
+            (V4L2_PIX(state, fmt, field) != V4L2_FIELD_NONE)
+            ? " INTERLACED" : "",
+            line, size);
+}
+
 static inline int v4l2_probe_formats (zbar_video_t *vdo)
 {
+    video_state_t *state = vdo->state;
+    int grey = 0;
     zprintf(2, "enumerating supported formats:\n");
     struct v4l2_fmtdesc desc;
     memset(&desc, 0, sizeof(desc));
-    desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    desc.type = state->buftype;
     for(desc.index = 0; desc.index < V4L2_FORMATS_MAX; desc.index++) {
         if(ioctl(vdo->fd, VIDIOC_ENUM_FMT, &desc) < 0)
             break;
@@ -356,38 +790,49 @@ static inline int v4l2_probe_formats (zbar_video_t *vdo)
                 desc.index, (char*)&desc.pixelformat, desc.description,
                 (desc.flags & V4L2_FMT_FLAG_COMPRESSED) ? " COMPRESSED" : "");
         vdo->formats = realloc(vdo->formats,
-                               (desc.index + 2) * sizeof(uint32_t));
+                               (desc.index + 3) * sizeof(uint32_t));
         vdo->formats[desc.index] = desc.pixelformat;
+        if(desc.pixelformat == V4L2_PIX_FMT_GREY)
+            grey = 1;
+        if(!state->luma_fmt && v4l2_mplane(vdo)) {
+            const uint32_t *luma;
+            for(luma = v4l2_luma_formats; *luma; luma++)
+                if(desc.pixelformat == *luma)
+                    state->luma_fmt = *luma;
+        }
     }
     if(!desc.index)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "enumerating video formats (VIDIOC_ENUM_FMT)"));
+    if(grey)
+        /* captured directly */
+        state->luma_fmt = 0;
+    else if(state->luma_fmt) {
+        zprintf(2, "    [%d] GREY : luma plane of %.4s\n",
+                desc.index, (char*)&state->luma_fmt);
+        vdo->formats[desc.index++] = V4L2_PIX_FMT_GREY;
+    }
     vdo->formats[desc.index] = 0;
 
     struct v4l2_format fmt;
-    struct v4l2_pix_format *pix = &fmt.fmt.pix;
     memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.type = state->buftype;
     if(ioctl(vdo->fd, VIDIOC_G_FMT, &fmt) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "querying current video format (VIDIO_G_FMT)"));
+    v4l2_dump_format("current", state, &fmt);
 
-    zprintf(1, "current format: %.4s(%08x) %u x %u%s (line=0x%x size=0x%x)\n",
-            (char*)&pix->pixelformat, pix->pixelformat,
-            pix->width, pix->height,
-            (pix->field != V4L2_FIELD_NONE) ? " INTERLACED" : "",
-            pix->bytesperline, pix->sizeimage);
-
-    vdo->format = pix->pixelformat;
-    vdo->datalen = pix->sizeimage;
-    if(pix->width == vdo->width && pix->height == vdo->height)
+    vdo->format = V4L2_PIX(state, &fmt, pixelformat);
+    vdo->datalen = (v4l2_mplane(vdo)) ? fmt.fmt.pix_mp.plane_fmt[0].sizeimage
+                                      : fmt.fmt.pix.sizeimage;
+    if(V4L2_PIX(state, &fmt, width) == vdo->width &&
+       V4L2_PIX(state, &fmt, height) == vdo->height)
         return(0);
 
     struct v4l2_format maxfmt;
-    struct v4l2_pix_format *maxpix = &maxfmt.fmt.pix;
     memcpy(&maxfmt, &fmt, sizeof(maxfmt));
-    maxpix->width = vdo->width;
-    maxpix->height = vdo->height;
+    V4L2_PIX(state, &maxfmt, width) = vdo->width;
+    V4L2_PIX(state, &maxfmt, height) = vdo->height;
 
     zprintf(1, "setting requested size: %d x %d\n", vdo->width, vdo->height);
     if(ioctl(vdo->fd, VIDIOC_S_FMT, &maxfmt) < 0) {
@@ -397,20 +842,16 @@ static inline int v4l2_probe_formats (zbar_video_t *vdo)
     }
 
     memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.type = state->buftype;
     if(ioctl(vdo->fd, VIDIOC_G_FMT, &fmt) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "querying current video format (VIDIOC_G_FMT)"));
+    v4l2_dump_format("final", state, &fmt);
 
-    zprintf(1, "final format: %.4s(%08x) %u x %u%s (line=0x%x size=0x%x)\n",
-            (char*)&pix->pixelformat, pix->pixelformat,
-            pix->width, pix->height,
-            (pix->field != V4L2_FIELD_NONE) ? " INTERLACED" : "",
-            pix->bytesperline, pix->sizeimage);
-
-    vdo->width = pix->width;
-    vdo->height = pix->height;
-    vdo->datalen = pix->sizeimage;
+    vdo->width = V4L2_PIX(state, &fmt, width);
+    vdo->height = V4L2_PIX(state, &fmt, height);
+    vdo->datalen = (v4l2_mplane(vdo)) ? fmt.fmt.pix_mp.plane_fmt[0].sizeimage
+                                      : fmt.fmt.pix.sizeimage;
     return(0);
 }
 
@@ -419,7 +860,7 @@ static inline int v4l2_reset_crop (zbar_video_t *vdo)
     /* check cropping */
     struct v4l2_cropcap ccap;
     memset(&ccap, 0, sizeof(ccap));
-    ccap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ccap.type = vdo->state->buftype;
     if(ioctl(vdo->fd, VIDIOC_CROPCAP, &ccap) < 0)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
                            "querying crop support (VIDIOC_CROPCAP)"));
@@ -436,11 +877,13 @@ static inline int v4l2_reset_crop (zbar_video_t *vdo)
         vdo->width = ccap.defrect.width;
         vdo->height = ccap.defrect.height;
     }
+    vdo->state->defrect = ccap.defrect;
+    vdo->state->cropping = 1;
 
     /* reset crop parameters */
     struct v4l2_crop crop;
     memset(&crop, 0, sizeof(crop));
-    crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    crop.type = vdo->state->buftype;
     crop.c = ccap.defrect;
     if(ioctl(vdo->fd, VIDIOC_S_CROP, &crop) < 0 && errno != EINVAL)
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_SYSTEM, __func__,
@@ -462,17 +905,46 @@ int _zbar_v4l2_probe (zbar_video_t *vdo)
             (vcap.bus_info[0]) ? (char*)vcap.bus_info : "<unknown>",
             vcap.driver, (vcap.version >> 16) & 0xff,
             (vcap.version >> 8) & 0xff, vcap.version & 0xff);
-    zprintf(1, "    capabilities:%s%s%s%s\n",
-            (vcap.capabilities & V4L2_CAP_VIDEO_CAPTURE) ? " CAPTURE" : "",
-            (vcap.capabilities & V4L2_CAP_VIDEO_OVERLAY) ? " OVERLAY" : "",
-            (vcap.capabilities & V4L2_CAP_READWRITE) ? " READWRITE" : "",
-            (vcap.capabilities & V4L2_CAP_STREAMING) ? " STREAMING" : "");
-
-    if(!(vcap.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
-       !(vcap.capabilities & (V4L2_CAP_READWRITE | V4L2_CAP_STREAMING)))
+
+    /* capabilities of this node, rather than the whole device */
+    uint32_t caps = vcap.capabilities;
+    if(caps & V4L2_CAP_DEVICE_CAPS)
+        caps = vcap.device_caps;
+    zprintf(1, "    capabilities:%s%s%s%s%s\n",
+            (caps & V4L2_CAP_VIDEO_CAPTURE) ? " CAPTURE" : "",
+            (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) ? " CAPTURE_MPLANE" : "",
+            (caps & V4L2_CAP_VIDEO_OVERLAY) ? " OVERLAY" : "",
+            (caps & V4L2_CAP_READWRITE) ? " READWRITE" : "",
+            (caps & V4L2_CAP_STREAMING) ? " STREAMING" : "");
+
+    if(!(caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE)) ||
+       !(caps & (V4L2_CAP_READWRITE | V4L2_CAP_STREAMING)))
         return(err_capture(vdo, SEV_WARNING, ZBAR_ERR_UNSUPPORTED, __func__,
                            "v4l2 device does not support usable CAPTURE"));
 
+    video_state_t *state = vdo->state = calloc(1, sizeof(video_state_t));
+    if(!state)
+        return(err_capture(vdo, SEV_FATAL, ZBAR_ERR_NOMEM, __func__,
+                           "allocating video state"));
+    if(caps & V4L2_CAP_VIDEO_CAPTURE)
+        state->buftype = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    else {
+        /* multi-planar capture is streaming only */
+        state->buftype = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        caps &= ~V4L2_CAP_READWRITE;
+        if(vdo->iomode == VIDEO_READWRITE ||
+           !(caps & V4L2_CAP_STREAMING)) {
+            err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                        "multi-planar capture requires streaming I/O");
+            goto error;
+        }
+    }
+    if(vdo->iomode == VIDEO_DMABUF && !(caps & V4L2_CAP_STREAMING)) {
+        err_capture(vdo, SEV_ERROR, ZBAR_ERR_UNSUPPORTED, __func__,
+                    "DMABUF I/O requires streaming capture");
+        goto error;
+    }
+
     if(v4l2_reset_crop(vdo))
         /* ignoring errors (driver cropping support questionable) */;
 
@@ -483,20 +955,22 @@ int _zbar_v4l2_probe (zbar_video_t *vdo)
     }
 
     if(v4l2_probe_formats(vdo))
-        return(-1);
+        goto error;
 
     /* FIXME report error and fallback to readwrite? (if supported...) */
     if(vdo->iomode != VIDEO_READWRITE &&
-       (vcap.capabilities & V4L2_CAP_STREAMING) &&
+       (caps & V4L2_CAP_STREAMING) &&
        v4l2_probe_iomode(vdo))
-        return(-1);
+        goto error;
     if(!vdo->iomode)
         vdo->iomode = VIDEO_READWRITE;
 
-    zprintf(1, "using I/O mode: %s\n",
+    zprintf(1, "using I/O mode: %s%s\n",
             (vdo->iomode == VIDEO_READWRITE) ? "READWRITE" :
             (vdo->iomode == VIDEO_MMAP) ? "MMAP" :
-            (vdo->iomode == VIDEO_USERPTR) ? "USERPTR" : "<UNKNOWN>");
+            (vdo->iomode == VIDEO_USERPTR) ? "USERPTR" :
+            (vdo->iomode == VIDEO_DMABUF) ? "DMABUF" : "<UNKNOWN>",
+            (v4l2_mplane(vdo)) ? " (multi-planar)" : "");
 
     vdo->intf = VIDEO_V4L2;
     vdo->init = v4l2_init;
@@ -505,5 +979,11 @@ int _zbar_v4l2_probe (zbar_video_t *vdo)
     vdo->stop = v4l2_stop;
     vdo->nq = v4l2_nq;
     vdo->dq = v4l2_dq;
+    vdo->set_roi = v4l2_set_roi;
     return(0);
+
+ error:
+    free(state);
+    vdo->state = NULL;
+    return(-1);
 }
@@ -313,7 +313,8 @@ static int vfw_init (zbar_video_t *vdo,
         return(err_capture(vdo, SEV_ERROR, ZBAR_ERR_BUSY, __func__,
                            "setting capture callbacks"));
 
-    vdo->num_images = cp.wNumVideoRequested;
+    vdo->num_images = (cp.wNumVideoRequested < ZBAR_VIDEO_IMAGES_MAX)
+        ? cp.wNumVideoRequested : ZBAR_VIDEO_IMAGES_MAX;
     vdo->iomode = VIDEO_MMAP; /* driver provides "locked" buffers */
 
     zprintf(3, "initialized video capture: %d buffers %ldms/frame\n",
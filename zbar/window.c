@@ -90,6 +90,16 @@ static inline int window_draw_overlay (zbar_window_t *w)
     if(!w->overlay)
         return(0);
     if(w->overlay >= 1 && w->image && w->image->syms) {
+        /* symbols are located in the full video frame, which may be
+         * larger than a region of interest image
+         */
+        point_t offset = w->scaled_offset, roi;
+        roi.x = w->image->frame_x;
+        roi.y = w->image->frame_y;
+        roi = window_scale_pt(w, roi);
+        w->scaled_offset.x -= roi.x;
+        w->scaled_offset.y -= roi.y;
+
         /* FIXME outline each symbol */
         const zbar_symbol_t *sym = w->image->syms->head;
         for(; sym; sym = sym->next) {
@@ -116,6 +126,7 @@ static inline int window_draw_overlay (zbar_window_t *w)
                 }
             }
         }
+        w->scaled_offset = offset;
     }
 
     if(w->overlay >= 2) {
@@ -51,6 +51,7 @@ static const char *note_usage =
     "    --nodisplay     disable video display window\n"
     "    --prescale=<W>x<H>\n"
     "                    request alternate video image size from driver\n"
+    "    --workers=N     scan frames in N threads, separate from capture\n"
     "    -S<CONFIG>[=<VALUE>], --set <CONFIG>[=<VALUE>]\n"
     "                    set decoder/scanner <CONFIG> to <VALUE> (or 1)\n"
     /* FIXME overlay level */
@@ -225,6 +226,13 @@ int main (int argc, const char *argv[])
             long int v = strtol(argv[i] + 6, NULL, 0);
             zbar_processor_request_interface(proc, v);
         }
+        else if(!strncmp(argv[i], "--workers=", 10)) {
+            long int v = strtol(argv[i] + 10, NULL, 0);
+            if(zbar_processor_request_workers(proc, v)) {
+                fprintf(stderr, "ERROR: invalid workers: %s\n\n", argv[i]);
+                return(usage(1));
+            }
+        }
         else if(!strncmp(argv[i], "--iomode=", 9)) {
             long int v = strtol(argv[i] + 9, NULL, 0);
             zbar_processor_request_iomode(proc, v);
@@ -132,95 +132,121 @@ static inline int dump_error(MagickWand *wand)
     return(exit_code);
 }
 
-static int scan_image (const char *filename)
+/* scan one image and output the results.
+ * returns the number of symbols found, or -1 to stop
+ */
+static int scan_zimage (const char *filename,
+                        unsigned seq,
+                        zbar_image_t *zimage)
 {
-    if(exit_code == 3)
-        return(-1);
-
     int found = 0;
-    MagickWand *images = NewMagickWand();
-    if(!MagickReadImage(images, filename) && dump_error(images))
-        return(-1);
-
-    unsigned seq, n = MagickGetNumberImages(images);
-    for(seq = 0; seq < n; seq++) {
-        if(exit_code == 3)
-            return(-1);
-
-        if(!MagickSetImageIndex(images, seq) && dump_error(images))
-            return(-1);
-
-        zbar_image_t *zimage = zbar_image_create();
-        assert(zimage);
-        zbar_image_set_format(zimage, zbar_fourcc('Y','8','0','0'));
-
-        int width = MagickGetImageWidth(images);
-        int height = MagickGetImageHeight(images);
-        zbar_image_set_size(zimage, width, height);
-
-        // extract grayscale image pixels
-        // FIXME color!! ...preserve most color w/422P
-        // (but only if it's a color image)
-        size_t bloblen = width * height;
-        unsigned char *blob = malloc(bloblen);
-        zbar_image_set_data(zimage, blob, bloblen, zbar_image_free_data);
+    if(xmllvl == 1) {
+        xmllvl++;
+        printf("<source href='%s'>\n", filename);
+    }
 
-        if(!MagickGetImagePixels(images, 0, 0, width, height,
-                                 "I", CharPixel, blob))
-            return(-1);
+    zbar_process_image(processor, zimage);
 
-        if(xmllvl == 1) {
-            xmllvl++;
-            printf("<source href='%s'>\n", filename);
+    // output result data
+    const zbar_symbol_t *sym = zbar_image_first_symbol(zimage);
+    for(; sym; sym = zbar_symbol_next(sym)) {
+        zbar_symbol_type_t typ = zbar_symbol_get_type(sym);
+        unsigned len = zbar_symbol_get_data_length(sym);
+        if(typ == ZBAR_PARTIAL)
+            continue;
+        else if(xmllvl <= 0) {
+            if(!xmllvl)
+                printf("%s:", zbar_get_symbol_name(typ));
+            if(len &&
+               fwrite(zbar_symbol_get_data(sym), len, 1, stdout) != 1) {
+                exit_code = 1;
+                return(-1);
+            }
         }
-
-        zbar_process_image(processor, zimage);
-
-        // output result data
-        const zbar_symbol_t *sym = zbar_image_first_symbol(zimage);
-        for(; sym; sym = zbar_symbol_next(sym)) {
-            zbar_symbol_type_t typ = zbar_symbol_get_type(sym);
-            unsigned len = zbar_symbol_get_data_length(sym);
-            if(typ == ZBAR_PARTIAL)
-                continue;
-            else if(xmllvl <= 0) {
-                if(!xmllvl)
-                    printf("%s:", zbar_get_symbol_name(typ));
-                if(len &&
-                   fwrite(zbar_symbol_get_data(sym), len, 1, stdout) != 1) {
-                    exit_code = 1;
-                    return(-1);
-                }
+        else {
+            if(xmllvl < 3) {
+                xmllvl++;
+                printf("<index num='%u'>\n", seq);
             }
-            else {
-                if(xmllvl < 3) {
-                    xmllvl++;
-                    printf("<index num='%u'>\n", seq);
-                }
-                zbar_symbol_xml(sym, &xmlbuf, &xmlbuflen);
-                if(fwrite(xmlbuf, xmlbuflen, 1, stdout) != 1) {
-                    exit_code = 1;
-                    return(-1);
-                }
+            zbar_symbol_xml(sym, &xmlbuf, &xmlbuflen);
+            if(fwrite(xmlbuf, xmlbuflen, 1, stdout) != 1) {
+                exit_code = 1;
+                return(-1);
             }
-            printf("\n");
-            found++;
-            num_symbols++;
-        }
-        if(xmllvl > 2) {
-            xmllvl--;
-            printf("</index>\n");
         }
-        fflush(stdout);
+        printf("\n");
+        found++;
+        num_symbols++;
+    }
+    if(xmllvl > 2) {
+        xmllvl--;
+        printf("</index>\n");
+    }
+    fflush(stdout);
+
+    zbar_image_destroy(zimage);
+
+    num_images++;
+    if(zbar_processor_is_visible(processor)) {
+        int rc = zbar_processor_user_wait(processor, -1);
+        if(rc < 0 || rc == 'q' || rc == 'Q')
+            exit_code = 3;
+    }
+    return(found);
+}
 
-        zbar_image_destroy(zimage);
+static int scan_image (const char *filename)
+{
+    if(exit_code == 3)
+        return(-1);
+
+    int found = 0;
+
+    // uncompressed files are scanned in place, w/o decoding a copy
+    zbar_image_t *zimage = zbar_image_open_mapped(filename);
+    if(zimage) {
+        found = scan_zimage(filename, 0, zimage);
+        if(found < 0)
+            return(-1);
+    }
+    else {
+        MagickWand *images = NewMagickWand();
+        if(!MagickReadImage(images, filename) && dump_error(images))
+            return(-1);
 
-        num_images++;
-        if(zbar_processor_is_visible(processor)) {
-            int rc = zbar_processor_user_wait(processor, -1);
-            if(rc < 0 || rc == 'q' || rc == 'Q')
-                exit_code = 3;
+        unsigned seq, n = MagickGetNumberImages(images);
+        for(seq = 0; seq < n; seq++) {
+            if(exit_code == 3)
+                return(-1);
+
+            if(!MagickSetImageIndex(images, seq) && dump_error(images))
+                return(-1);
+
+            zimage = zbar_image_create();
+            assert(zimage);
+            zbar_image_set_format(zimage, zbar_fourcc('Y','8','0','0'));
+
+            int width = MagickGetImageWidth(images);
+            int height = MagickGetImageHeight(images);
+            zbar_image_set_size(zimage, width, height);
+
+            // extract grayscale image pixels
+            // FIXME color!! ...preserve most color w/422P
+            // (but only if it's a color image)
+            size_t bloblen = width * height;
+            unsigned char *blob = malloc(bloblen);
+            zbar_image_set_data(zimage, blob, bloblen, zbar_image_free_data);
+
+            if(!MagickGetImagePixels(images, 0, 0, width, height,
+                                     "I", CharPixel, blob))
+                return(-1);
+
+            int rc = scan_zimage(filename, seq, zimage);
+            if(rc < 0)
+                return(-1);
+            found += rc;
         }
+        DestroyMagickWand(images);
     }
 
     if(xmllvl > 1) {
@@ -231,7 +257,6 @@ static int scan_image (const char *filename)
     if(!found)
         notfound++;
 
-    DestroyMagickWand(images);
     return(0);
 }
 